@@ -0,0 +1,79 @@
+/*****************************************************
+*
+* File:  videoEventDecoder.cc
+*
+* Explanation:  This script prints the records of a
+*               binary event log written by the video
+*               stream applications (see --eventLog of
+*               videoStreamer) as text or CSV:
+*               ./waf --run "videoEventDecoder
+*                 --input=events.vsel --csv=true"
+*
+*               Records can be filtered by source and
+*               by kind, e.g. --type=STALL_END.
+*
+*****************************************************/
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+#include <iomanip>
+#include <iostream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("VideoEventDecoder");
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "events.vsel";
+  bool csv = false;
+  int64_t source = -1;
+  std::string type = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Event log file to decode", input);
+  cmd.AddValue ("csv", "Print CSV instead of aligned text", csv);
+  cmd.AddValue ("source", "Only print the records of this source (-1 for all)", source);
+  cmd.AddValue ("type", "Only print the records of this kind, e.g. FRAME_COMPLETED (empty for all)", type);
+  cmd.Parse (argc, argv);
+
+  // the log stores time steps, and videoStreamer runs at nanosecond resolution
+  Time::SetResolution (Time::NS);
+
+  std::vector<VideoStreamEventLog::Record> records;
+  if (!VideoStreamEventLog::ReadFile (input, records))
+  {
+    NS_FATAL_ERROR ("Cannot read the event log " << input);
+  }
+
+  if (csv)
+  {
+    std::cout << "time,source,type,level,value0,value1,value2,value3" << std::endl;
+  }
+  for (std::vector<VideoStreamEventLog::Record>::const_iterator it = records.begin (); it != records.end (); ++it)
+  {
+    std::string typeName = VideoStreamEventLog::GetTypeName (it->m_type);
+    if ((source >= 0 && it->m_source != source) || (!type.empty () && typeName != type))
+    {
+      continue;
+    }
+    double time = TimeStep (it->m_time).GetSeconds ();
+    if (csv)
+    {
+      std::cout << time << "," << it->m_source << "," << typeName << "," << it->m_level << ","
+                << it->m_values[0] << "," << it->m_values[1] << "," << it->m_values[2] << ","
+                << it->m_values[3] << std::endl;
+    }
+    else
+    {
+      std::cout << std::fixed << std::setprecision (6) << time << "s source " << it->m_source << " "
+                << std::left << std::setw (16) << typeName << std::right << " level " << it->m_level
+                << " " << it->m_values[0] << " " << it->m_values[1] << " " << it->m_values[2]
+                << " " << it->m_values[3] << std::endl;
+    }
+  }
+  NS_LOG_INFO ("Decoded " << records.size () << " records");
+
+  return 0;
+}
@@ -0,0 +1,247 @@
+/*****************************************************
+*
+* File:  videoStreamBench.cc
+*
+* Explanation:  This script benchmarks the video stream
+*               applications for a growing number of
+*               clients, and prints one CSV row per
+*               client count:
+*               ./waf --run "videoStreamBench
+*                 --clients=1,10,100,1000,10000,100000"
+*
+*               The clients share a few nodes, each one
+*               linked to the single server node, so that
+*               the cost measured is the one of the
+*               applications rather than of the nodes.
+*               Each row runs in a child process of its
+*               own, whose resident memory starts from
+*               the same base.
+*
+*****************************************************/
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cerrno>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamBench");
+
+static uint64_t g_txPackets = 0; //!< Packets sent by the server
+static uint64_t g_rxPackets = 0; //!< Packets received by the clients
+static uint64_t g_residentBytes = 0; //!< Resident memory sampled during the run
+
+/**
+ * @brief Count a packet sent by the server.
+ */
+static void
+CountTx (Ptr<const Packet>)
+{
+  g_txPackets++;
+}
+
+/**
+ * @brief Count a packet received by a client node.
+ */
+static void
+CountRx (Ptr<const Packet>)
+{
+  g_rxPackets++;
+}
+
+/**
+ * @brief Get the resident memory of the process.
+ *
+ * @return the resident memory in bytes (0 if unknown)
+ */
+static uint64_t
+GetResidentBytes (void)
+{
+  std::ifstream statm ("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+/**
+ * @brief Sample the resident memory while all the sessions are open.
+ */
+static void
+SampleMemory (void)
+{
+  g_residentBytes = GetResidentBytes ();
+}
+
+/**
+ * @brief Get the time taken by a call in microseconds.
+ *
+ * @param start the wall clock time before the call
+ * @return the elapsed time in microseconds
+ */
+static double
+GetElapsedMicroseconds (std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () - start).count ();
+}
+
+/**
+ * @brief Simulate a number of clients streaming from one server, and write
+ * the measurements as one CSV row.
+ *
+ * @param nClients the number of clients
+ * @param clientsPerNode the largest number of clients sharing a node
+ * @param frameFile the file containing the frame sizes
+ * @param dataRate the data rate of the links
+ * @param duration the simulated time
+ * @param os the stream the row is written to
+ */
+static void
+RunBenchmark (uint32_t nClients, uint32_t clientsPerNode, std::string frameFile,
+              std::string dataRate, Time duration, std::ostream &os)
+{
+  // the first load parses or maps the file, the second hits the registry
+  VideoStreamTrace::ClearCache ();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  VideoStreamTrace::Load (frameFile);
+  double loadTime = GetElapsedMicroseconds (start);
+  start = std::chrono::steady_clock::now ();
+  VideoStreamTrace::Load (frameFile);
+  double cachedLoadTime = GetElapsedMicroseconds (start);
+
+  g_txPackets = 0;
+  g_rxPackets = 0;
+  g_residentBytes = 0;
+  uint64_t baseResidentBytes = GetResidentBytes ();
+
+  uint32_t nNodes = (nClients + clientsPerNode - 1) / clientsPerNode;
+  NodeContainer server;
+  server.Create (1);
+  NodeContainer clients;
+  clients.Create (nNodes);
+
+  InternetStackHelper stack;
+  stack.Install (server);
+  stack.Install (clients);
+
+  PointToPointHelper pointToPoint;
+  pointToPoint.SetDeviceAttribute ("DataRate", StringValue (dataRate));
+  pointToPoint.SetChannelAttribute ("Delay", StringValue ("1ms"));
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.0.0", "255.255.255.0");
+  std::vector<Ipv4Address> serverAddresses;
+  for (uint32_t i = 0; i < nNodes; i++)
+  {
+    NetDeviceContainer devices = pointToPoint.Install (server.Get (0), clients.Get (i));
+    devices.Get (0)->TraceConnectWithoutContext ("MacTx", MakeCallback (&CountTx));
+    devices.Get (1)->TraceConnectWithoutContext ("MacRx", MakeCallback (&CountRx));
+    Ipv4InterfaceContainer interfaces = address.Assign (devices);
+    address.NewNetwork ();
+    serverAddresses.push_back (interfaces.GetAddress (0));
+  }
+
+  VideoStreamServerHelper videoServer (5000);
+  videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
+  videoServer.SetAttribute ("FrameFile", StringValue (frameFile));
+  ApplicationContainer serverApp = videoServer.Install (server.Get (0));
+  serverApp.Start (Seconds (0.0));
+  serverApp.Stop (duration);
+
+  // the clients of a node only differ by their port
+  for (uint32_t k = 0; k < nClients; k++)
+  {
+    VideoStreamClientHelper videoClient (serverAddresses[k / clientsPerNode], 5000);
+    ApplicationContainer clientApp = videoClient.Install (clients.Get (k / clientsPerNode));
+    clientApp.Start (Seconds (0.1) + MicroSeconds (k % 1000));
+    clientApp.Stop (duration);
+  }
+  Simulator::Schedule (Seconds (duration.GetSeconds () / 2), &SampleMemory);
+  Simulator::Stop (duration);
+
+  start = std::chrono::steady_clock::now ();
+  Simulator::Run ();
+  double wallTime = GetElapsedMicroseconds (start) / 1e6;
+  uint64_t events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+
+  uint64_t sessionBytes = g_residentBytes > baseResidentBytes ? g_residentBytes - baseResidentBytes : 0;
+  os << nClients << "," << nNodes << "," << duration.GetSeconds () << "," << wallTime << ","
+     << events << "," << events / wallTime << ","
+     << g_txPackets << "," << g_rxPackets << "," << (g_txPackets + g_rxPackets) / wallTime << ","
+     << loadTime << "," << cachedLoadTime << "," << sessionBytes / nClients << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string clientCounts = "1,10,100,1000,10000,100000";
+  uint32_t clientsPerNode = 1000;
+  std::string frameFile = "./scratch/videoStreamer/small.txt";
+  std::string dataRate = "10Gbps";
+  double duration = 2.0;
+  std::string output = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("clients", "Comma-separated numbers of clients to benchmark", clientCounts);
+  cmd.AddValue ("clientsPerNode", "Largest number of clients sharing a node (at most 16384 ephemeral ports)", clientsPerNode);
+  cmd.AddValue ("frameFile", "File containing the frame sizes", frameFile);
+  cmd.AddValue ("dataRate", "Data rate of the links between the server and the client nodes", dataRate);
+  cmd.AddValue ("duration", "Simulated time of each run in seconds", duration);
+  cmd.AddValue ("output", "CSV file the results are appended to (empty for the standard output)", output);
+  cmd.Parse (argc, argv);
+
+  NS_ABORT_MSG_IF (clientsPerNode == 0 || clientsPerNode > 16384, "A node fits between 1 and 16384 clients");
+  Time::SetResolution (Time::NS);
+
+  std::ofstream outputFile;
+  if (!output.empty ())
+  {
+    outputFile.open (output.c_str (), std::ios::app);
+    NS_ABORT_MSG_IF (!outputFile.is_open (), "Cannot open " << output);
+  }
+  std::ostream &os = output.empty () ? std::cout : outputFile;
+
+  os << "clients,nodes,simSeconds,wallSeconds,events,eventsPerSecond,"
+     << "txPackets,rxPackets,packetsPerSecond,traceLoadMicroseconds,"
+     << "cachedTraceLoadMicroseconds,bytesPerClient" << std::endl;
+
+  std::stringstream countStream (clientCounts);
+  std::string count;
+  while (std::getline (countStream, count, ','))
+  {
+    uint32_t nClients = std::stoul (count);
+    NS_ABORT_MSG_IF (nClients == 0, "Cannot benchmark 0 clients");
+    NS_LOG_INFO ("Benchmarking " << nClients << " clients");
+
+    // the resident memory of a process never shrinks, so a row measured
+    // after a larger one would see no growth: each row gets a fresh process
+    os.flush ();
+    pid_t pid = fork ();
+    NS_ABORT_MSG_IF (pid < 0, "Cannot fork the benchmark of " << nClients << " clients");
+    if (pid == 0)
+    {
+      RunBenchmark (nClients, clientsPerNode, frameFile, dataRate, Seconds (duration), os);
+      os.flush ();
+      _exit (0);
+    }
+    int status;
+    while (waitpid (pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+      NS_LOG_WARN ("The benchmark of " << nClients << " clients failed");
+    }
+  }
+
+  return 0;
+}
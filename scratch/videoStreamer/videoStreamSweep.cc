@@ -0,0 +1,314 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "videoStreamSweep.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamSweep");
+
+VideoStreamSweep::VideoStreamSweep (const std::vector<std::string> &baseArgs)
+  : m_baseArgs (baseArgs)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+VideoStreamSweep::AddGrid (const std::string &grid)
+{
+  NS_LOG_FUNCTION (this << grid);
+
+  std::stringstream gridStream (grid);
+  std::string axis;
+  while (std::getline (gridStream, axis, ';'))
+  {
+    if (axis.empty ())
+    {
+      continue;
+    }
+    size_t equal = axis.find ('=');
+    if (equal == std::string::npos || equal == 0)
+    {
+      NS_LOG_WARN ("Missing argument name in axis \"" << axis << "\"");
+      return false;
+    }
+
+    std::vector<std::string> values;
+    std::stringstream valueStream (axis.substr (equal + 1));
+    std::string value;
+    while (std::getline (valueStream, value, ','))
+    {
+      size_t colon = value.find (':');
+      if (colon == std::string::npos)
+      {
+        values.push_back (value);
+        continue;
+      }
+      char *end;
+      long first = std::strtol (value.c_str (), &end, 10);
+      long last = std::strtol (value.c_str () + colon + 1, &end, 10);
+      if (*end != '\0' || last < first)
+      {
+        NS_LOG_WARN ("Invalid range \"" << value << "\"");
+        return false;
+      }
+      for (long i = first; i <= last; i++)
+      {
+        values.push_back (std::to_string (i));
+      }
+    }
+    if (values.empty ())
+    {
+      NS_LOG_WARN ("No values in axis \"" << axis << "\"");
+      return false;
+    }
+
+    m_axisNames.push_back (axis.substr (0, equal));
+    m_axisValues.push_back (values);
+  }
+  return true;
+}
+
+uint32_t
+VideoStreamSweep::GetNJobs (void) const
+{
+  uint32_t nJobs = 1;
+  for (const auto &values : m_axisValues)
+  {
+    nJobs *= values.size ();
+  }
+  return nJobs;
+}
+
+std::vector<std::string>
+VideoStreamSweep::GetPoint (uint32_t job) const
+{
+  // the last axis varies fastest
+  std::vector<std::string> point (m_axisValues.size ());
+  for (size_t i = m_axisValues.size (); i-- > 0;)
+  {
+    point[i] = m_axisValues[i][job % m_axisValues[i].size ()];
+    job /= m_axisValues[i].size ();
+  }
+  return point;
+}
+
+uint32_t
+VideoStreamSweep::Run (uint32_t nWorkers, std::ostream &os)
+{
+  NS_LOG_FUNCTION (this << nWorkers);
+
+  uint32_t nJobs = GetNJobs ();
+  if (nWorkers == 0)
+  {
+    nWorkers = std::max (1u, std::thread::hardware_concurrency ());
+  }
+  nWorkers = std::min (nWorkers, nJobs);
+
+  // deal the jobs round-robin, neighbouring points of the grid tend to take
+  // similar times and should not all end up on the same worker
+  m_results.assign (nJobs, JobResult ());
+  m_queues.clear ();
+  for (uint32_t i = 0; i < nWorkers; i++)
+  {
+    m_queues.emplace_back ();
+  }
+  for (uint32_t job = 0; job < nJobs; job++)
+  {
+    m_queues[job % nWorkers].m_jobs.push_back (job);
+  }
+
+  NS_LOG_INFO ("Running " << nJobs << " jobs on " << nWorkers << " workers");
+  std::vector<std::thread> workers;
+  for (uint32_t i = 0; i < nWorkers; i++)
+  {
+    workers.push_back (std::thread (&VideoStreamSweep::Work, this, i));
+  }
+  for (auto &worker : workers)
+  {
+    worker.join ();
+  }
+
+  // the columns are the axes, then the result keys in order of appearance
+  std::vector<std::string> columns (m_axisNames);
+  for (const auto &result : m_results)
+  {
+    for (const auto &value : result.m_values)
+    {
+      if (std::find (columns.begin (), columns.end (), value.first) == columns.end ())
+      {
+        columns.push_back (value.first);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < columns.size (); i++)
+  {
+    os << columns[i] << "\t";
+  }
+  os << "status" << std::endl;
+
+  uint32_t failed = 0;
+  for (uint32_t job = 0; job < nJobs; job++)
+  {
+    std::vector<std::string> point = GetPoint (job);
+    for (size_t i = 0; i < columns.size (); i++)
+    {
+      std::string cell = i < point.size () ? point[i] : "-";
+      for (const auto &value : m_results[job].m_values)
+      {
+        if (value.first == columns[i])
+        {
+          cell = value.second;
+        }
+      }
+      os << cell << "\t";
+    }
+    os << (m_results[job].m_done ? "ok" : "failed") << std::endl;
+    failed += m_results[job].m_done ? 0 : 1;
+  }
+  return failed;
+}
+
+bool
+VideoStreamSweep::TakeJob (uint32_t worker, uint32_t &job)
+{
+  {
+    std::lock_guard<std::mutex> lock (m_queues[worker].m_mutex);
+    if (!m_queues[worker].m_jobs.empty ())
+    {
+      job = m_queues[worker].m_jobs.front ();
+      m_queues[worker].m_jobs.pop_front ();
+      return true;
+    }
+  }
+
+  // steal from the back of the other queues, away from where their owners take
+  for (uint32_t i = 1; i < m_queues.size (); i++)
+  {
+    WorkerQueue &victim = m_queues[(worker + i) % m_queues.size ()];
+    std::lock_guard<std::mutex> lock (victim.m_mutex);
+    if (!victim.m_jobs.empty ())
+    {
+      job = victim.m_jobs.back ();
+      victim.m_jobs.pop_back ();
+      NS_LOG_LOGIC ("Worker " << worker << " stole job " << job);
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+VideoStreamSweep::Work (uint32_t worker)
+{
+  uint32_t job;
+  while (TakeJob (worker, job))
+  {
+    RunJob (job);
+  }
+}
+
+void
+VideoStreamSweep::RunJob (uint32_t job)
+{
+  // later arguments override earlier ones on the command line of the child
+  std::vector<std::string> args;
+  args.push_back ("/proc/self/exe");
+  args.insert (args.end (), m_baseArgs.begin (), m_baseArgs.end ());
+  std::vector<std::string> point = GetPoint (job);
+  for (size_t i = 0; i < point.size (); i++)
+  {
+    args.push_back ("--" + m_axisNames[i] + "=" + point[i]);
+  }
+
+  std::vector<char *> argv;
+  for (auto &arg : args)
+  {
+    argv.push_back (&arg[0]);
+  }
+  argv.push_back (0);
+
+  // the pipe must not leak into the children spawned by the other workers,
+  // or their output would never reach end of file
+  int fds[2];
+  if (pipe2 (fds, O_CLOEXEC) != 0)
+  {
+    NS_LOG_WARN ("Cannot create a pipe for job " << job);
+    return;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init (&actions);
+  posix_spawn_file_actions_adddup2 (&actions, fds[1], STDOUT_FILENO);
+  pid_t pid;
+  int error = posix_spawn (&pid, argv[0], &actions, 0, argv.data (), environ);
+  posix_spawn_file_actions_destroy (&actions);
+  close (fds[1]);
+  if (error != 0)
+  {
+    NS_LOG_WARN ("Cannot run job " << job << ": " << std::strerror (error));
+    close (fds[0]);
+    return;
+  }
+
+  std::string output;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read (fds[0], buffer, sizeof (buffer))) != 0)
+  {
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n < 0)
+    {
+      break;
+    }
+    output.append (buffer, n);
+  }
+  close (fds[0]);
+
+  int status;
+  while (waitpid (pid, &status, 0) < 0 && errno == EINTR)
+  {
+  }
+
+  JobResult &result = m_results[job];
+  result.m_done = WIFEXITED (status) && WEXITSTATUS (status) == 0;
+  std::stringstream outputStream (output);
+  std::string line;
+  while (std::getline (outputStream, line))
+  {
+    std::stringstream lineStream (line);
+    std::string field;
+    if (!(lineStream >> field) || field != "RESULT")
+    {
+      continue;
+    }
+    while (lineStream >> field)
+    {
+      size_t equal = field.find ('=');
+      if (equal != std::string::npos)
+      {
+        result.m_values.push_back (std::make_pair (field.substr (0, equal), field.substr (equal + 1)));
+      }
+    }
+  }
+  NS_LOG_INFO ("Job " << job << (result.m_done ? " done" : " failed"));
+}
+
+} // namespace ns3
@@ -0,0 +1,127 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_SWEEP_H
+#define VIDEO_STREAM_SWEEP_H
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief Run a grid of scenarios of the test program in parallel.
+   *
+   * Every point of the grid is one job: the program itself is run again in a
+   * child process, with the values of the point appended to its command
+   * line. Each worker thread owns a queue of jobs, and takes jobs from the
+   * queues of the other workers when its own is empty, so that long and
+   * short simulations even out across the cores.
+   *
+   * A child reports its results on the standard output as one line
+   * starting with "RESULT", followed by key=value pairs. The results of all
+   * the jobs are merged into one table, one row per job in grid order.
+   */
+  class VideoStreamSweep
+  {
+  public:
+    /**
+     * @brief Construct a new VideoStreamSweep object.
+     *
+     * @param baseArgs the command line arguments passed to every job
+     */
+    VideoStreamSweep (const std::vector<std::string> &baseArgs);
+
+    /**
+     * @brief Add the axes of a grid description.
+     *
+     * The description is a list of axes separated by ';', each made of a
+     * command line argument name, '=', and a list of values separated by ','.
+     * A value "first:last" expands to all the integers in the range, e.g.
+     * "dataRate=2Mbps,10Mbps;nClients=1,2,4;seed=1:5".
+     *
+     * @param grid the grid description
+     * @return false if the description cannot be parsed
+     */
+    bool AddGrid (const std::string &grid);
+
+    /**
+     * @brief Get the number of jobs in the grid.
+     *
+     * @return the number of jobs
+     */
+    uint32_t GetNJobs (void) const;
+
+    /**
+     * @brief Run all the jobs and write the merged table.
+     *
+     * @param nWorkers the number of jobs run at the same time (0 for one per core)
+     * @param os the stream the table is written to
+     * @return the number of jobs that failed
+     */
+    uint32_t Run (uint32_t nWorkers, std::ostream &os);
+
+  private:
+    /**
+     * @brief The outcome of one job.
+     */
+    typedef struct JobResult
+    {
+      bool m_done; //!< Whether the child exited successfully
+      std::vector<std::pair<std::string, std::string> > m_values; //!< Reported key=value pairs
+    } JobResult;
+
+    /**
+     * @brief The queue of jobs of one worker.
+     */
+    typedef struct WorkerQueue
+    {
+      std::mutex m_mutex; //!< Protects the queue
+      std::deque<uint32_t> m_jobs; //!< Indexes of the jobs
+    } WorkerQueue;
+
+    /**
+     * @brief Get the value of each axis for a job.
+     *
+     * @param job the index of the job
+     * @return the value of each axis
+     */
+    std::vector<std::string> GetPoint (uint32_t job) const;
+
+    /**
+     * @brief Take the next job of a worker, stealing from the others when
+     * its queue is empty.
+     *
+     * @param worker the index of the worker
+     * @param job the index of the job taken
+     * @return false if no job is left
+     */
+    bool TakeJob (uint32_t worker, uint32_t &job);
+
+    /**
+     * @brief Run jobs until none is left.
+     *
+     * @param worker the index of the worker
+     */
+    void Work (uint32_t worker);
+
+    /**
+     * @brief Run one job in a child process and collect its results.
+     *
+     * @param job the index of the job
+     */
+    void RunJob (uint32_t job);
+
+    std::vector<std::string> m_baseArgs; //!< Arguments passed to every job
+    std::vector<std::string> m_axisNames; //!< Argument name of each axis
+    std::vector<std::vector<std::string> > m_axisValues; //!< Values of each axis
+    std::deque<WorkerQueue> m_queues; //!< Job queue of each worker
+    std::vector<JobResult> m_results; //!< Outcome of each job, in grid order
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_SWEEP_H */
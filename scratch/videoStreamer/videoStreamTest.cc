@@ -15,6 +15,11 @@
 #include "ns3/mobility-module.h"
 #include "ns3/csma-module.h"
 #include "ns3/netanim-module.h"
+#include "videoStreamSweep.h"
+#include "videoStreamTopology.h"
+
+#include <iostream>
+#include <sstream>
 
 using namespace ns3;
 
@@ -26,28 +31,207 @@ using namespace ns3;
  * 2. P2P network with 1 server and 2 clients
  * 3. Wireless network with 1 server and 3 mobile clients
  * 4. Wireless network with 3 servers and 3 mobile clients
+ *
+ * The case and its parameters are set on the command line, e.g.
+ * ./waf --run "videoStreamer --case=2 --dataRate=10Mbps --nClients=4".
+ * With --topology, the network is instead built for any number of servers
+ * and clients, e.g. --topology=dumbbell --nServers=4 --nClients=1000.
+ * With --sweep, every point of a parameter grid is run in its own process,
+ * e.g. --sweep="dataRate=2Mbps,100Mbps;seed=1:5", and the results are
+ * merged into one table.
  */
-#define CASE 1
 
 NS_LOG_COMPONENT_DEFINE ("VideoStreamTest");
 
+/**
+ * @brief Print the results of a run as a single line of key=value pairs,
+ * to be merged by the sweep runner.
+ *
+ * @param scenario the test case or the topology
+ * @param clientApps the video stream clients
+ */
+static void
+PrintResults (std::string scenario, ApplicationContainer clientApps)
+{
+  uint32_t receivedFrames = 0, lostFrames = 0;
+  for (uint32_t i = 0; i < clientApps.GetN (); i++)
+  {
+    Ptr<VideoStreamClient> client = DynamicCast<VideoStreamClient> (clientApps.Get (i));
+    receivedFrames += client->GetReceivedFrames ();
+    lostFrames += client->GetLostFrames ();
+  }
+  std::cout << "RESULT scenario=" << scenario << " clients=" << clientApps.GetN ()
+            << " receivedFrames=" << receivedFrames << " lostFrames=" << lostFrames << std::endl;
+}
+
+/**
+ * @brief Record the events of all the applications installed so far.
+ *
+ * @param eventLog the event log, or 0 when no events are recorded
+ */
+static void
+AttachEventLog (Ptr<VideoStreamEventLog> eventLog)
+{
+  if (eventLog == 0)
+  {
+    return;
+  }
+  NodeContainer nodes = NodeContainer::GetGlobal ();
+  ApplicationContainer apps;
+  for (uint32_t n = 0; n < nodes.GetN (); n++)
+  {
+    for (uint32_t i = 0; i < nodes.Get (n)->GetNApplications (); i++)
+    {
+      apps.Add (nodes.Get (n)->GetApplication (i));
+    }
+  }
+  eventLog->Attach (apps);
+}
+
 int
 main (int argc, char *argv[])
 {
+  uint32_t testCase = 1;
+  std::string topology = "";
+  std::string dataRate = "";
+  uint32_t nClients = 0;
+  std::string frameFile = "";
+  std::string ladderFile = "";
+  std::string abr = "ns3::LegacyAbr";
+  uint32_t seed = 1;
+  uint32_t run = 1;
+  bool verbose = false;
+  std::string eventLogFile = "";
+  bool multicast = false;
+  bool tcp = false;
+  bool pcap = true;
+  std::string sweep = "";
+  uint32_t jobs = 0;
+
   CommandLine cmd;
+  cmd.AddValue ("case", "Test case (1-4)", testCase);
+  cmd.AddValue ("topology", "Topology built instead of the test case (star, dumbbell, wifi or tree)", topology);
+  cmd.AddValue ("dataRate", "Data rate of the point-to-point links (empty for the default of the case)", dataRate);
+  cmd.AddValue ("nClients", "Number of clients in cases 2 to 4 and in the topology (0 for the default)", nClients);
+  cmd.AddValue ("frameFile", "File containing the frame sizes (empty for the default of the case)", frameFile);
+  cmd.AddValue ("ladder", "File defining the bitrate, resolution and frame sizes of each video level, used instead of the frame file", ladderFile);
+  cmd.AddValue ("multicast", "Multicast one group per video level from each server, in the star, dumbbell and tree topologies", multicast);
+  cmd.AddValue ("tcp", "Stream over TCP connections instead of UDP", tcp);
+  cmd.AddValue ("abr", "Adaptive bitrate algorithm of the clients (ns3::LegacyAbr, ns3::BbaAbr, ns3::ThroughputAbr or ns3::MpcAbr)", abr);
+  cmd.AddValue ("seed", "Seed of the random number generator", seed);
+  cmd.AddValue ("run", "Run number of the random number generator", run);
+  cmd.AddValue ("verbose", "Log the client and server events", verbose);
+  cmd.AddValue ("eventLog", "Binary file the client and server events are recorded to (empty for none)", eventLogFile);
+  cmd.AddValue ("pcap", "Write pcap and animation traces", pcap);
+  cmd.AddValue ("sweep", "Parameter grid to run, as name=value,value;name=first:last", sweep);
+  cmd.AddValue ("jobs", "Number of sweep runs at the same time (0 for one per core)", jobs);
+  VideoStreamTopology videoTopology;
+  videoTopology.AddCommandLineValues (cmd);
   cmd.Parse (argc, argv);
-  
+
+  if (!sweep.empty ())
+  {
+    // every run gets the arguments of the sweep, without its own output
+    std::vector<std::string> baseArgs;
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      if (arg.find ("--sweep=") != 0 && arg.find ("--jobs=") != 0)
+      {
+        baseArgs.push_back (arg);
+      }
+    }
+    baseArgs.push_back ("--verbose=false");
+    baseArgs.push_back ("--pcap=false");
+
+    VideoStreamSweep videoSweep (baseArgs);
+    if (!videoSweep.AddGrid (sweep))
+    {
+      NS_FATAL_ERROR ("Invalid sweep grid " << sweep);
+    }
+    return videoSweep.Run (jobs, std::cout) == 0 ? 0 : 1;
+  }
+
+  Config::SetDefault ("ns3::VideoStreamClient::AbrAlgorithm", StringValue (abr));
+  Config::SetDefault ("ns3::VideoStreamServer::LadderFile", StringValue (ladderFile));
+  Config::SetDefault ("ns3::VideoStreamClient::LadderFile", StringValue (ladderFile));
+  if (tcp)
+  {
+    Config::SetDefault ("ns3::VideoStreamServer::Protocol", TypeIdValue (TcpSocketFactory::GetTypeId ()));
+    Config::SetDefault ("ns3::VideoStreamClient::Protocol", TypeIdValue (TcpSocketFactory::GetTypeId ()));
+  }
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
   Time::SetResolution (Time::NS);
-  LogComponentEnable ("VideoStreamClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable ("VideoStreamServerApplication", LOG_LEVEL_INFO);
+  if (verbose)
+  {
+    LogComponentEnable ("VideoStreamClientApplication", LOG_LEVEL_INFO);
+    LogComponentEnable ("VideoStreamServerApplication", LOG_LEVEL_INFO);
+  }
+  Ptr<VideoStreamEventLog> eventLog;
+  if (!eventLogFile.empty ())
+  {
+    eventLog = Create<VideoStreamEventLog> (eventLogFile);
+  }
 
-  if (CASE == 1)
+  NS_ABORT_MSG_IF (multicast && topology.empty (), "Multicast needs a topology");
+  NS_ABORT_MSG_IF (multicast && tcp, "Multicast needs UDP");
+  if (!topology.empty ())
+  {
+    if (nClients > 0)
+    {
+      videoTopology.SetNClients (nClients);
+    }
+    if (!dataRate.empty ())
+    {
+      videoTopology.SetDataRate (dataRate);
+    }
+    videoTopology.Build (topology);
+    if (multicast)
+    {
+      videoTopology.EnableMulticast (Ipv4Address ("225.1.0.0"), MAX_VIDEO_LEVEL);
+    }
+
+    VideoStreamServerHelper videoServer (5000);
+    videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
+    videoServer.SetAttribute ("FrameFile", StringValue (frameFile.empty () ? "./scratch/videoStreamer/small.txt" : frameFile));
+    ApplicationContainer serverApps = videoServer.Install (videoTopology.GetServers ());
+    for (uint32_t i = 0; multicast && i < serverApps.GetN (); i++)
+    {
+      // client i streams from server i, so server i sends to its groups
+      serverApps.Get (i)->SetAttribute ("MulticastGroup", Ipv4AddressValue (videoTopology.GetMulticastGroup (i)));
+    }
+    serverApps.Start (Seconds (0.0));
+    serverApps.Stop (Seconds (100.0));
+
+    NodeContainer clients = videoTopology.GetClients ();
+    ApplicationContainer clientApps;
+    for (uint32_t k = 0; k < clients.GetN (); k++)
+    {
+      VideoStreamClientHelper videoClient (videoTopology.GetServerAddress (k), 5000);
+      if (multicast)
+      {
+        videoClient.SetAttribute ("MulticastGroup", Ipv4AddressValue (videoTopology.GetMulticastGroup (k)));
+      }
+      ApplicationContainer clientApp = videoClient.Install (clients.Get (k));
+      // spread the requests so that the clients do not all start in lockstep
+      clientApp.Start (Seconds (0.5) + MilliSeconds (k % 100));
+      clientApp.Stop (Seconds (100.0));
+      clientApps.Add (clientApp);
+    }
+
+    AttachEventLog (eventLog);
+    Simulator::Run ();
+    PrintResults (topology, clientApps);
+    Simulator::Destroy ();
+  }
+  else if (testCase == 1)
   {
     NodeContainer nodes;
     nodes.Create (2);
 
     PointToPointHelper pointToPoint;
-    pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
+    pointToPoint.SetDeviceAttribute ("DataRate", StringValue (dataRate.empty () ? "100Mbps" : dataRate));
     pointToPoint.SetChannelAttribute ("Delay", StringValue ("2ms"));
 
     NetDeviceContainer devices;
@@ -68,73 +252,81 @@ main (int argc, char *argv[])
 
     VideoStreamServerHelper videoServer (5000);
     videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
-    videoServer.SetAttribute ("FrameFile", StringValue ("./scratch/videoStreamer/frameList.txt"));
+    videoServer.SetAttribute ("FrameFile", StringValue (frameFile.empty () ? "./scratch/videoStreamer/frameList.txt" : frameFile));
     // videoServer.SetAttribute ("FrameSize", UintegerValue (4096));
 
     ApplicationContainer serverApp = videoServer.Install (nodes.Get (0));
     serverApp.Start (Seconds (0.0));
     serverApp.Stop (Seconds (100.0));
 
-    pointToPoint.EnablePcap ("videoStream", devices.Get (1), false);
+    if (pcap)
+    {
+      pointToPoint.EnablePcap ("videoStream", devices.Get (1), false);
+    }
+    AttachEventLog (eventLog);
     Simulator::Run ();
+    PrintResults ("case" + std::to_string (testCase), clientApp);
     Simulator::Destroy ();
   }
 
-  else if (CASE == 2)
+  else if (testCase == 2)
   {
+    const uint32_t nP2p = nClients == 0 ? 2 : nClients;
+    NS_ABORT_MSG_IF (nP2p > 255, "At most 255 clients fit in the 10.1.x.0 subnets");
     NodeContainer nodes;
-    nodes.Create (3);
-    NodeContainer n0n1= NodeContainer (nodes.Get(0), nodes.Get(1));
-    NodeContainer n0n2= NodeContainer (nodes.Get(0), nodes.Get(2));
+    nodes.Create (nP2p + 1);
 
     PointToPointHelper pointToPoint;
-    pointToPoint.SetDeviceAttribute ("DataRate", StringValue ("2Mbps"));
+    pointToPoint.SetDeviceAttribute ("DataRate", StringValue (dataRate.empty () ? "2Mbps" : dataRate));
     pointToPoint.SetChannelAttribute ("Delay", StringValue ("2ms"));
 
-    NetDeviceContainer d0d1= pointToPoint.Install (n0n1);
-    NetDeviceContainer d0d2= pointToPoint.Install (n0n2);
-
     InternetStackHelper stack;
     stack.Install (nodes);
 
     Ipv4AddressHelper address;
-    address.SetBase ("10.1.1.0", "255.255.255.0");
-    address.Assign (d0d1);
-
-    address.SetBase ("10.1.2.0", "255.255.255.0");
-    address.Assign (d0d2);
-
-    //Ipv4InterfaceContainer interfaces = address.Assign (devices);
-    Ipv4InterfaceContainer i0i1 = address.Assign (d0d1);
-    Ipv4InterfaceContainer i0i2 = address.Assign (d0d2);
-
-    VideoStreamClientHelper videoClient1 (i0i1.GetAddress (0), 5000);
-    ApplicationContainer clientApp1 = videoClient1.Install (nodes.Get (1));
-    clientApp1.Start (Seconds (1.0));
-    clientApp1.Stop (Seconds (100.0));
+    ApplicationContainer clientApps;
+    std::vector<NetDeviceContainer> devices;
+    for (uint32_t k = 0; k < nP2p; k++)
+    {
+      // one subnet per link, 10.1.1.0 for the first client
+      NetDeviceContainer d0dk = pointToPoint.Install (NodeContainer (nodes.Get (0), nodes.Get (k + 1)));
+      std::ostringstream subnet;
+      subnet << "10.1." << k + 1 << ".0";
+      address.SetBase (subnet.str ().c_str (), "255.255.255.0");
+      Ipv4InterfaceContainer i0ik = address.Assign (d0dk);
+      devices.push_back (d0dk);
 
-    VideoStreamClientHelper videoClient2 (i0i2.GetAddress (0), 5000);
-    ApplicationContainer clientApp2 = videoClient2.Install (nodes.Get (2));
-    clientApp2.Start (Seconds (0.5));
-    clientApp2.Stop (Seconds (100.0));
+      VideoStreamClientHelper videoClient (i0ik.GetAddress (0), 5000);
+      ApplicationContainer clientApp = videoClient.Install (nodes.Get (k + 1));
+      clientApp.Start (Seconds (k == 0 ? 1.0 : 0.5));
+      clientApp.Stop (Seconds (100.0));
+      clientApps.Add (clientApp);
+    }
 
     VideoStreamServerHelper videoServer (5000);
     videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
-    videoServer.SetAttribute ("FrameFile", StringValue ("./scratch/videoStreamer/small.txt"));
+    videoServer.SetAttribute ("FrameFile", StringValue (frameFile.empty () ? "./scratch/videoStreamer/small.txt" : frameFile));
     // videoServer.SetAttribute ("FrameSize", UintegerValue (4096));
 
     ApplicationContainer serverApp = videoServer.Install (nodes.Get (0));
     serverApp.Start (Seconds (0.0));
     serverApp.Stop (Seconds (100.0));
 
-    pointToPoint.EnablePcap ("videoStream", d0d1.Get (1), false);
-    pointToPoint.EnablePcap ("videoStream", d0d2.Get (1), false);
+    if (pcap)
+    {
+      for (uint32_t k = 0; k < nP2p; k++)
+      {
+        pointToPoint.EnablePcap ("videoStream", devices[k].Get (1), false);
+      }
+    }
+    AttachEventLog (eventLog);
     Simulator::Run ();
+    PrintResults ("case" + std::to_string (testCase), clientApps);
     Simulator::Destroy ();
   }
-  else if (CASE == 3)
+  else if (testCase == 3)
   {
-    const uint32_t nWifi = 3, nAp = 1;
+    const uint32_t nWifi = nClients == 0 ? 3 : nClients, nAp = 1;
     NodeContainer wifiStaNodes;
     wifiStaNodes.Create (nWifi);  
     NodeContainer wifiApNode;
@@ -195,7 +387,7 @@ main (int argc, char *argv[])
     //UdpEchoServerHelper echoServer (9);
     VideoStreamServerHelper videoServer (5000);
     videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
-    videoServer.SetAttribute ("FrameFile", StringValue ("./scratch/videoStreamer/small.txt"));
+    videoServer.SetAttribute ("FrameFile", StringValue (frameFile.empty () ? "./scratch/videoStreamer/small.txt" : frameFile));
     for(uint m=0; m<nAp; m++)
     {
       ApplicationContainer serverApps = videoServer.Install (wifiApNode.Get (m));
@@ -203,27 +395,36 @@ main (int argc, char *argv[])
       serverApps.Stop (Seconds (100.0));
     }
   
+    ApplicationContainer clientApps;
     for(uint k=0; k<nWifi; k++)
     {
       VideoStreamClientHelper videoClient (apInterfaces.GetAddress (0), 5000);
-      ApplicationContainer clientApps =
+      ApplicationContainer clientApp =
       videoClient.Install (wifiStaNodes.Get (k));
-      clientApps.Start (Seconds (0.5));
-      clientApps.Stop (Seconds (100.0));
+      clientApp.Start (Seconds (0.5));
+      clientApp.Stop (Seconds (100.0));
+      clientApps.Add (clientApp);
     }
   
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
   
     Simulator::Stop (Seconds (10.0));
   
-    phy.EnablePcap ("wifi-videoStream", apDevices.Get (0));
-    AnimationInterface anim("wifi-1-3.xml");
+    AnimationInterface *anim = 0;
+    if (pcap)
+    {
+      phy.EnablePcap ("wifi-videoStream", apDevices.Get (0));
+      anim = new AnimationInterface ("wifi-1-3.xml");
+    }
+    AttachEventLog (eventLog);
     Simulator::Run ();
+    PrintResults ("case" + std::to_string (testCase), clientApps);
     Simulator::Destroy ();
+    delete anim;
   }
-  else if (CASE == 4)
+  else if (testCase == 4)
   {
-    const uint32_t nWifi = 3, nAp = 3;
+    const uint32_t nWifi = nClients == 0 ? 3 : nClients, nAp = 3;
     NodeContainer wifiStaNodes;
     wifiStaNodes.Create (nWifi);  
     NodeContainer wifiApNode;
@@ -284,7 +485,7 @@ main (int argc, char *argv[])
     //UdpEchoServerHelper echoServer (9);
     VideoStreamServerHelper videoServer (5000);
     videoServer.SetAttribute ("MaxPacketSize", UintegerValue (1400));
-    videoServer.SetAttribute ("FrameFile", StringValue ("./scratch/videoStreamer/small.txt"));
+    videoServer.SetAttribute ("FrameFile", StringValue (frameFile.empty () ? "./scratch/videoStreamer/small.txt" : frameFile));
     for(uint m=0; m<nAp; m++)
     {
       ApplicationContainer serverApps = videoServer.Install (wifiApNode.Get (m));
@@ -292,23 +493,36 @@ main (int argc, char *argv[])
       serverApps.Stop (Seconds (100.0));
     }
   
+    ApplicationContainer clientApps;
     for(uint k=0; k<nWifi; k++)
     {
-      VideoStreamClientHelper videoClient (apInterfaces.GetAddress (k), 5000);
-      ApplicationContainer clientApps =
+      VideoStreamClientHelper videoClient (apInterfaces.GetAddress (k % nAp), 5000);
+      ApplicationContainer clientApp =
       videoClient.Install (wifiStaNodes.Get (k));
-      clientApps.Start (Seconds (0.5));
-      clientApps.Stop (Seconds (100.0));
+      clientApp.Start (Seconds (0.5));
+      clientApp.Stop (Seconds (100.0));
+      clientApps.Add (clientApp);
     }
   
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
   
     Simulator::Stop (Seconds (10.0));
   
-    phy.EnablePcap ("wifi-videoStream", apDevices.Get (0));
-    AnimationInterface anim("wifi-1-3.xml");
+    AnimationInterface *anim = 0;
+    if (pcap)
+    {
+      phy.EnablePcap ("wifi-videoStream", apDevices.Get (0));
+      anim = new AnimationInterface ("wifi-1-3.xml");
+    }
+    AttachEventLog (eventLog);
     Simulator::Run ();
+    PrintResults ("case" + std::to_string (testCase), clientApps);
     Simulator::Destroy ();
+    delete anim;
+  }
+  else
+  {
+    NS_FATAL_ERROR ("Unknown test case " << testCase);
   }
 
   return 0;
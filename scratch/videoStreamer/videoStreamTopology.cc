@@ -0,0 +1,327 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mobility-module.h"
+#include "videoStreamTopology.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamTopology");
+
+VideoStreamTopology::VideoStreamTopology ()
+  : m_nServers (1),
+    m_nClients (16),
+    m_dataRate ("100Mbps"),
+    m_delay ("2ms"),
+    m_bottleneckRate ("1Gbps"),
+    m_bottleneckDelay ("10ms"),
+    m_nAps (4),
+    m_apSpacing (100.0),
+    m_cellRadius (30.0),
+    m_fanout (4),
+    m_depth (2),
+    m_nLevels (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+VideoStreamTopology::AddCommandLineValues (CommandLine &cmd)
+{
+  cmd.AddValue ("nServers", "Number of servers of the topology", m_nServers);
+  cmd.AddValue ("linkDelay", "Delay of the access links of the topology", m_delay);
+  cmd.AddValue ("bottleneckRate", "Data rate of the dumbbell bottleneck and of the tree links", m_bottleneckRate);
+  cmd.AddValue ("bottleneckDelay", "Delay of the dumbbell bottleneck and of the tree links", m_bottleneckDelay);
+  cmd.AddValue ("nAps", "Number of access points of the wifi topology", m_nAps);
+  cmd.AddValue ("apSpacing", "Distance between the access points in meters", m_apSpacing);
+  cmd.AddValue ("cellRadius", "Largest distance between a station and its access point in meters", m_cellRadius);
+  cmd.AddValue ("fanout", "Number of children of each router of the tree", m_fanout);
+  cmd.AddValue ("depth", "Number of router levels below the root of the tree", m_depth);
+}
+
+void
+VideoStreamTopology::SetNClients (uint32_t nClients)
+{
+  NS_LOG_FUNCTION (this << nClients);
+  m_nClients = nClients;
+}
+
+void
+VideoStreamTopology::SetDataRate (const std::string &dataRate)
+{
+  NS_LOG_FUNCTION (this << dataRate);
+  m_dataRate = dataRate;
+}
+
+void
+VideoStreamTopology::Build (const std::string &topology)
+{
+  NS_LOG_FUNCTION (this << topology);
+  NS_ABORT_MSG_IF (m_nServers == 0 || m_nClients == 0, "The topology needs at least one server and one client");
+
+  m_servers.Create (m_nServers);
+  m_clients.Create (m_nClients);
+  m_serverAddresses.clear ();
+  m_downlinks.clear ();
+  m_topology = topology;
+  m_linkAddress.SetBase ("10.0.0.0", "255.255.255.252");
+  m_cellAddress.SetBase ("10.128.0.0", "255.255.0.0");
+
+  InternetStackHelper stack;
+  stack.Install (m_servers);
+  if (topology != "wifi")
+  {
+    // the stations get their stack once their access point is known
+    stack.Install (m_clients);
+  }
+
+  if (topology == "star")
+  {
+    NodeContainer router;
+    router.Create (1);
+    stack.Install (router);
+    ConnectServers (router.Get (0));
+    ConnectClients (router);
+  }
+  else if (topology == "dumbbell")
+  {
+    NodeContainer routers;
+    routers.Create (2);
+    stack.Install (routers);
+
+    PointToPointHelper bottleneck;
+    bottleneck.SetDeviceAttribute ("DataRate", StringValue (m_bottleneckRate));
+    bottleneck.SetChannelAttribute ("Delay", StringValue (m_bottleneckDelay));
+    Connect (bottleneck, routers.Get (0), routers.Get (1), true);
+
+    ConnectServers (routers.Get (0));
+    ConnectClients (NodeContainer (routers.Get (1)));
+  }
+  else if (topology == "wifi")
+  {
+    NodeContainer router;
+    router.Create (1);
+    stack.Install (router);
+    ConnectServers (router.Get (0));
+    BuildWifi (router.Get (0));
+  }
+  else if (topology == "tree")
+  {
+    NodeContainer root;
+    root.Create (1);
+    stack.Install (root);
+    ConnectServers (root.Get (0));
+    ConnectClients (BuildTree (root.Get (0)));
+  }
+  else
+  {
+    NS_FATAL_ERROR ("Unknown topology " << topology);
+  }
+
+  NS_LOG_INFO ("Built a " << topology << " topology with " << m_nServers << " servers and " << m_nClients << " clients");
+  Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+}
+
+NodeContainer
+VideoStreamTopology::GetServers (void) const
+{
+  return m_servers;
+}
+
+NodeContainer
+VideoStreamTopology::GetClients (void) const
+{
+  return m_clients;
+}
+
+Ipv4Address
+VideoStreamTopology::GetServerAddress (uint32_t client) const
+{
+  return m_serverAddresses[client % m_serverAddresses.size ()];
+}
+
+void
+VideoStreamTopology::EnableMulticast (Ipv4Address firstGroup, uint32_t nLevels)
+{
+  NS_LOG_FUNCTION (this << firstGroup << nLevels);
+  NS_ABORT_MSG_IF (m_topology.empty () || m_topology == "wifi", "Multicast is only routed in the point-to-point topologies");
+
+  m_multicastGroup = firstGroup;
+  m_nLevels = nLevels;
+  Ipv4StaticRoutingHelper routing;
+  for (uint32_t i = 0; i < m_servers.GetN (); i++)
+  {
+    // the groups of the server flood the tree of links below it
+    Ptr<Node> server = m_servers.Get (i);
+    const std::vector<Downlink> &serverLinks = m_downlinks[server->GetId ()];
+    NS_ASSERT (serverLinks.size () == 1);
+    routing.SetDefaultMulticastRoute (server, serverLinks[0].m_upper);
+
+    std::vector<Ptr<NetDevice> > inputs (1, serverLinks[0].m_lower);
+    while (!inputs.empty ())
+    {
+      Ptr<NetDevice> input = inputs.back ();
+      inputs.pop_back ();
+      Ptr<Node> router = input->GetNode ();
+      NetDeviceContainer outputs;
+      const std::vector<Downlink> &links = m_downlinks[router->GetId ()];
+      for (std::vector<Downlink>::const_iterator it = links.begin (); it != links.end (); ++it)
+      {
+        outputs.Add (it->m_upper);
+        inputs.push_back (it->m_lower);
+      }
+      for (uint32_t level = 0; outputs.GetN () > 0 && level < nLevels; level++)
+      {
+        Ipv4Address group (firstGroup.Get () + i * nLevels + level);
+        routing.AddMulticastRoute (router, m_serverAddresses[i], group, input, outputs);
+      }
+    }
+  }
+}
+
+Ipv4Address
+VideoStreamTopology::GetMulticastGroup (uint32_t client) const
+{
+  return Ipv4Address (m_multicastGroup.Get () + (client % m_servers.GetN ()) * m_nLevels);
+}
+
+Ipv4Address
+VideoStreamTopology::Connect (PointToPointHelper &link, Ptr<Node> a, Ptr<Node> b, bool downward)
+{
+  NetDeviceContainer devices = link.Install (a, b);
+  Downlink downlink;
+  downlink.m_upper = devices.Get (downward ? 0 : 1);
+  downlink.m_lower = devices.Get (downward ? 1 : 0);
+  m_downlinks[downlink.m_upper->GetNode ()->GetId ()].push_back (downlink);
+
+  Ipv4InterfaceContainer interfaces = m_linkAddress.Assign (devices);
+  m_linkAddress.NewNetwork ();
+  return interfaces.GetAddress (0);
+}
+
+void
+VideoStreamTopology::ConnectServers (Ptr<Node> router)
+{
+  PointToPointHelper access;
+  access.SetDeviceAttribute ("DataRate", StringValue (m_dataRate));
+  access.SetChannelAttribute ("Delay", StringValue (m_delay));
+  for (uint32_t i = 0; i < m_servers.GetN (); i++)
+  {
+    m_serverAddresses.push_back (Connect (access, m_servers.Get (i), router, true));
+  }
+}
+
+void
+VideoStreamTopology::ConnectClients (NodeContainer routers)
+{
+  PointToPointHelper access;
+  access.SetDeviceAttribute ("DataRate", StringValue (m_dataRate));
+  access.SetChannelAttribute ("Delay", StringValue (m_delay));
+  for (uint32_t i = 0; i < m_clients.GetN (); i++)
+  {
+    Connect (access, m_clients.Get (i), routers.Get (i % routers.GetN ()), false);
+  }
+}
+
+void
+VideoStreamTopology::BuildWifi (Ptr<Node> router)
+{
+  NS_ABORT_MSG_IF (m_nAps == 0 || m_nAps > 127, "The wifi topology needs between 1 and 127 access points");
+
+  NodeContainer aps;
+  aps.Create (m_nAps);
+  InternetStackHelper stack;
+  stack.Install (aps);
+  stack.Install (m_clients);
+
+  PointToPointHelper backhaul;
+  backhaul.SetDeviceAttribute ("DataRate", StringValue (m_bottleneckRate));
+  backhaul.SetChannelAttribute ("Delay", StringValue (m_delay));
+
+  WifiHelper wifi;
+  wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
+  uint32_t gridWidth = std::ceil (std::sqrt (m_nAps));
+
+  for (uint32_t i = 0; i < m_nAps; i++)
+  {
+    Connect (backhaul, aps.Get (i), router, false);
+
+    NodeContainer stations;
+    for (uint32_t k = i; k < m_clients.GetN (); k += m_nAps)
+    {
+      stations.Add (m_clients.Get (k));
+    }
+
+    // a channel per access point, so that the cells do not interfere
+    YansWifiChannelHelper channel = YansWifiChannelHelper::Default ();
+    YansWifiPhyHelper phy = YansWifiPhyHelper::Default ();
+    phy.SetChannel (channel.Create ());
+
+    std::ostringstream ssidName;
+    ssidName << "ns-3-video-" << i;
+    Ssid ssid = Ssid (ssidName.str ());
+    WifiMacHelper mac;
+    mac.SetType ("ns3::StaWifiMac",
+                 "Ssid", SsidValue (ssid),
+                 "ActiveProbing", BooleanValue (false));
+    NetDeviceContainer staDevices = wifi.Install (phy, mac, stations);
+    mac.SetType ("ns3::ApWifiMac",
+                 "Ssid", SsidValue (ssid));
+    NetDeviceContainer apDevices = wifi.Install (phy, mac, aps.Get (i));
+
+    double x = (i % gridWidth) * m_apSpacing;
+    double y = (i / gridWidth) * m_apSpacing;
+    MobilityHelper mobility;
+    mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                   "MinX", DoubleValue (x),
+                                   "MinY", DoubleValue (y));
+    mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+    mobility.Install (aps.Get (i));
+
+    std::ostringstream rho;
+    rho << "ns3::UniformRandomVariable[Min=0.0|Max=" << m_cellRadius << "]";
+    mobility.SetPositionAllocator ("ns3::RandomDiscPositionAllocator",
+                                   "X", DoubleValue (x),
+                                   "Y", DoubleValue (y),
+                                   "Rho", StringValue (rho.str ()));
+    mobility.Install (stations);
+
+    m_cellAddress.Assign (apDevices);
+    m_cellAddress.Assign (staDevices);
+    m_cellAddress.NewNetwork ();
+  }
+}
+
+NodeContainer
+VideoStreamTopology::BuildTree (Ptr<Node> root)
+{
+  NS_ABORT_MSG_IF (m_fanout == 0, "The tree needs a fanout of at least 1");
+
+  PointToPointHelper trunk;
+  trunk.SetDeviceAttribute ("DataRate", StringValue (m_bottleneckRate));
+  trunk.SetChannelAttribute ("Delay", StringValue (m_bottleneckDelay));
+  InternetStackHelper stack;
+
+  NodeContainer level (root);
+  for (uint32_t depth = 0; depth < m_depth; depth++)
+  {
+    NodeContainer children;
+    children.Create (level.GetN () * m_fanout);
+    stack.Install (children);
+    for (uint32_t i = 0; i < children.GetN (); i++)
+    {
+      Connect (trunk, level.Get (i / m_fanout), children.Get (i), true);
+    }
+    level = children;
+  }
+  return level;
+}
+
+} // namespace ns3
@@ -0,0 +1,194 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_TOPOLOGY_H
+#define VIDEO_STREAM_TOPOLOGY_H
+
+#include "ns3/command-line.h"
+#include "ns3/node-container.h"
+#include "ns3/ipv4-address.h"
+#include "ns3/net-device-container.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/point-to-point-helper.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief Build a network of video stream servers and clients.
+   *
+   * The topologies are:
+   * - star: every server and client hangs off one router;
+   * - dumbbell: the servers hang off one router and the clients off another,
+   *   the two routers being joined by a bottleneck link;
+   * - wifi: the servers and the access points hang off one router, and the
+   *   clients are stations spread over the access points, each access point
+   *   having its own channel;
+   * - tree: the servers hang off the root of a tree of routers, and the
+   *   clients off its leaves.
+   *
+   * Client k streams from server k modulo the number of servers. Every
+   * point-to-point link gets its own /30 subnet in 10.0.0.0/9, and every
+   * access point its own /16 subnet from 10.128.0.0, so the builder scales
+   * to thousands of nodes.
+   *
+   * For the servers multicasting one group per video level, the routers of
+   * the point-to-point topologies can forward the groups of each server to
+   * all the links below them. Without group membership in ns-3, every client
+   * link carries every level watched by a client of the server.
+   */
+  class VideoStreamTopology
+  {
+  public:
+    VideoStreamTopology ();
+
+    /**
+     * @brief Add the parameters of the topology to a command line.
+     *
+     * @param cmd the command line
+     */
+    void AddCommandLineValues (CommandLine &cmd);
+
+    /**
+     * @brief Set the number of clients.
+     *
+     * @param nClients the number of clients
+     */
+    void SetNClients (uint32_t nClients);
+
+    /**
+     * @brief Set the data rate of the access links.
+     *
+     * @param dataRate the data rate, e.g. "100Mbps"
+     */
+    void SetDataRate (const std::string &dataRate);
+
+    /**
+     * @brief Create the nodes, links and addresses of the topology.
+     *
+     * @param topology the name of the topology (star, dumbbell, wifi or tree)
+     */
+    void Build (const std::string &topology);
+
+    /**
+     * @brief Get the server nodes.
+     *
+     * @return the server nodes
+     */
+    NodeContainer GetServers (void) const;
+
+    /**
+     * @brief Get the client nodes.
+     *
+     * @return the client nodes
+     */
+    NodeContainer GetClients (void) const;
+
+    /**
+     * @brief Get the address of the server a client streams from.
+     *
+     * @param client the index of the client
+     * @return the address of the server
+     */
+    Ipv4Address GetServerAddress (uint32_t client) const;
+
+    /**
+     * @brief Route the multicast groups of the servers down to the clients.
+     *
+     * Server k gets the groups from firstGroup + k * nLevels, one per video
+     * level. Only the point-to-point topologies are supported.
+     *
+     * @param firstGroup the group of video level 1 of the first server
+     * @param nLevels the number of video levels
+     */
+    void EnableMulticast (Ipv4Address firstGroup, uint32_t nLevels);
+
+    /**
+     * @brief Get the group of video level 1 of the server a client streams
+     * from.
+     *
+     * @param client the index of the client
+     * @return the multicast group
+     */
+    Ipv4Address GetMulticastGroup (uint32_t client) const;
+
+  private:
+    /**
+     * @brief A point-to-point link, oriented from the servers to the
+     * clients.
+     */
+    typedef struct Downlink
+    {
+      Ptr<NetDevice> m_upper; //!< Device of the node closer to the servers
+      Ptr<NetDevice> m_lower; //!< Device of the node closer to the clients
+    } Downlink;
+
+    /**
+     * @brief Join two nodes with a point-to-point link in a new subnet.
+     *
+     * @param link the helper configured for the link
+     * @param a the first node
+     * @param b the second node
+     * @param downward whether the traffic of the servers flows from a to b
+     * @return the address of the first node on the link
+     */
+    Ipv4Address Connect (PointToPointHelper &link, Ptr<Node> a, Ptr<Node> b, bool downward);
+
+    /**
+     * @brief Hang the servers off a router.
+     *
+     * @param router the router
+     */
+    void ConnectServers (Ptr<Node> router);
+
+    /**
+     * @brief Hang the clients off routers, round-robin.
+     *
+     * @param routers the routers
+     */
+    void ConnectClients (NodeContainer routers);
+
+    /**
+     * @brief Spread the clients as stations over access points hanging off
+     * a router.
+     *
+     * @param router the router
+     */
+    void BuildWifi (Ptr<Node> router);
+
+    /**
+     * @brief Build a tree of routers below a root.
+     *
+     * @param root the root of the tree
+     * @return the leaves of the tree
+     */
+    NodeContainer BuildTree (Ptr<Node> root);
+
+    uint32_t m_nServers; //!< Number of servers
+    uint32_t m_nClients; //!< Number of clients
+    std::string m_dataRate; //!< Data rate of the access links
+    std::string m_delay; //!< Delay of the access links
+    std::string m_bottleneckRate; //!< Data rate of the dumbbell bottleneck and the tree links
+    std::string m_bottleneckDelay; //!< Delay of the dumbbell bottleneck and the tree links
+    uint32_t m_nAps; //!< Number of access points of the wifi topology
+    double m_apSpacing; //!< Distance between the access points in meters
+    double m_cellRadius; //!< Largest distance between a station and its access point in meters
+    uint32_t m_fanout; //!< Number of children of each router of the tree
+    uint32_t m_depth; //!< Number of router levels below the root of the tree
+
+    NodeContainer m_servers; //!< Server nodes
+    NodeContainer m_clients; //!< Client nodes
+    std::vector<Ipv4Address> m_serverAddresses; //!< Address of each server
+    Ipv4AddressHelper m_linkAddress; //!< Allocator of the point-to-point subnets
+    Ipv4AddressHelper m_cellAddress; //!< Allocator of the wifi subnets
+    std::string m_topology; //!< Name of the topology built
+    std::map<uint32_t, std::vector<Downlink> > m_downlinks; //!< Links below each node, by node id
+    Ipv4Address m_multicastGroup; //!< Group of video level 1 of the first server
+    uint32_t m_nLevels; //!< Number of groups of each server
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_TOPOLOGY_H */
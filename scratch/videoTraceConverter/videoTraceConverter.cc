@@ -0,0 +1,80 @@
+/*****************************************************
+*
+* File:  videoTraceConverter.cc
+*
+* Explanation:  This script converts text frame files
+*               (one frame size per line, such as
+*               frameList.txt) into the binary trace
+*               format read by the video stream server.
+*               The frame types (I, P or B after the
+*               size) of the first typed input are kept.
+*
+*               Each input file becomes one level column:
+*               ./waf --run "videoTraceConverter
+*                 --input=low.txt,high.txt --output=trace.vst"
+*
+*****************************************************/
+#include "ns3/core-module.h"
+#include "ns3/applications-module.h"
+
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("VideoTraceConverter");
+
+int
+main (int argc, char *argv[])
+{
+  std::string input = "./scratch/videoStreamer/frameList.txt";
+  std::string output = "./scratch/videoStreamer/frameList.vst";
+  uint32_t frameRate = 25;
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Comma-separated text frame files, one per video level", input);
+  cmd.AddValue ("output", "Name of the binary trace file to write", output);
+  cmd.AddValue ("frameRate", "Frame rate stored in the trace header (0 if unknown)", frameRate);
+  cmd.Parse (argc, argv);
+
+  std::vector<std::vector<uint32_t> > levels;
+  std::vector<uint8_t> frameTypes;
+  std::stringstream inputStream (input);
+  std::string fileName;
+  while (std::getline (inputStream, fileName, ','))
+  {
+    Ptr<const VideoStreamTrace> trace = VideoStreamTrace::Load (fileName);
+    if (trace->IsEmpty ())
+    {
+      NS_FATAL_ERROR ("No frame sizes in " << fileName);
+    }
+    if (!levels.empty () && trace->GetNFrames () != levels[0].size ())
+    {
+      NS_FATAL_ERROR (fileName << " has " << trace->GetNFrames () << " frames instead of " << levels[0].size ());
+    }
+
+    std::vector<uint32_t> frameSizes (trace->GetNFrames ());
+    for (uint32_t i = 0; i < frameSizes.size (); i++)
+    {
+      frameSizes[i] = trace->GetFrameSize (i);
+    }
+    levels.push_back (frameSizes);
+
+    // the levels share the group of pictures structure of the first typed input
+    if (frameTypes.empty () && trace->HasFrameTypes ())
+    {
+      frameTypes.resize (trace->GetNFrames ());
+      for (uint32_t i = 0; i < frameTypes.size (); i++)
+      {
+        frameTypes[i] = trace->GetFrameType (i);
+      }
+    }
+  }
+
+  if (levels.empty () || !VideoStreamTrace::WriteBinary (output, levels, frameTypes, frameRate))
+  {
+    NS_FATAL_ERROR ("Failed to write " << output);
+  }
+  std::cout << "Wrote " << levels[0].size () << " frames in " << levels.size () << " level(s) to " << output << std::endl;
+
+  return 0;
+}
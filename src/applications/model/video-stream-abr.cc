@@ -0,0 +1,309 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/video-stream-abr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamAbr");
+
+NS_OBJECT_ENSURE_REGISTERED (AbrAlgorithm);
+NS_OBJECT_ENSURE_REGISTERED (LegacyAbr);
+NS_OBJECT_ENSURE_REGISTERED (BbaAbr);
+NS_OBJECT_ENSURE_REGISTERED (ThroughputAbr);
+NS_OBJECT_ENSURE_REGISTERED (MpcAbr);
+
+TypeId
+AbrAlgorithm::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::AbrAlgorithm")
+    .SetParent<Object> ()
+    .SetGroupName ("Applications")
+  ;
+  return tid;
+}
+
+AbrAlgorithm::AbrAlgorithm ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+AbrAlgorithm::~AbrAlgorithm ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+double
+AbrAlgorithm::GetBufferSeconds (const AbrContext &context)
+{
+  return (double) context.m_bufferFrames / context.m_frameRate;
+}
+
+double
+AbrAlgorithm::GetLevelBitrate (const AbrContext &context, uint16_t level)
+{
+  if (!context.m_ladderBitrates.empty ())
+  {
+    return context.m_ladderBitrates[std::min<size_t> (level, context.m_ladderBitrates.size ()) - 1];
+  }
+  return level * context.m_levelBitrate;
+}
+
+TypeId
+LegacyAbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LegacyAbr")
+    .SetParent<AbrAlgorithm> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<LegacyAbr> ()
+  ;
+  return tid;
+}
+
+LegacyAbr::LegacyAbr ()
+  : m_bufferAtRaise (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint16_t
+LegacyAbr::SelectLevel (const AbrContext &context)
+{
+  NS_LOG_FUNCTION (this);
+
+  double buffer = GetBufferSeconds (context);
+  // The rebuffering event has happend 3+ times, which suggest the client to lower the video quality.
+  if (context.m_rebufferCount >= 3 && context.m_videoLevel > 1)
+  {
+    m_bufferAtRaise = 0;
+    return context.m_videoLevel - 1;
+  }
+  // If the current buffer size supports 5+ seconds video, we can try to increase the video quality level.
+  m_bufferAtRaise = std::min (m_bufferAtRaise, buffer);
+  if (buffer > 5 && buffer >= m_bufferAtRaise + 4 && context.m_videoLevel < context.m_maxLevel)
+  {
+    m_bufferAtRaise = buffer;
+    return context.m_videoLevel + 1;
+  }
+  return context.m_videoLevel;
+}
+
+TypeId
+BbaAbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BbaAbr")
+    .SetParent<AbrAlgorithm> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<BbaAbr> ()
+    .AddAttribute ("Reservoir", "The buffer level below which the lowest video level is used",
+                    TimeValue (Seconds (5.0)),
+                    MakeTimeAccessor (&BbaAbr::m_reservoir),
+                    MakeTimeChecker ())
+    .AddAttribute ("Cushion", "The buffer range over which the video level rises from the lowest to the highest",
+                    TimeValue (Seconds (10.0)),
+                    MakeTimeAccessor (&BbaAbr::m_cushion),
+                    MakeTimeChecker (Seconds (0.001)))
+  ;
+  return tid;
+}
+
+BbaAbr::BbaAbr ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint16_t
+BbaAbr::SelectLevel (const AbrContext &context)
+{
+  NS_LOG_FUNCTION (this);
+
+  // the rates of a ladder need not grow linearly with the level
+  uint16_t maxLevel = context.m_maxLevel;
+  bool known = GetLevelBitrate (context, 1) > 0;
+  std::vector<double> rates (maxLevel + 1, 0);
+  for (uint16_t level = 1; level <= maxLevel; level++)
+  {
+    rates[level] = known ? GetLevelBitrate (context, level) : level;
+  }
+
+  double buffer = GetBufferSeconds (context);
+  double mapped = rates[1] + (buffer - m_reservoir.GetSeconds ()) / m_cushion.GetSeconds () * (rates[maxLevel] - rates[1]);
+  if (mapped <= rates[1])
+  {
+    return 1;
+  }
+  if (mapped >= rates[maxLevel])
+  {
+    return maxLevel;
+  }
+
+  uint16_t level = std::min<uint16_t> (std::max<uint16_t> (context.m_videoLevel, 1), maxLevel);
+  if (level < maxLevel && mapped >= rates[level + 1])
+  {
+    // the highest level whose bitrate is at or below the mapped one
+    while (level < maxLevel && rates[level + 1] <= mapped)
+    {
+      level++;
+    }
+  }
+  else if (level > 1 && mapped <= rates[level - 1])
+  {
+    // the lowest level whose bitrate is above the mapped one
+    while (level > 1 && rates[level - 1] > mapped)
+    {
+      level--;
+    }
+  }
+  return level;
+}
+
+TypeId
+ThroughputAbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ThroughputAbr")
+    .SetParent<AbrAlgorithm> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<ThroughputAbr> ()
+    .AddAttribute ("SafetyFactor", "The share of the estimated throughput the bitrate of the video level may use",
+                    DoubleValue (0.8),
+                    MakeDoubleAccessor (&ThroughputAbr::m_safetyFactor),
+                    MakeDoubleChecker<double> (0.0, 1.0))
+  ;
+  return tid;
+}
+
+ThroughputAbr::ThroughputAbr ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint16_t
+ThroughputAbr::SelectLevel (const AbrContext &context)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (context.m_throughput <= 0 || GetLevelBitrate (context, 1) <= 0)
+  {
+    return context.m_videoLevel;
+  }
+  uint16_t level = 1;
+  while (level < context.m_maxLevel
+         && GetLevelBitrate (context, level + 1) <= m_safetyFactor * context.m_throughput)
+  {
+    level++;
+  }
+  return level;
+}
+
+TypeId
+MpcAbr::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::MpcAbr")
+    .SetParent<AbrAlgorithm> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<MpcAbr> ()
+    .AddAttribute ("Horizon", "The number of seconds of video planned ahead",
+                    UintegerValue (5),
+                    MakeUintegerAccessor (&MpcAbr::m_horizon),
+                    MakeUintegerChecker<uint32_t> (1, 8))
+    .AddAttribute ("RebufferPenalty", "The penalty of a second of rebuffering, in Mbit/s of bitrate",
+                    DoubleValue (20.0),
+                    MakeDoubleAccessor (&MpcAbr::m_rebufferPenalty),
+                    MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("SwitchPenalty", "The penalty of a change of bitrate, per Mbit/s of change",
+                    DoubleValue (1.0),
+                    MakeDoubleAccessor (&MpcAbr::m_switchPenalty),
+                    MakeDoubleChecker<double> (0.0))
+  ;
+  return tid;
+}
+
+MpcAbr::MpcAbr ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+uint16_t
+MpcAbr::SelectLevel (const AbrContext &context)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (context.m_throughput <= 0 || GetLevelBitrate (context, 1) <= 0)
+  {
+    return context.m_videoLevel;
+  }
+
+  AbrContext predicted = context;
+  if (context.m_harmonicThroughput > 0)
+  {
+    predicted.m_throughput = context.m_harmonicThroughput;
+  }
+
+  uint16_t bestLevel = context.m_videoLevel;
+  double bestQoe = -std::numeric_limits<double>::infinity ();
+  double buffer = GetBufferSeconds (context);
+  m_plans.clear ();
+  for (uint16_t level = 1; level <= context.m_maxLevel; level++)
+  {
+    double nextBuffer = buffer;
+    double qoe = GetStepQoe (predicted, level, context.m_videoLevel, nextBuffer)
+      + Plan (predicted, 1, nextBuffer, level);
+    if (qoe > bestQoe)
+    {
+      bestQoe = qoe;
+      bestLevel = level;
+    }
+  }
+  NS_LOG_LOGIC ("Best plan starts at level " << bestLevel << " with QoE " << bestQoe);
+  return bestLevel;
+}
+
+double
+MpcAbr::GetStepQoe (const AbrContext &context, uint16_t level, uint16_t lastLevel, double &buffer) const
+{
+  // one second of video at the level, downloaded at the estimated throughput
+  double bitrate = GetLevelBitrate (context, level);
+  double downloadTime = bitrate / context.m_throughput;
+  double rebuffer = std::max (0.0, downloadTime - buffer);
+  buffer = std::max (0.0, buffer - downloadTime) + 1;
+
+  return bitrate / 1e6 - m_rebufferPenalty * rebuffer
+    - m_switchPenalty * std::abs (bitrate - GetLevelBitrate (context, lastLevel)) / 1e6;
+}
+
+double
+MpcAbr::Plan (const AbrContext &context, uint32_t step, double buffer, uint16_t lastLevel)
+{
+  if (step == m_horizon)
+  {
+    return 0;
+  }
+
+  // the states are solved on the rounded buffer level, so that the sequences
+  // reaching nearly the same buffer share their remaining plan
+  int64_t hundredths = std::llround (buffer * 100);
+  PlanState state (step, hundredths, lastLevel);
+  auto iter = m_plans.find (state);
+  if (iter != m_plans.end ())
+  {
+    return iter->second;
+  }
+
+  double best = -std::numeric_limits<double>::infinity ();
+  for (uint16_t level = 1; level <= context.m_maxLevel; level++)
+  {
+    double nextBuffer = hundredths / 100.0;
+    double qoe = GetStepQoe (context, level, lastLevel, nextBuffer);
+    best = std::max (best, qoe + Plan (context, step + 1, nextBuffer, level));
+  }
+  m_plans[state] = best;
+  return best;
+}
+
+} // namespace ns3
@@ -0,0 +1,224 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_ABR_H
+#define VIDEO_STREAM_ABR_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief What a client knows when it chooses the next video level.
+   */
+  typedef struct AbrContext
+  {
+    uint16_t m_videoLevel; //!< Current video level
+    uint16_t m_maxLevel; //!< Highest video level
+    uint32_t m_frameRate; //!< Number of frames played per second
+    uint32_t m_bufferFrames; //!< Number of complete frames in the buffer
+    uint16_t m_rebufferCount; //!< Number of rebuffering events in a row
+    double m_throughput; //!< Moving average of the throughput in bit/s (0 if unknown)
+    double m_harmonicThroughput; //!< Harmonic mean of the last throughput samples in bit/s (0 if unknown)
+    Time m_rtt; //!< Smoothed round-trip time to the server (0 if unknown)
+    double m_levelBitrate; //!< Estimated bitrate of level 1 in bit/s, level l being l times as much (0 if unknown)
+    std::vector<double> m_ladderBitrates; //!< Nominal bitrate of each level in bit/s from the representation ladder, level l at index l - 1 (empty if unknown)
+  } AbrContext;
+
+  /**
+   * @brief Base class of the adaptive bitrate algorithms of the video
+   * stream client.
+   *
+   * The client asks the algorithm for a video level once per second, and
+   * as soon as the estimated throughput falls below the bitrate of the
+   * current level. It asks the server to switch when the level changes.
+   */
+  class AbrAlgorithm : public Object
+  {
+  public:
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    AbrAlgorithm ();
+    virtual ~AbrAlgorithm ();
+
+    /**
+     * @brief Choose the video level of the next frames.
+     *
+     * @param context the state of the client
+     * @return the video level, between 1 and the highest level
+     */
+    virtual uint16_t SelectLevel (const AbrContext &context) = 0;
+
+  protected:
+    /**
+     * @brief Get the buffer level in seconds of playback.
+     *
+     * @param context the state of the client
+     * @return the buffer level in seconds
+     */
+    static double GetBufferSeconds (const AbrContext &context);
+
+    /**
+     * @brief Get the bitrate of a level, from the representation ladder if
+     * the client has one, from the estimated bitrate of level 1 otherwise.
+     *
+     * @param context the state of the client
+     * @param level the video level
+     * @return the bitrate in bit/s (0 if unknown)
+     */
+    static double GetLevelBitrate (const AbrContext &context, uint16_t level);
+  };
+
+  /**
+   * @brief The original rule of the client: drop a level after 3
+   * rebuffering events in a row, raise it once 5 seconds are buffered.
+   *
+   * After a raise, the buffer has to grow by another 4 seconds from its
+   * lowest point before the next one, which the client used to enforce by
+   * discarding buffered frames.
+   */
+  class LegacyAbr : public AbrAlgorithm
+  {
+  public:
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    LegacyAbr ();
+
+    virtual uint16_t SelectLevel (const AbrContext &context);
+
+  private:
+    double m_bufferAtRaise; //!< Buffer level in seconds at the last raise
+  };
+
+  /**
+   * @brief Buffer-based adaptation (BBA-0, Huang et al., SIGCOMM 2014).
+   *
+   * The buffer level is mapped to a bitrate: the one of the lowest level
+   * below the reservoir, the one of the highest level above the reservoir
+   * plus the cushion, and linearly in between. The level rises once the
+   * mapped bitrate reaches the bitrate of the next level, to the highest
+   * level whose bitrate is at or below it, and falls once it reaches the
+   * bitrate of the previous level, to the lowest level whose bitrate is
+   * above it, which keeps it from oscillating. Until the bitrates are
+   * known, they are taken as growing linearly with the level.
+   */
+  class BbaAbr : public AbrAlgorithm
+  {
+  public:
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    BbaAbr ();
+
+    virtual uint16_t SelectLevel (const AbrContext &context);
+
+  private:
+    Time m_reservoir; //!< Buffer level below which the lowest level is used
+    Time m_cushion; //!< Buffer range over which the level rises to the highest one
+  };
+
+  /**
+   * @brief Rate-based adaptation: the highest level whose bitrate fits in a
+   * share of the estimated throughput.
+   */
+  class ThroughputAbr : public AbrAlgorithm
+  {
+  public:
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    ThroughputAbr ();
+
+    virtual uint16_t SelectLevel (const AbrContext &context);
+
+  private:
+    double m_safetyFactor; //!< Share of the estimated throughput the bitrate may use
+  };
+
+  /**
+   * @brief Model predictive control (Yin et al., SIGCOMM 2015).
+   *
+   * The algorithm simulates the buffer over the next seconds of video for
+   * every sequence of levels, assuming the harmonic mean of the last
+   * throughput samples (the moving average until there is one), and keeps
+   * the first level of the sequence with the best quality of experience:
+   * the bitrate played, minus a penalty per second of rebuffering and per
+   * change of bitrate. The search is a dynamic program over the states of
+   * the plan, the planned second, the buffer level rounded to 10 ms and
+   * the last level, so the cost of a decision grows linearly with the
+   * horizon instead of exponentially.
+   */
+  class MpcAbr : public AbrAlgorithm
+  {
+  public:
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+
+    MpcAbr ();
+
+    virtual uint16_t SelectLevel (const AbrContext &context);
+
+  private:
+    friend class VideoStreamAbrTestCase;
+
+    /**
+     * @brief Get the quality of experience of one second of video.
+     *
+     * @param context the state of the client
+     * @param level the level of the second
+     * @param lastLevel the level of the previous second
+     * @param buffer the buffer level in seconds, updated to the level after
+     * the second is downloaded
+     * @return the quality of experience of the second
+     */
+    double GetStepQoe (const AbrContext &context, uint16_t level, uint16_t lastLevel, double &buffer) const;
+
+    /**
+     * @brief Get the best quality of experience reachable from a state,
+     * from the states already solved for the current decision if possible.
+     *
+     * @param context the state of the client
+     * @param step the number of seconds already planned
+     * @param buffer the buffer level in seconds
+     * @param lastLevel the level of the previous second
+     * @return the quality of experience of the remaining seconds
+     */
+    double Plan (const AbrContext &context, uint32_t step, double buffer, uint16_t lastLevel);
+
+    typedef std::tuple<uint32_t, int64_t, uint16_t> PlanState; //!< Planned second, buffer level in hundredths of a second and last level
+
+    uint32_t m_horizon; //!< Number of seconds of video planned ahead
+    double m_rebufferPenalty; //!< Penalty per second of rebuffering, in Mbit/s
+    double m_switchPenalty; //!< Penalty per Mbit/s of bitrate change
+    std::map<PlanState, double> m_plans; //!< Best quality of experience of the states solved for the current decision
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_ABR_H */
@@ -7,13 +7,27 @@
 #include "ns3/inet-socket-address.h"
 #include "ns3/inet6-socket-address.h"
 #include "ns3/socket.h"
+#include "ns3/udp-socket.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/string.h"
+#include "ns3/type-id.h"
+#include "ns3/object-factory.h"
 #include "ns3/trace-source-accessor.h"
+#include "ns3/video-stream-header.h"
+#include "ns3/video-stream-control-header.h"
+#include "ns3/video-stream-abr.h"
 #include "video-stream-client.h"
 
+#include <algorithm>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("VideoStreamClientApplication");
@@ -35,24 +49,121 @@ VideoStreamClient::GetTypeId (void)
                     UintegerValue (5000),
                     MakeUintegerAccessor (&VideoStreamClient::m_peerPort),
                     MakeUintegerChecker<uint16_t> ())
-    
+    .AddAttribute ("Protocol", "The type of the socket factory, ns3::UdpSocketFactory or ns3::TcpSocketFactory as the server",
+                    TypeIdValue (UdpSocketFactory::GetTypeId ()),
+                    MakeTypeIdAccessor (&VideoStreamClient::m_protocol),
+                    MakeTypeIdChecker ())
+    .AddAttribute ("ReassemblyWindow", "The number of recent frames kept for reassembly before incomplete ones are considered lost",
+                    UintegerValue (32),
+                    MakeUintegerAccessor (&VideoStreamClient::m_reassemblyWindow),
+                    MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("AbrAlgorithm", "The type of the adaptive bitrate algorithm choosing the video level",
+                    TypeIdValue (LegacyAbr::GetTypeId ()),
+                    MakeTypeIdAccessor (&VideoStreamClient::m_abrTypeId),
+                    MakeTypeIdChecker ())
+    .AddAttribute ("MulticastGroup", "The multicast group of video level 1 when the server multicasts, the next addresses being the groups of the next levels (0.0.0.0 for unicast)",
+                    Ipv4AddressValue (Ipv4Address::GetAny ()),
+                    MakeIpv4AddressAccessor (&VideoStreamClient::m_multicastGroup),
+                    MakeIpv4AddressChecker ())
+    .AddAttribute ("MulticastPort", "The destination port of the multicast groups",
+                    UintegerValue (5001),
+                    MakeUintegerAccessor (&VideoStreamClient::m_multicastPort),
+                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("ThroughputWeight", "The weight of a new throughput sample in the moving average",
+                    DoubleValue (0.2),
+                    MakeDoubleAccessor (&VideoStreamClient::m_throughputWeight),
+                    MakeDoubleChecker<double> (0.01, 1.0))
+    .AddAttribute ("ThroughputWindow", "The number of throughput samples of the harmonic mean",
+                    UintegerValue (5),
+                    MakeUintegerAccessor (&VideoStreamClient::m_throughputWindow),
+                    MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DeliveryMode", "Whether the server pushes the frames or the client requests them in segments",
+                    EnumValue (PUSH_DELIVERY),
+                    MakeEnumAccessor (&VideoStreamClient::m_deliveryMode),
+                    MakeEnumChecker (PUSH_DELIVERY, "Push",
+                                     PULL_DELIVERY, "Pull"))
+    .AddAttribute ("SegmentDuration", "The playback time of a segment requested in pull mode",
+                    TimeValue (Seconds (2.0)),
+                    MakeTimeAccessor (&VideoStreamClient::m_segmentDuration),
+                    MakeTimeChecker ())
+    .AddAttribute ("MaxBufferLevel", "The buffer level up to which segments are requested in pull mode",
+                    TimeValue (Seconds (20.0)),
+                    MakeTimeAccessor (&VideoStreamClient::m_maxBufferLevel),
+                    MakeTimeChecker ())
+    .AddAttribute ("SegmentTimeout", "The time without a fragment of the requested segment after which the client requests it again from its first frame not received",
+                    TimeValue (Seconds (1.0)),
+                    MakeTimeAccessor (&VideoStreamClient::m_segmentTimeout),
+                    MakeTimeChecker ())
+    .AddAttribute ("Nack", "Ask the server to send again the missing fragments of a frame that can still be played, over UDP",
+                    BooleanValue (false),
+                    MakeBooleanAccessor (&VideoStreamClient::m_nack),
+                    MakeBooleanChecker ())
+    .AddAttribute ("ReportInterval", "The time between the receiver reports sent to the server (0 for none)",
+                    TimeValue (Seconds (1.0)),
+                    MakeTimeAccessor (&VideoStreamClient::m_reportInterval),
+                    MakeTimeChecker ())
+    .AddAttribute ("LadderFile", "The file that defines the representation ladder of the server, giving the number of levels (at most MAX_VIDEO_LEVEL) and their bitrates to the adaptive bitrate algorithm",
+                    StringValue (""),
+                    MakeStringAccessor (&VideoStreamClient::SetLadderFile, &VideoStreamClient::GetLadderFile),
+                    MakeStringChecker ())
+    .AddTraceSource ("StartupDelay", "The time from the streaming request to the start of the playback",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_startupDelayTrace),
+                    "ns3::Time::TracedCallback")
+    .AddTraceSource ("StallStart", "The playback stalled for lack of frames",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_stallStartTrace),
+                    "ns3::VideoStreamClient::StallStartTracedCallback")
+    .AddTraceSource ("StallEnd", "The playback resumed after a stall of the given duration",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_stallEndTrace),
+                    "ns3::Time::TracedCallback")
+    .AddTraceSource ("LevelSwitch", "The video level requested from the server changed",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_levelSwitchTrace),
+                    "ns3::VideoStreamClient::LevelSwitchTracedCallback")
+    .AddTraceSource ("FrameCompleted", "All the fragments of a frame were received",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_frameTrace),
+                    "ns3::VideoStreamClient::FrameTracedCallback")
+    .AddTraceSource ("BufferLevel", "The number of complete frames in the buffer",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_currentBufferSize),
+                    "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("Throughput", "A frame gave a throughput sample",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_throughputTrace),
+                    "ns3::VideoStreamClient::ThroughputTracedCallback")
+    .AddTraceSource ("Rtt", "A ping measured the round-trip time to the server",
+                    MakeTraceSourceAccessor (&VideoStreamClient::m_rttTrace),
+                    "ns3::Time::TracedCallback")
   ;
   return tid;
 }
 
 VideoStreamClient::VideoStreamClient ()
+  : m_playout (25),
+    m_reassembler (32),
+    m_estimator (0.2, 5)
 {
   NS_LOG_FUNCTION (this);
   m_initialDelay = 3;
   m_lastBufferSize = 0;
   m_currentBufferSize = 0;
-  m_frameSize = 0;
   m_frameRate = 25;
   m_videoLevel = 3;
   m_stopCounter = 0;
-  m_lastRecvFrame = 1e6;
   m_rebufferCounter = 0;
+  m_levelBitrate = 0;
+  m_lastAdapt = Time ();
+  m_deliveryMode = PUSH_DELIVERY;
+  m_tcp = false;
+  m_segmentEnd = 0;
+  m_segmentNext = 0;
+  m_segmentPending = false;
+  m_reportBytes = 0;
+  m_reportExpected = 0;
+  m_reportReceived = 0;
+  m_nack = false;
+  m_nackFrame = 0;
+  m_started = false;
+  m_stalled = false;
+  m_waiting = false;
   m_bufferEvent = EventId();
+  m_playoutEvent = EventId();
   m_sendEvent = EventId();
 }
 
@@ -77,10 +188,77 @@ VideoStreamClient::SetRemote (Address addr)
   m_peerAddress = addr;
 }
 
+uint32_t
+VideoStreamClient::GetReceivedFrames (void) const
+{
+  return m_reassembler.GetCompleteFrames ();
+}
+
+uint32_t
+VideoStreamClient::GetLostFrames (void) const
+{
+  return m_reassembler.GetLostFrames ();
+}
+
+void
+VideoStreamClient::SetAbrAlgorithm (Ptr<AbrAlgorithm> abr)
+{
+  NS_LOG_FUNCTION (this << abr);
+  m_abr = abr;
+}
+
+Ptr<AbrAlgorithm>
+VideoStreamClient::GetAbrAlgorithm (void) const
+{
+  return m_abr;
+}
+
+uint16_t
+VideoStreamClient::GetVideoLevel (void) const
+{
+  return m_videoLevel;
+}
+
+const VideoStreamEstimator &
+VideoStreamClient::GetEstimator (void) const
+{
+  return m_estimator;
+}
+
+void
+VideoStreamClient::SetLadderFile (std::string ladderFile)
+{
+  NS_LOG_FUNCTION (this << ladderFile);
+  m_ladderFile = ladderFile;
+  m_ladder = 0;
+  if (ladderFile != "")
+  {
+    m_ladder = VideoStreamLadder::Load (ladderFile);
+    NS_ABORT_MSG_IF (m_ladder->GetNLevels () > MAX_VIDEO_LEVEL,
+                     "The ladder " << ladderFile << " has " << m_ladder->GetNLevels ()
+                     << " levels, but a client supports at most " << MAX_VIDEO_LEVEL);
+  }
+}
+
+std::string
+VideoStreamClient::GetLadderFile (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_ladderFile;
+}
+
+Time
+VideoStreamClient::GetBufferLevel (void) const
+{
+  return m_playout.GetBufferLevel (Simulator::Now ());
+}
+
 void
 VideoStreamClient::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_abr = 0;
+  m_ladder = 0;
   Application::DoDispose ();
 }
 
@@ -89,10 +267,25 @@ VideoStreamClient::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
 
+  m_reassembler.SetWindowSize (m_reassemblyWindow);
+  m_nackFrame = 0;
+  m_reportBytes = 0;
+  m_reportExpected = 0;
+  m_reportReceived = 0;
+  m_playout.SetFrameRate (m_frameRate);
+  m_estimator.Configure (m_throughputWeight, m_throughputWindow);
+  m_videoLevel = std::min (m_videoLevel, GetMaxLevel ());
+  if (m_abr == 0)
+  {
+    ObjectFactory factory;
+    factory.SetTypeId (m_abrTypeId);
+    m_abr = factory.Create<AbrAlgorithm> ();
+  }
+
+  m_tcp = m_protocol == TcpSocketFactory::GetTypeId ();
   if (m_socket == 0)
   {
-    TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-    m_socket = Socket::CreateSocket (GetNode (), tid);
+    m_socket = Socket::CreateSocket (GetNode (), m_protocol);
     if (Ipv4Address::IsMatchingType (m_peerAddress) == true)
     {
       if (m_socket->Bind () == -1)
@@ -107,7 +300,7 @@ VideoStreamClient::StartApplication (void)
       {
         NS_FATAL_ERROR ("Failed to bind socket");
       }
-      m_socket->Connect (m_peerAddress);
+      m_socket->Connect (Inet6SocketAddress (Ipv6Address::ConvertFrom (m_peerAddress), m_peerPort));
     }
     else if (InetSocketAddress::IsMatchingType (m_peerAddress) == true)
     {
@@ -132,8 +325,12 @@ VideoStreamClient::StartApplication (void)
   }
 
   m_socket->SetRecvCallback (MakeCallback (&VideoStreamClient::HandleRead, this));
+  if (m_multicastGroup.IsMulticast () && m_deliveryMode == PUSH_DELIVERY && !m_tcp)
+  {
+    JoinGroup ();
+  }
   m_sendEvent = Simulator::Schedule (MilliSeconds (1.0), &VideoStreamClient::Send, this);
-  m_bufferEvent = Simulator::Schedule (Seconds (m_initialDelay), &VideoStreamClient::ReadFromBuffer, this);
+  m_bufferEvent = Simulator::Schedule (Seconds (m_initialDelay), &VideoStreamClient::CheckBuffer, this);
 }
 
 void
@@ -143,12 +340,25 @@ VideoStreamClient::StopApplication ()
 
   if (m_socket != 0)
   {
+    // let the server release the session right away instead of waiting for the timeout
+    SendControl (VideoStreamHeader::CLIENT_TEARDOWN);
     m_socket->Close ();
     m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
     m_socket = 0;
   }
+  m_receiveBuffer = 0;
+  if (m_groupSocket != 0)
+  {
+    m_groupSocket->Close ();
+    m_groupSocket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+    m_groupSocket = 0;
+  }
 
+  Simulator::Cancel (m_sendEvent);
   Simulator::Cancel (m_bufferEvent);
+  Simulator::Cancel (m_playoutEvent);
+  Simulator::Cancel (m_segmentEvent);
+  Simulator::Cancel (m_reportEvent);
 }
 
 void
@@ -157,72 +367,403 @@ VideoStreamClient::Send (void)
   NS_LOG_FUNCTION (this);
   NS_ASSERT (m_sendEvent.IsExpired ());
 
-  uint8_t dataBuffer[10];
-  sprintf((char *) dataBuffer, "%hu", 0);
-  Ptr<Packet> firstPacket = Create<Packet> (dataBuffer, 10);
-  m_socket->Send (firstPacket);
+  // in pull mode the first segment request opens the session
+  int sent = m_deliveryMode == PULL_DELIVERY ? SendSegmentRequest () : SendControl (VideoStreamHeader::CLIENT_HELLO);
+  m_helloTime = Simulator::Now ();
+  SendPing ();
+  if (m_reportInterval.IsStrictlyPositive ())
+  {
+    m_reportEvent = Simulator::Schedule (m_reportInterval, &VideoStreamClient::SendReport, this);
+  }
 
   if (Ipv4Address::IsMatchingType (m_peerAddress))
   {
-    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent 10 bytes to " <<
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent " << sent << " bytes to " <<
                   Ipv4Address::ConvertFrom (m_peerAddress) << " port " << m_peerPort);
   }
   else if (Ipv6Address::IsMatchingType (m_peerAddress))
   {
-    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent 10 bytes to " <<
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent " << sent << " bytes to " <<
                   Ipv6Address::ConvertFrom (m_peerAddress) << " port " << m_peerPort);
   }
   else if (InetSocketAddress::IsMatchingType (m_peerAddress))
   {
-    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent 10 bytes to " <<
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent " << sent << " bytes to " <<
                   InetSocketAddress::ConvertFrom (m_peerAddress).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (m_peerAddress).GetPort ());
   }
   else if (Inet6SocketAddress::IsMatchingType (m_peerAddress))
   {
-    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent 10 bytes to " <<
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client sent " << sent << " bytes to " <<
                   Inet6SocketAddress::ConvertFrom (m_peerAddress).GetIpv6 () << " port " << Inet6SocketAddress::ConvertFrom (m_peerAddress).GetPort ());
   }
 }
 
-uint32_t 
-VideoStreamClient::ReadFromBuffer (void)
+int
+VideoStreamClient::SendControl (VideoStreamHeader::MessageType type)
+{
+  NS_LOG_FUNCTION (this << type);
+
+  VideoStreamControlHeader header;
+  header.SetMessageType (type);
+  header.SetVideoLevel (m_videoLevel);
+  header.SetTimestamp (Simulator::Now ());
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  return m_socket->Send (packet);
+}
+
+int
+VideoStreamClient::SendSegmentRequest (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t frameCount = std::min<uint64_t> (std::max<uint64_t> (1, m_segmentDuration.GetSeconds () * m_frameRate + 0.5), UINT16_MAX);
+  VideoStreamControlHeader header;
+  header.SetMessageType (VideoStreamHeader::CLIENT_SEGMENT);
+  header.SetVideoLevel (m_videoLevel);
+  header.SetTimestamp (Simulator::Now ());
+  header.SetFirstFrame (m_segmentEnd);
+  header.SetFrameCount (frameCount);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client requested frames " << m_segmentEnd << " to " << m_segmentEnd + frameCount << " at level " << m_videoLevel);
+
+  m_segmentNext = m_segmentEnd;
+  m_segmentEnd += frameCount;
+  m_segmentPending = true;
+  m_segmentActivity = Simulator::Now ();
+  m_segmentEvent = Simulator::Schedule (m_segmentTimeout, &VideoStreamClient::CheckSegment, this);
+  return m_socket->Send (packet);
+}
+
+void
+VideoStreamClient::RequestSegment (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_stopCounter >= 3)
+  {
+    // the buffer check found the streaming finished
+    return;
+  }
+  // once the buffer is full, the requests follow the playback
+  Time room = m_maxBufferLevel - m_playout.GetBufferLevel (Simulator::Now ());
+  if (room < m_segmentDuration)
+  {
+    m_segmentEvent = Simulator::Schedule (m_segmentDuration - room, &VideoStreamClient::RequestSegment, this);
+    return;
+  }
+  SendSegmentRequest ();
+}
+
+void
+VideoStreamClient::CheckSegment (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time idle = Simulator::Now () - m_segmentActivity;
+  if (idle < m_segmentTimeout)
+  {
+    m_segmentEvent = Simulator::Schedule (m_segmentTimeout - idle, &VideoStreamClient::CheckSegment, this);
+    return;
+  }
+  // the request, the end of the segment or the whole segment was lost, or
+  // the video is over: ask again for what did not arrive
+  NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client requests again the segment from frame " << m_segmentNext << " to " << m_segmentEnd);
+  m_segmentEnd = m_segmentNext;
+  m_segmentPending = false;
+  RequestSegment ();
+}
+
+void
+VideoStreamClient::JoinGroup (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_groupSocket != 0)
+  {
+    m_groupSocket->Close ();
+    m_groupSocket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+  }
+
+  // binding to the group address keeps the packets of the other levels out
+  Ipv4Address group = Ipv4Address (m_multicastGroup.Get () + m_videoLevel - 1);
+  TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
+  m_groupSocket = Socket::CreateSocket (GetNode (), tid);
+  if (m_groupSocket->Bind (InetSocketAddress (group, m_multicastPort)) == -1)
+  {
+    NS_FATAL_ERROR ("Failed to bind socket to group " << group);
+  }
+  Ptr<UdpSocket> udpSocket = DynamicCast<UdpSocket> (m_groupSocket);
+  if (udpSocket)
+  {
+    udpSocket->MulticastJoinGroup (0, group);
+  }
+  m_groupSocket->SetRecvCallback (MakeCallback (&VideoStreamClient::HandleRead, this));
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client joined group " << group);
+}
+
+void
+VideoStreamClient::SendPing (void)
+{
+  NS_LOG_FUNCTION (this);
+  SendControl (VideoStreamHeader::CLIENT_PING);
+}
+
+void
+VideoStreamClient::SendNacks (uint32_t frameNumber)
 {
-  // NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " s, last buffer size: " << m_lastBufferSize << ", current buffer size: " << m_currentBufferSize);
-  if (m_currentBufferSize < m_frameRate) 
+  // the fragments of a frame are sent before the next frame, so the gaps
+  // left in the older frames when a newer one starts are losses
+  if (frameNumber <= m_nackFrame)
   {
+    return;
+  }
+  uint32_t firstFrame = std::max<int64_t> (m_nackFrame, (int64_t) frameNumber - m_reassembler.GetWindowSize ());
+  m_nackFrame = frameNumber;
 
+  // the frames are played after the buffered ones, and nothing is played
+  // before a second of video is buffered
+  Time timeLeft = GetBufferLevel ();
+  if (!m_playout.IsPlaying ())
+  {
+    timeLeft = std::max (timeLeft, Seconds (1.0));
+  }
+  if (timeLeft <= m_estimator.GetRtt ())
+  {
+    return;
+  }
+
+  std::vector<std::pair<uint16_t, uint16_t> > ranges;
+  for (uint32_t frame = firstFrame; frame < frameNumber; frame++)
+  {
+    if (!m_reassembler.GetMissingRanges (frame, ranges))
+    {
+      continue;
+    }
+    VideoStreamControlHeader header;
+    header.SetMessageType (VideoStreamHeader::CLIENT_NACK);
+    header.SetVideoLevel (m_videoLevel);
+    header.SetTimestamp (Simulator::Now ());
+    header.SetFirstFrame (frame);
+    header.SetBufferLevel (timeLeft);
+    for (uint32_t i = 0; i < ranges.size () && i < UINT8_MAX; i++)
+    {
+      header.AddNackRange (ranges[i].first, ranges[i].second);
+    }
+    Ptr<Packet> packet = Create<Packet> ();
+    packet->AddHeader (header);
+    m_socket->Send (packet);
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client NACKed " << ranges.size () << " ranges of frame " << frame);
+  }
+}
+
+void
+VideoStreamClient::SendReport (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // the loss is counted on the frames that left the reassembly window since the last report
+  uint64_t expected = m_reassembler.GetExpectedFragments () - m_reportExpected;
+  uint64_t received = m_reassembler.GetReceivedFragments () - m_reportReceived;
+  m_reportExpected = m_reassembler.GetExpectedFragments ();
+  m_reportReceived = m_reassembler.GetReceivedFragments ();
+
+  VideoStreamControlHeader header;
+  header.SetMessageType (VideoStreamHeader::CLIENT_REPORT);
+  header.SetVideoLevel (m_videoLevel);
+  header.SetTimestamp (Simulator::Now ());
+  header.SetFractionLost (expected > received ? (double) (expected - received) / expected : 0);
+  header.SetReceivedBytes (m_reportBytes);
+  header.SetJitter (m_estimator.GetJitter ());
+  header.SetBufferLevel (GetBufferLevel ());
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (header);
+  m_socket->Send (packet);
+  NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client reported " << header.GetFractionLost () << " lost and " << m_reportBytes << " bytes received");
+  m_reportBytes = 0;
+
+  if (m_stopCounter < 3)
+  {
+    m_reportEvent = Simulator::Schedule (m_reportInterval, &VideoStreamClient::SendReport, this);
+  }
+}
+
+void
+VideoStreamClient::CheckBuffer (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  UpdateBufferSize ();
+  if (m_playout.IsPlaying ())
+  {
+    m_stopCounter = 0;
+    m_rebufferCounter = 0;
+  }
+  else if (!m_started && m_currentBufferSize >= m_frameRate)
+  {
+    // the initial delay is over and a second of video is buffered
+    StartPlayback ();
+  }
+  else
+  {
+    // the playback starts or resumes as soon as a second of video is buffered
+    m_waiting = true;
     if (m_lastBufferSize == m_currentBufferSize)
     {
       m_stopCounter++;
-      // If the counter reaches 3, which means the client has been waiting for 3 sec, and no packets arrived.
-      // In this case, we think the video streaming has finished, and there is no need to schedule the event.
-      if (m_stopCounter < 3)
-      {
-        m_bufferEvent = Simulator::Schedule (Seconds (1.0), &VideoStreamClient::ReadFromBuffer, this);
-      }
     }
     else
     {
       NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " s: Not enough frames in the buffer, rebuffering!");
       m_stopCounter = 0;  // reset the stopCounter
       m_rebufferCounter++;
-      m_bufferEvent = Simulator::Schedule (Seconds (1.0), &VideoStreamClient::ReadFromBuffer, this);
     }
+  }
 
-    m_lastBufferSize = m_currentBufferSize;
-    return (-1);
+  m_lastBufferSize = m_currentBufferSize;
+  AdaptLevel ();
+  SendPing ();
+  // If the counter reaches 3, which means the client has been waiting for 3 sec, and no packets arrived.
+  // In this case, we think the video streaming has finished, and there is no need to schedule the event.
+  if (m_stopCounter < 3)
+  {
+    m_bufferEvent = Simulator::Schedule (Seconds (1.0), &VideoStreamClient::CheckBuffer, this);
   }
-  else
+}
+
+void
+VideoStreamClient::StartPlayback (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " s: Play video frames from the buffer");
+  m_waiting = false;
+  m_playout.Play (Simulator::Now ());
+  if (!m_started)
+  {
+    m_started = true;
+    m_startupDelayTrace (Simulator::Now () - m_helloTime);
+  }
+  else if (m_stalled)
   {
-    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " s: Play video frames from the buffer");
-    if (m_stopCounter > 0) m_stopCounter = 0;    // reset the stopCounter
-    if (m_rebufferCounter > 0) m_rebufferCounter = 0;   // reset the rebufferCounter
-    m_currentBufferSize -= m_frameRate;
+    m_stalled = false;
+    m_stallEndTrace (Simulator::Now () - m_stallTime);
+  }
+  m_playoutEvent = Simulator::Schedule (m_playout.GetDepletionTime () - Simulator::Now (), &VideoStreamClient::HandleDepletion, this);
+}
+
+void
+VideoStreamClient::HandleDepletion (void)
+{
+  NS_LOG_FUNCTION (this);
 
-    m_bufferEvent = Simulator::Schedule (Seconds (1.0), &VideoStreamClient::ReadFromBuffer, this);
-    m_lastBufferSize = m_currentBufferSize;
-    return (m_currentBufferSize);
+  // the frames received since the event was scheduled push the depletion
+  // back, so a healthy buffer costs one event per buffer length
+  Time depletionTime = m_playout.GetDepletionTime ();
+  if (depletionTime > Simulator::Now ())
+  {
+    m_playoutEvent = Simulator::Schedule (depletionTime - Simulator::Now (), &VideoStreamClient::HandleDepletion, this);
+    return;
   }
+
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << " s: The buffer ran out of frames, the playback stalls");
+  m_playout.Pause (Simulator::Now ());
+  UpdateBufferSize ();
+  m_waiting = true;
+  m_stalled = true;
+  m_stallTime = Simulator::Now ();
+  m_stallStartTrace ();
+}
+
+void
+VideoStreamClient::UpdateBufferSize (void)
+{
+  m_currentBufferSize = m_playout.GetBufferedFrames (Simulator::Now ());
+}
+
+void
+VideoStreamClient::AdaptLevel (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_lastAdapt = Simulator::Now ();
+  AbrContext context;
+  context.m_videoLevel = m_videoLevel;
+  context.m_maxLevel = GetMaxLevel ();
+  context.m_frameRate = m_frameRate;
+  context.m_bufferFrames = m_currentBufferSize;
+  context.m_rebufferCount = m_rebufferCounter;
+  context.m_throughput = m_estimator.GetThroughput ();
+  context.m_harmonicThroughput = m_estimator.GetHarmonicThroughput ();
+  context.m_rtt = m_estimator.GetRtt ();
+  context.m_levelBitrate = m_levelBitrate;
+  for (uint16_t level = 1; m_ladder != 0 && level <= context.m_maxLevel; level++)
+  {
+    context.m_ladderBitrates.push_back (m_ladder->GetBitrate (level));
+  }
+
+  uint16_t videoLevel = std::min<uint16_t> (std::max<uint16_t> (m_abr->SelectLevel (context), 1), context.m_maxLevel);
+  if (videoLevel != m_videoLevel)
+  {
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s: Change the video quality level from " << m_videoLevel << " to " << videoLevel);
+    m_levelSwitchTrace (m_videoLevel, videoLevel);
+    m_videoLevel = videoLevel;
+    // reflect the change to the server, in pull mode with the next request
+    if (m_deliveryMode == PUSH_DELIVERY)
+    {
+      SendControl (VideoStreamHeader::CLIENT_LEVEL);
+    }
+    if (m_groupSocket != 0)
+    {
+      JoinGroup ();
+    }
+    m_rebufferCounter = 0;
+  }
+}
+
+void
+VideoStreamClient::UpdateEstimates (const VideoStreamHeader &header, uint32_t payloadSize, bool complete)
+{
+  bool sampled = m_estimator.AddFragment (header.GetFrameNumber (), payloadSize, header.GetTimestamp (), complete, Simulator::Now ());
+  m_estimator.AddTransitSample (Simulator::Now () - header.GetTimestamp ());
+  if (complete)
+  {
+    double frameBytes = m_reassembler.GetFrameBytes (header.GetFrameNumber ());
+    double levelBitrate = frameBytes * 8 * m_frameRate / std::max<uint8_t> (header.GetVideoLevel (), 1);
+    m_levelBitrate = m_levelBitrate == 0 ? levelBitrate : 0.9 * m_levelBitrate + 0.1 * levelBitrate;
+  }
+  if (sampled)
+  {
+    m_throughputTrace (m_estimator.GetLastThroughput (), m_estimator.GetThroughput (), m_estimator.GetHarmonicThroughput ());
+    // react to a drop of bandwidth within a few frames instead of at the next
+    // check, but no more than five times per second while it lasts
+    if (m_started && m_estimator.GetThroughput () < GetLevelBitrate (m_videoLevel)
+        && Simulator::Now () - m_lastAdapt >= Seconds (0.2))
+    {
+      AdaptLevel ();
+    }
+  }
+}
+
+uint16_t
+VideoStreamClient::GetMaxLevel (void) const
+{
+  if (m_ladder != 0)
+  {
+    return m_ladder->GetNLevels ();
+  }
+  return MAX_VIDEO_LEVEL;
+}
+
+double
+VideoStreamClient::GetLevelBitrate (uint16_t videoLevel) const
+{
+  if (m_ladder != 0)
+  {
+    return m_ladder->GetBitrate (videoLevel);
+  }
+  return videoLevel * m_levelBitrate;
 }
 
 void 
@@ -236,58 +777,108 @@ VideoStreamClient::HandleRead (Ptr<Socket> socket)
   while ((packet = socket->RecvFrom (from)))
   {
     socket->GetSockName (localAddress);
-    if (InetSocketAddress::IsMatchingType (from))
+    if (!m_tcp)
     {
-      uint8_t recvData[packet->GetSize()];
-      packet->CopyData (recvData, packet->GetSize ());
-      uint32_t frameNum;
-      sscanf ((char *) recvData, "%u", &frameNum);
+      HandlePacket (packet, from);
+      continue;
+    }
 
-      if (frameNum == m_lastRecvFrame)
+    // cut the byte stream back into the fragments and messages the server wrote
+    if (m_receiveBuffer == 0)
+    {
+      m_receiveBuffer = packet;
+    }
+    else
+    {
+      m_receiveBuffer->AddAtEnd (packet);
+    }
+    while (m_receiveBuffer->GetSize () > 0)
+    {
+      uint32_t recordSize;
+      uint8_t type = VideoStreamHeader::PeekMessageType (m_receiveBuffer);
+      if (type == VideoStreamHeader::SERVER_PONG)
       {
-        m_frameSize += packet->GetSize ();
+        VideoStreamControlHeader pong;
+        pong.SetMessageType (VideoStreamHeader::SERVER_PONG);
+        recordSize = pong.GetSerializedSize ();
       }
-      else
+      else if (type == VideoStreamHeader::VIDEO_FRAME)
       {
-        if (frameNum > 0)
+        VideoStreamHeader header;
+        if (m_receiveBuffer->GetSize () < header.GetSerializedSize ())
         {
-          NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s client received frame " << frameNum-1 << " and " << m_frameSize << " bytes from " <<  InetSocketAddress::ConvertFrom (from).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (from).GetPort ());
+          break;
         }
-
-        m_currentBufferSize++;
-        m_lastRecvFrame = frameNum;
-        m_frameSize = packet->GetSize ();
+        m_receiveBuffer->PeekHeader (header);
+        recordSize = header.GetSerializedSize () + header.GetPayloadSize ();
       }
+      else
+      {
+        NS_LOG_WARN ("Unknown message type " << (uint16_t) type << " in the stream, dropping " << m_receiveBuffer->GetSize () << " bytes");
+        m_receiveBuffer = 0;
+        break;
+      }
+      if (m_receiveBuffer->GetSize () < recordSize)
+      {
+        break;
+      }
+      HandlePacket (m_receiveBuffer->CreateFragment (0, recordSize), from);
+      m_receiveBuffer->RemoveAtStart (recordSize);
+    }
+  }
+}
 
-      // The rebuffering event has happend 3+ times, which suggest the client to lower the video quality.
-      if (m_rebufferCounter >= 3)
+void
+VideoStreamClient::HandlePacket (Ptr<Packet> packet, const Address &from)
+{
+  if (VideoStreamHeader::PeekMessageType (packet) == VideoStreamHeader::SERVER_PONG)
+  {
+    VideoStreamControlHeader pong;
+    packet->RemoveHeader (pong);
+    Time rtt = Simulator::Now () - pong.GetTimestamp ();
+    m_estimator.AddRttSample (rtt);
+    m_rttTrace (rtt);
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client measured a round-trip time of " << rtt.GetSeconds () << "s");
+  }
+  else if (InetSocketAddress::IsMatchingType (from) || Inet6SocketAddress::IsMatchingType (from))
+  {
+    VideoStreamHeader header;
+    packet->RemoveHeader (header);
+    uint32_t frameNum = header.GetFrameNumber ();
+
+    // only complete frames can be played, so only they enter the buffer
+    bool complete = m_reassembler.AddFragment (header, packet->GetSize ()) == VideoStreamReassembler::FRAGMENT_COMPLETE;
+    UpdateEstimates (header, packet->GetSize (), complete);
+    m_reportBytes += packet->GetSize ();
+    if (m_nack && !m_tcp)
+    {
+      SendNacks (frameNum);
+    }
+    if (m_segmentPending)
+    {
+      m_segmentActivity = Simulator::Now ();
+    }
+    if (complete)
+    {
+      NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s client received frame " << frameNum << " and " << m_reassembler.GetFrameBytes (frameNum) << " bytes from " << from);
+      m_frameTrace (frameNum, m_reassembler.GetFrameBytes (frameNum), Simulator::Now () - header.GetTimestamp ());
+      m_playout.AddFrame ();
+      UpdateBufferSize ();
+      if (m_waiting && m_currentBufferSize >= m_frameRate)
       {
-        if (m_videoLevel > 1)
-        {
-          NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s: Lower the video quality level!");
-          m_videoLevel--;
-          // reflect the change to the server
-          uint8_t dataBuffer[10];
-          sprintf((char *) dataBuffer, "%hu", m_videoLevel);
-          Ptr<Packet> levelPacket = Create<Packet> (dataBuffer, 10);
-          socket->SendTo (levelPacket, 0, from);
-          m_rebufferCounter = 0;
-        }
+        StartPlayback ();
       }
-      
-      // If the current buffer size supports 5+ seconds video, we can try to increase the video quality level.
-      if (m_currentBufferSize > 5 * m_frameRate)
+      // a frame lost earlier in the segment keeps it open, until it is sent
+      // again on a NACK or requested again after SegmentTimeout
+      if (m_segmentPending && frameNum >= m_segmentNext && frameNum < m_segmentEnd)
       {
-        if (m_videoLevel < MAX_VIDEO_LEVEL)
+        m_segmentNext = m_reassembler.GetFirstIncompleteFrame (m_segmentNext, m_segmentEnd);
+        if (m_segmentNext == m_segmentEnd)
         {
-          m_videoLevel++;
-          // reflect the change to the server
-          uint8_t dataBuffer[10];
-          sprintf((char *) dataBuffer, "%hu", m_videoLevel);
-          Ptr<Packet> levelPacket = Create<Packet> (dataBuffer, 10);
-          socket->SendTo (levelPacket, 0, from);
-          m_currentBufferSize = m_frameRate;
-          NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds() << "s: Increase the video quality level to " << m_videoLevel);
+          // the segment is complete, the next one can be requested
+          m_segmentPending = false;
+          Simulator::Cancel (m_segmentEvent);
+          RequestSegment ();
         }
       }
     }
@@ -7,9 +7,17 @@
 #include "ns3/event-id.h"
 #include "ns3/ptr.h"
 #include "ns3/address.h"
+#include "ns3/ipv4-address.h"
 #include "ns3/traced-callback.h"
-
-#define MAX_VIDEO_LEVEL 6
+#include "ns3/traced-value.h"
+#include "ns3/nstime.h"
+#include "ns3/type-id.h"
+#include "ns3/video-stream-header.h"
+#include "ns3/video-stream-reassembler.h"
+#include "ns3/video-stream-playout.h"
+#include "ns3/video-stream-abr.h"
+#include "ns3/video-stream-estimator.h"
+#include "ns3/video-stream-ladder.h"
 
 namespace ns3 {
 
@@ -28,6 +36,16 @@ public:
  * @return the object TypeId
  */
   static TypeId GetTypeId (void);
+
+  /**
+   * @brief How the frames reach the client.
+   */
+  enum DeliveryMode
+  {
+    PUSH_DELIVERY, //!< The server pushes a frame per interval after the hello
+    PULL_DELIVERY //!< The client requests segments of frames, which the server sends back to back
+  };
+
   VideoStreamClient ();
   virtual ~VideoStreamClient ();
 
@@ -45,6 +63,107 @@ public:
    */
   void SetRemote (Address addr);
 
+  /**
+   * @brief Get the number of video frames received completely.
+   * 
+   * @return the number of complete frames
+   */
+  uint32_t GetReceivedFrames (void) const;
+
+  /**
+   * @brief Get the number of video frames with missing fragments.
+   * 
+   * A frame is counted as lost once it leaves the reassembly window.
+   * 
+   * @return the number of lost frames
+   */
+  uint32_t GetLostFrames (void) const;
+
+  /**
+   * @brief Set the adaptive bitrate algorithm, instead of creating one of
+   * the type given by the AbrAlgorithm attribute.
+   * 
+   * @param abr the algorithm
+   */
+  void SetAbrAlgorithm (Ptr<AbrAlgorithm> abr);
+
+  /**
+   * @brief Get the adaptive bitrate algorithm.
+   * 
+   * @return the algorithm (0 before the application starts, unless set)
+   */
+  Ptr<AbrAlgorithm> GetAbrAlgorithm (void) const;
+
+  /**
+   * @brief Get the video level currently requested from the server.
+   * 
+   * @return the video level
+   */
+  uint16_t GetVideoLevel (void) const;
+
+  /**
+   * @brief Get the throughput and round-trip time estimator.
+   * 
+   * @return the estimator
+   */
+  const VideoStreamEstimator &GetEstimator (void) const;
+
+  /**
+   * @brief Set the name of the file defining the representation ladder of
+   * the server.
+   *
+   * Aborts if the ladder has more than MAX_VIDEO_LEVEL levels.
+   * 
+   * @param ladderFile the file name
+   */
+  void SetLadderFile (std::string ladderFile);
+
+  /**
+   * @brief Get the name of the file defining the representation ladder of
+   * the server.
+   * 
+   * @return the file name
+   */
+  std::string GetLadderFile (void) const;
+
+  /**
+   * @brief Get the playback time left in the buffer.
+   * 
+   * @return the buffer level
+   */
+  Time GetBufferLevel (void) const;
+
+  /**
+   * TracedCallback signature for a change of video level.
+   * 
+   * @param [in] oldLevel the previous video level
+   * @param [in] newLevel the new video level
+   */
+  typedef void (* LevelSwitchTracedCallback) (uint16_t oldLevel, uint16_t newLevel);
+
+  /**
+   * TracedCallback signature for a completed frame.
+   * 
+   * @param [in] frameNumber the frame number
+   * @param [in] bytes the number of frame bytes received
+   * @param [in] latency the one-way delay of the fragment that completed the frame
+   */
+  typedef void (* FrameTracedCallback) (uint32_t frameNumber, uint32_t bytes, Time latency);
+
+  /**
+   * TracedCallback signature for the start of a stall.
+   */
+  typedef void (* StallStartTracedCallback) (void);
+
+  /**
+   * TracedCallback signature for a throughput sample.
+   * 
+   * @param [in] sample the throughput of the last frame in bit/s
+   * @param [in] average the moving average of the throughput in bit/s
+   * @param [in] harmonic the harmonic mean of the last samples in bit/s
+   */
+  typedef void (* ThroughputTracedCallback) (double sample, double average, double harmonic);
+
 protected:
   virtual void DoDispose (void);
 
@@ -58,12 +177,111 @@ private:
   void Send (void);
 
   /**
-   * @brief Read data from the frame buffer. If the buffer does not have 
-   * enough frames, it will reschedule the reading event next second.
+   * @brief Send a control message to the server.
    * 
-   * @return the updated buffer size (-1 if the buffer size is smaller than the fps)
+   * @param type the type of the message
+   * @return the number of bytes sent (-1 on error)
    */
-  uint32_t ReadFromBuffer (void);
+  int SendControl (VideoStreamHeader::MessageType type);
+
+  /**
+   * @brief Request the next segment at the current video level.
+   * 
+   * @return the number of bytes sent (-1 on error)
+   */
+  int SendSegmentRequest (void);
+
+  /**
+   * @brief Request the next segment if the buffer has room for it, or wait
+   * until the playback makes room.
+   */
+  void RequestSegment (void);
+
+  /**
+   * @brief Request the requested segment again from its first frame not
+   * received yet if no fragment of it arrived for the segment timeout.
+   */
+  void CheckSegment (void);
+
+  /**
+   * @brief Check the frame buffer once per second: start the playback
+   * after the initial delay, count the seconds spent rebuffering and let
+   * the adaptive bitrate algorithm choose the video level.
+   */
+  void CheckBuffer (void);
+
+  /**
+   * @brief Start or resume the playback, and schedule the depletion of the
+   * buffer.
+   */
+  void StartPlayback (void);
+
+  /**
+   * @brief Stall the playback if the buffered frames ran out, or wait for
+   * the frames received since.
+   */
+  void HandleDepletion (void);
+
+  /**
+   * @brief Update the traced number of buffered frames.
+   */
+  void UpdateBufferSize (void);
+
+  /**
+   * @brief Ask the adaptive bitrate algorithm for the video level, and tell
+   * the server when it changes.
+   */
+  void AdaptLevel (void);
+
+  /**
+   * @brief Listen to the multicast group of the current video level,
+   * leaving the previous one.
+   */
+  void JoinGroup (void);
+
+  /**
+   * @brief Send a ping to measure the round-trip time.
+   */
+  void SendPing (void);
+
+  /**
+   * @brief NACK the missing fragments of the frames before a new one, as
+   * long as they can still be played.
+   *
+   * @param frameNumber the frame of the last fragment received
+   */
+  void SendNacks (uint32_t frameNumber);
+
+  /**
+   * @brief Send a receiver report on the fragments received since the last
+   * one, and schedule the next report.
+   */
+  void SendReport (void);
+
+  /**
+   * @brief Update the throughput and bitrate estimates with a fragment.
+   * 
+   * @param header the header of the fragment
+   * @param payloadSize the number of frame bytes carried by the fragment
+   * @param complete whether the fragment completed its frame
+   */
+  void UpdateEstimates (const VideoStreamHeader &header, uint32_t payloadSize, bool complete);
+
+  /**
+   * @brief Get the highest video level the server offers.
+   * 
+   * @return the video level
+   */
+  uint16_t GetMaxLevel (void) const;
+
+  /**
+   * @brief Get the bitrate of a video level, from the ladder if known, from
+   * the estimated bitrate of level 1 otherwise.
+   * 
+   * @param videoLevel the video level
+   * @return the bitrate in bit/s (0 if unknown)
+   */
+  double GetLevelBitrate (uint16_t videoLevel) const;
 
   /**
    * @brief Handle a packet reception.
@@ -74,21 +292,80 @@ private:
    */
   void HandleRead (Ptr<Socket> socket);
 
+  /**
+   * @brief Handle a video fragment or a control message from the server.
+   *
+   * @param packet the packet, starting with its header
+   * @param from the address of the sender
+   */
+  void HandlePacket (Ptr<Packet> packet, const Address &from);
+
   Ptr<Socket> m_socket; //!< Socket
+  TypeId m_protocol; //!< Type of the socket factory
+  bool m_tcp; //!< Whether the socket is a TCP one
+  Ptr<Packet> m_receiveBuffer; //!< Bytes of the TCP stream not yet cut into fragments
   Address m_peerAddress; //!< Remote peer address
   uint16_t m_peerPort; //!< Remote peer port
+  Ipv4Address m_multicastGroup; //!< Group of video level 1 when the server multicasts, 0.0.0.0 otherwise
+  uint16_t m_multicastPort; //!< Destination port of the multicast groups
+  Ptr<Socket> m_groupSocket; //!< Socket bound to the group of the current video level
+
+  DeliveryMode m_deliveryMode; //!< Whether the frames are pushed by the server or requested in segments
+  Time m_segmentDuration; //!< Playback time of a requested segment
+  Time m_maxBufferLevel; //!< Buffer level up to which segments are requested
+  Time m_segmentTimeout; //!< Time without a fragment of the requested segment before requesting it again
+  uint32_t m_segmentEnd; //!< Frame after the last requested one
+  uint32_t m_segmentNext; //!< First frame of the requested segment not received yet
+  bool m_segmentPending; //!< Whether the last requested segment is still arriving
+  Time m_segmentActivity; //!< Time a segment was last requested or one of its fragments arrived
+  EventId m_segmentEvent; //!< Event to request the next segment or check the pending one
 
   uint16_t m_initialDelay; //!< Seconds to wait before displaying the content
   uint16_t m_stopCounter; //!< Counter to decide if the video streaming finishes
   uint16_t m_rebufferCounter; //!< Counter of the rebuffering event
   uint16_t m_videoLevel; //!< The quality of the video from the server
   uint32_t m_frameRate; //!< Number of frames per second to be played
-  uint32_t m_frameSize; //!< Total size of packets from one frame
-  uint32_t m_lastRecvFrame; //!< Last received frame number
   uint32_t m_lastBufferSize; //!< Last size of the buffer
-  uint32_t m_currentBufferSize; //!< Size of the frame buffer
+  TracedValue<uint32_t> m_currentBufferSize; //!< Size of the frame buffer, in complete frames, updated on each frame and check
+  VideoStreamPlayout m_playout; //!< Playout of the buffered frames
+  bool m_waiting; //!< Whether the playback waits for a second of frames to start or resume
+
+  uint32_t m_reassemblyWindow; //!< Number of frames kept for reassembly
+  VideoStreamReassembler m_reassembler; //!< Reassembly of frames from their fragments
+
+  TypeId m_abrTypeId; //!< Type of the adaptive bitrate algorithm
+  Ptr<AbrAlgorithm> m_abr; //!< Adaptive bitrate algorithm
+  double m_throughputWeight; //!< Weight of a new sample in the moving average of the throughput
+  uint32_t m_throughputWindow; //!< Number of samples of the harmonic mean of the throughput
+  VideoStreamEstimator m_estimator; //!< Throughput and round-trip time estimator
+  double m_levelBitrate; //!< Estimated bitrate of level 1 in bit/s
+  Time m_lastAdapt; //!< Last time the adaptive bitrate algorithm chose the level
+  std::string m_ladderFile; //!< Name of the file defining the representation ladder
+  Ptr<const VideoStreamLadder> m_ladder; //!< Representation ladder of the server (0 if unknown)
+
+  Time m_helloTime; //!< Time the streaming was requested
+  bool m_started; //!< Whether the playback started
+  bool m_stalled; //!< Whether the playback is stalled
+  Time m_stallTime; //!< Time the current stall started
+  TracedCallback<Time> m_startupDelayTrace; //!< Trace of the time from the request to the playback
+  TracedCallback<> m_stallStartTrace; //!< Trace of the start of the stalls
+  TracedCallback<Time> m_stallEndTrace; //!< Trace of the duration of the stalls, when they end
+  TracedCallback<uint16_t, uint16_t> m_levelSwitchTrace; //!< Trace of the changes of video level
+  TracedCallback<uint32_t, uint32_t, Time> m_frameTrace; //!< Trace of the completed frames
+  TracedCallback<double, double, double> m_throughputTrace; //!< Trace of the throughput samples
+  TracedCallback<Time> m_rttTrace; //!< Trace of the round-trip time samples
+
+  bool m_nack; //!< Whether the missing fragments are NACKed
+  uint32_t m_nackFrame; //!< First frame not checked for missing fragments yet
+
+  Time m_reportInterval; //!< Time between receiver reports (0 for none)
+  uint32_t m_reportBytes; //!< Bytes received since the last report
+  uint64_t m_reportExpected; //!< Expected fragments counted by the reassembler at the last report
+  uint64_t m_reportReceived; //!< Received fragments counted by the reassembler at the last report
+  EventId m_reportEvent; //!< Event to send the next receiver report
 
-  EventId m_bufferEvent; //!< Event to read from the buffer
+  EventId m_bufferEvent; //!< Event to check the buffer
+  EventId m_playoutEvent; //!< Event at the depletion time of the buffer
   EventId m_sendEvent; //!< Event to send data to the server
 
 };
@@ -0,0 +1,326 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/header.h"
+#include "ns3/simulator.h"
+#include "ns3/video-stream-control-header.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamControlHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (VideoStreamControlHeader);
+
+VideoStreamControlHeader::VideoStreamControlHeader ()
+  : m_type (VideoStreamHeader::CLIENT_HELLO),
+    m_videoLevel (0),
+    m_timestamp (Simulator::Now ().GetTimeStep ()),
+    m_firstFrame (0),
+    m_frameCount (0),
+    m_fractionLost (0),
+    m_receivedBytes (0),
+    m_jitter (0),
+    m_bufferLevel (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+VideoStreamControlHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::VideoStreamControlHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<VideoStreamControlHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+VideoStreamControlHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+VideoStreamControlHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "(type=" << (uint16_t) m_type << " level=" << (uint16_t) m_videoLevel
+     << " time=" << TimeStep (m_timestamp).GetSeconds ();
+  if (m_type == VideoStreamHeader::CLIENT_SEGMENT)
+  {
+    os << " first=" << m_firstFrame << " count=" << m_frameCount;
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_REPORT)
+  {
+    os << " lost=" << GetFractionLost () << " bytes=" << m_receivedBytes
+       << " jitter=" << m_jitter << "us buffer=" << m_bufferLevel << "ms";
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_NACK)
+  {
+    os << " frame=" << m_firstFrame << " buffer=" << m_bufferLevel << "ms missing=";
+    for (auto iter = m_nackRanges.begin (); iter != m_nackRanges.end (); iter++)
+    {
+      os << (iter == m_nackRanges.begin () ? "" : ",") << iter->first << "+" << iter->second;
+    }
+  }
+  os << ")";
+}
+
+uint32_t
+VideoStreamControlHeader::GetSerializedSize (void) const
+{
+  if (m_type == VideoStreamHeader::CLIENT_SEGMENT)
+  {
+    return 1 + 1 + 8 + 4 + 2;
+  }
+  if (m_type == VideoStreamHeader::CLIENT_REPORT)
+  {
+    return 1 + 1 + 8 + 1 + 4 + 4 + 4;
+  }
+  if (m_type == VideoStreamHeader::CLIENT_NACK)
+  {
+    return 1 + 1 + 8 + 4 + 4 + 1 + 4 * m_nackRanges.size ();
+  }
+  return 1 + 1 + 8;
+}
+
+uint32_t
+VideoStreamControlHeader::PeekMessageSize (Ptr<const Packet> packet)
+{
+  if (packet->GetSize () == 0)
+  {
+    return 0;
+  }
+  VideoStreamControlHeader header;
+  uint8_t type = VideoStreamHeader::PeekMessageType (packet);
+  switch (type)
+  {
+    case VideoStreamHeader::CLIENT_HELLO:
+    case VideoStreamHeader::CLIENT_LEVEL:
+    case VideoStreamHeader::CLIENT_TEARDOWN:
+    case VideoStreamHeader::CLIENT_PING:
+    case VideoStreamHeader::CLIENT_SEGMENT:
+    case VideoStreamHeader::CLIENT_REPORT:
+    case VideoStreamHeader::CLIENT_NACK:
+      header.SetMessageType ((VideoStreamHeader::MessageType) type);
+      break;
+    default:
+      return 0;
+  }
+
+  // the ranges of a NACK follow their count, the last fixed byte
+  uint32_t size = header.GetSerializedSize ();
+  if (type == VideoStreamHeader::CLIENT_NACK && packet->GetSize () >= size)
+  {
+    std::vector<uint8_t> bytes (size);
+    packet->CopyData (&bytes[0], size);
+    size += 4 * bytes[size - 1];
+  }
+  return size;
+}
+
+void
+VideoStreamControlHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_type);
+  i.WriteU8 (m_videoLevel);
+  i.WriteHtonU64 (m_timestamp);
+  if (m_type == VideoStreamHeader::CLIENT_SEGMENT)
+  {
+    i.WriteHtonU32 (m_firstFrame);
+    i.WriteHtonU16 (m_frameCount);
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_REPORT)
+  {
+    i.WriteU8 (m_fractionLost);
+    i.WriteHtonU32 (m_receivedBytes);
+    i.WriteHtonU32 (m_jitter);
+    i.WriteHtonU32 (m_bufferLevel);
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_NACK)
+  {
+    i.WriteHtonU32 (m_firstFrame);
+    i.WriteHtonU32 (m_bufferLevel);
+    i.WriteU8 (m_nackRanges.size ());
+    for (auto iter = m_nackRanges.begin (); iter != m_nackRanges.end (); iter++)
+    {
+      i.WriteHtonU16 (iter->first);
+      i.WriteHtonU16 (iter->second);
+    }
+  }
+}
+
+uint32_t
+VideoStreamControlHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  m_type = i.ReadU8 ();
+  m_videoLevel = i.ReadU8 ();
+  m_timestamp = i.ReadNtohU64 ();
+  if (m_type == VideoStreamHeader::CLIENT_SEGMENT)
+  {
+    m_firstFrame = i.ReadNtohU32 ();
+    m_frameCount = i.ReadNtohU16 ();
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_REPORT)
+  {
+    m_fractionLost = i.ReadU8 ();
+    m_receivedBytes = i.ReadNtohU32 ();
+    m_jitter = i.ReadNtohU32 ();
+    m_bufferLevel = i.ReadNtohU32 ();
+  }
+  else if (m_type == VideoStreamHeader::CLIENT_NACK)
+  {
+    m_firstFrame = i.ReadNtohU32 ();
+    m_bufferLevel = i.ReadNtohU32 ();
+    m_nackRanges.resize (i.ReadU8 ());
+    for (auto iter = m_nackRanges.begin (); iter != m_nackRanges.end (); iter++)
+    {
+      iter->first = i.ReadNtohU16 ();
+      iter->second = i.ReadNtohU16 ();
+    }
+  }
+  return GetSerializedSize ();
+}
+
+void
+VideoStreamControlHeader::SetMessageType (VideoStreamHeader::MessageType type)
+{
+  NS_LOG_FUNCTION (this << type);
+  m_type = type;
+}
+
+VideoStreamHeader::MessageType
+VideoStreamControlHeader::GetMessageType (void) const
+{
+  return (VideoStreamHeader::MessageType) m_type;
+}
+
+void
+VideoStreamControlHeader::SetVideoLevel (uint8_t videoLevel)
+{
+  NS_LOG_FUNCTION (this << (uint16_t) videoLevel);
+  m_videoLevel = videoLevel;
+}
+
+uint8_t
+VideoStreamControlHeader::GetVideoLevel (void) const
+{
+  return m_videoLevel;
+}
+
+void
+VideoStreamControlHeader::SetTimestamp (Time timestamp)
+{
+  NS_LOG_FUNCTION (this << timestamp);
+  m_timestamp = timestamp.GetTimeStep ();
+}
+
+Time
+VideoStreamControlHeader::GetTimestamp (void) const
+{
+  return TimeStep (m_timestamp);
+}
+
+void
+VideoStreamControlHeader::SetFirstFrame (uint32_t firstFrame)
+{
+  NS_LOG_FUNCTION (this << firstFrame);
+  m_firstFrame = firstFrame;
+}
+
+uint32_t
+VideoStreamControlHeader::GetFirstFrame (void) const
+{
+  return m_firstFrame;
+}
+
+void
+VideoStreamControlHeader::SetFrameCount (uint16_t frameCount)
+{
+  NS_LOG_FUNCTION (this << frameCount);
+  m_frameCount = frameCount;
+}
+
+uint16_t
+VideoStreamControlHeader::GetFrameCount (void) const
+{
+  return m_frameCount;
+}
+
+void
+VideoStreamControlHeader::SetFractionLost (double fractionLost)
+{
+  NS_LOG_FUNCTION (this << fractionLost);
+  m_fractionLost = std::min (255.0, std::max (0.0, std::floor (fractionLost * 256)));
+}
+
+double
+VideoStreamControlHeader::GetFractionLost (void) const
+{
+  return m_fractionLost / 256.0;
+}
+
+void
+VideoStreamControlHeader::SetReceivedBytes (uint32_t receivedBytes)
+{
+  NS_LOG_FUNCTION (this << receivedBytes);
+  m_receivedBytes = receivedBytes;
+}
+
+uint32_t
+VideoStreamControlHeader::GetReceivedBytes (void) const
+{
+  return m_receivedBytes;
+}
+
+void
+VideoStreamControlHeader::SetJitter (Time jitter)
+{
+  NS_LOG_FUNCTION (this << jitter);
+  m_jitter = std::min<int64_t> (jitter.GetMicroSeconds (), UINT32_MAX);
+}
+
+Time
+VideoStreamControlHeader::GetJitter (void) const
+{
+  return MicroSeconds (m_jitter);
+}
+
+void
+VideoStreamControlHeader::SetBufferLevel (Time bufferLevel)
+{
+  NS_LOG_FUNCTION (this << bufferLevel);
+  m_bufferLevel = std::min<int64_t> (bufferLevel.GetMilliSeconds (), UINT32_MAX);
+}
+
+Time
+VideoStreamControlHeader::GetBufferLevel (void) const
+{
+  return MilliSeconds (m_bufferLevel);
+}
+
+void
+VideoStreamControlHeader::AddNackRange (uint16_t first, uint16_t count)
+{
+  NS_LOG_FUNCTION (this << first << count);
+  NS_ASSERT_MSG (m_nackRanges.size () < UINT8_MAX, "A NACK holds at most 255 ranges");
+  m_nackRanges.push_back (std::make_pair (first, count));
+}
+
+const std::vector<std::pair<uint16_t, uint16_t> > &
+VideoStreamControlHeader::GetNackRanges (void) const
+{
+  return m_nackRanges;
+}
+
+} // namespace ns3
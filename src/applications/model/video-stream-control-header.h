@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_CONTROL_HEADER_H
+#define VIDEO_STREAM_CONTROL_HEADER_H
+
+#include "ns3/header.h"
+#include "ns3/nstime.h"
+#include "ns3/video-stream-header.h"
+
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief Header of the control messages exchanged by a video stream client
+   * and its server.
+   *
+   * The first byte is the message type, taken from
+   * VideoStreamHeader::MessageType, so that control messages and video
+   * fragments can be told apart with VideoStreamHeader::PeekMessageType ().
+   * The server answers a ping with a pong carrying the timestamp of the
+   * ping, from which the client gets the round-trip time. A segment request
+   * also carries the first frame and the number of frames of the segment,
+   * and a receiver report the fraction of fragments lost (in 1/256, as in
+   * RTCP), the bytes received, the interarrival jitter and the buffer level
+   * of the client since its last report. A NACK carries the frame, the time
+   * left before it is played (as a buffer level) and the ranges of its
+   * missing fragments. The other messages stop after the timestamp.
+   */
+  class VideoStreamControlHeader : public Header
+  {
+  public:
+    VideoStreamControlHeader ();
+
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+    virtual TypeId GetInstanceTypeId (void) const;
+    virtual void Print (std::ostream &os) const;
+    virtual uint32_t GetSerializedSize (void) const;
+    virtual void Serialize (Buffer::Iterator start) const;
+    virtual uint32_t Deserialize (Buffer::Iterator start);
+
+    /**
+     * @brief Get the size of the client message at the start of a packet,
+     * without removing it.
+     *
+     * @param packet the packet, possibly holding a truncated message
+     * @return the size of the whole message, which may exceed the size of
+     * the packet, or 0 if the packet does not start with a message a client
+     * sends to its server
+     */
+    static uint32_t PeekMessageSize (Ptr<const Packet> packet);
+
+    /**
+     * @brief Set the message type.
+     *
+     * @param type the message type
+     */
+    void SetMessageType (VideoStreamHeader::MessageType type);
+
+    /**
+     * @brief Get the message type.
+     *
+     * @return the message type
+     */
+    VideoStreamHeader::MessageType GetMessageType (void) const;
+
+    /**
+     * @brief Set the video level requested by the client.
+     *
+     * @param videoLevel the video level
+     */
+    void SetVideoLevel (uint8_t videoLevel);
+
+    /**
+     * @brief Get the video level requested by the client.
+     *
+     * @return the video level
+     */
+    uint8_t GetVideoLevel (void) const;
+
+    /**
+     * @brief Set the time the message was sent.
+     *
+     * @param timestamp the send time
+     */
+    void SetTimestamp (Time timestamp);
+
+    /**
+     * @brief Get the time the message was sent.
+     *
+     * @return the send time
+     */
+    Time GetTimestamp (void) const;
+
+    /**
+     * @brief Set the first frame of a requested segment, or the frame of a
+     * NACK.
+     *
+     * @param firstFrame the frame number
+     */
+    void SetFirstFrame (uint32_t firstFrame);
+
+    /**
+     * @brief Get the first frame of a requested segment, or the frame of a
+     * NACK.
+     *
+     * @return the frame number
+     */
+    uint32_t GetFirstFrame (void) const;
+
+    /**
+     * @brief Set the number of frames of a requested segment.
+     *
+     * @param frameCount the number of frames
+     */
+    void SetFrameCount (uint16_t frameCount);
+
+    /**
+     * @brief Get the number of frames of a requested segment.
+     *
+     * @return the number of frames
+     */
+    uint16_t GetFrameCount (void) const;
+
+    /**
+     * @brief Set the fraction of the fragments lost since the last report.
+     *
+     * @param fractionLost the fraction, between 0 and 1
+     */
+    void SetFractionLost (double fractionLost);
+
+    /**
+     * @brief Get the fraction of the fragments lost since the last report.
+     *
+     * @return the fraction, in steps of 1/256
+     */
+    double GetFractionLost (void) const;
+
+    /**
+     * @brief Set the number of bytes received since the last report.
+     *
+     * @param receivedBytes the number of bytes
+     */
+    void SetReceivedBytes (uint32_t receivedBytes);
+
+    /**
+     * @brief Get the number of bytes received since the last report.
+     *
+     * @return the number of bytes
+     */
+    uint32_t GetReceivedBytes (void) const;
+
+    /**
+     * @brief Set the interarrival jitter of the fragments.
+     *
+     * @param jitter the jitter, carried in microseconds
+     */
+    void SetJitter (Time jitter);
+
+    /**
+     * @brief Get the interarrival jitter of the fragments.
+     *
+     * @return the jitter
+     */
+    Time GetJitter (void) const;
+
+    /**
+     * @brief Set the playback time in the buffer of the client.
+     *
+     * @param bufferLevel the buffer level, carried in milliseconds
+     */
+    void SetBufferLevel (Time bufferLevel);
+
+    /**
+     * @brief Get the playback time in the buffer of the client.
+     *
+     * @return the buffer level
+     */
+    Time GetBufferLevel (void) const;
+
+    /**
+     * @brief Add a range of missing fragments to a NACK.
+     *
+     * @param first the first missing fragment
+     * @param count the number of missing fragments
+     */
+    void AddNackRange (uint16_t first, uint16_t count);
+
+    /**
+     * @brief Get the ranges of missing fragments of a NACK.
+     *
+     * @return the first fragment and the number of fragments of each range
+     */
+    const std::vector<std::pair<uint16_t, uint16_t> > &GetNackRanges (void) const;
+
+  private:
+    uint8_t m_type; //!< Message type
+    uint8_t m_videoLevel; //!< Requested video level
+    uint64_t m_timestamp; //!< Send time in time steps
+    uint32_t m_firstFrame; //!< First frame of a requested segment
+    uint16_t m_frameCount; //!< Number of frames of a requested segment
+    uint8_t m_fractionLost; //!< Fraction of the fragments lost, in 1/256
+    uint32_t m_receivedBytes; //!< Bytes received since the last report
+    uint32_t m_jitter; //!< Interarrival jitter in microseconds
+    uint32_t m_bufferLevel; //!< Buffer level in milliseconds
+    std::vector<std::pair<uint16_t, uint16_t> > m_nackRanges; //!< First fragment and number of fragments of each missing range
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_CONTROL_HEADER_H */
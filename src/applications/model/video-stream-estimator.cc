@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/video-stream-estimator.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamEstimator");
+
+VideoStreamEstimator::VideoStreamEstimator (double ewmaWeight, uint32_t harmonicWindow)
+{
+  NS_LOG_FUNCTION (this << ewmaWeight << harmonicWindow);
+  Configure (ewmaWeight, harmonicWindow);
+}
+
+void
+VideoStreamEstimator::Configure (double ewmaWeight, uint32_t harmonicWindow)
+{
+  NS_LOG_FUNCTION (this << ewmaWeight << harmonicWindow);
+  NS_ASSERT_MSG (ewmaWeight > 0 && ewmaWeight <= 1, "The weight of a sample must be in (0, 1]");
+  NS_ASSERT_MSG (harmonicWindow > 0, "The harmonic mean needs at least one sample");
+  m_ewmaWeight = ewmaWeight;
+  m_trainFrame = 0;
+  m_trainStart = Time ();
+  m_trainBytes = 0;
+  m_trainFirstBytes = 0;
+  m_trainSendTime = Time ();
+  m_trainLastSendTime = Time ();
+  m_lastThroughput = 0;
+  m_throughput = 0;
+  m_samples.assign (harmonicWindow, 0);
+  m_nSamples = 0;
+  m_rtt = Time ();
+  m_minRtt = Time ();
+  m_lastTransit = Time ();
+  m_jitter = Time ();
+}
+
+bool
+VideoStreamEstimator::AddFragment (uint32_t frameNumber, uint32_t payloadSize, Time sendTime, bool complete, Time now)
+{
+  if (frameNumber != m_trainFrame || m_trainBytes == 0)
+  {
+    m_trainFrame = frameNumber;
+    m_trainStart = now;
+    m_trainBytes = payloadSize;
+    m_trainFirstBytes = payloadSize;
+    m_trainSendTime = sendTime;
+    m_trainLastSendTime = sendTime;
+  }
+  else
+  {
+    m_trainBytes += payloadSize;
+    m_trainLastSendTime = std::max (m_trainLastSendTime, sendTime);
+  }
+
+  if (!complete)
+  {
+    return false;
+  }
+
+  // the fragments arrive at the pace of the bottleneck, unless the path kept
+  // up with the pacer of the server, whose pace is then a lower bound
+  Time duration = std::max (now - m_trainStart, m_trainLastSendTime - m_trainSendTime);
+  bool sampled = duration.IsStrictlyPositive () && m_trainBytes > m_trainFirstBytes;
+  if (sampled)
+  {
+    m_lastThroughput = (m_trainBytes - m_trainFirstBytes) * 8 / duration.GetSeconds ();
+    m_throughput = m_throughput == 0 ? m_lastThroughput
+      : (1 - m_ewmaWeight) * m_throughput + m_ewmaWeight * m_lastThroughput;
+    m_samples[m_nSamples % m_samples.size ()] = m_lastThroughput;
+    m_nSamples++;
+    NS_LOG_LOGIC ("Throughput sample " << m_lastThroughput << " bit/s, average " << m_throughput << " bit/s");
+  }
+  m_trainBytes = 0;
+  return sampled;
+}
+
+void
+VideoStreamEstimator::AddRttSample (Time rtt)
+{
+  NS_LOG_FUNCTION (this << rtt);
+
+  if (m_rtt.IsZero ())
+  {
+    m_rtt = rtt;
+    m_minRtt = rtt;
+    return;
+  }
+  m_rtt = TimeStep ((7 * m_rtt.GetTimeStep () + rtt.GetTimeStep ()) / 8);
+  m_minRtt = std::min (m_minRtt, rtt);
+}
+
+void
+VideoStreamEstimator::AddTransitSample (Time transit)
+{
+  if (!m_lastTransit.IsZero ())
+  {
+    int64_t delta = std::abs ((transit - m_lastTransit).GetTimeStep ());
+    m_jitter = TimeStep (m_jitter.GetTimeStep () + (delta - m_jitter.GetTimeStep ()) / 16);
+  }
+  m_lastTransit = transit;
+}
+
+double
+VideoStreamEstimator::GetLastThroughput (void) const
+{
+  return m_lastThroughput;
+}
+
+double
+VideoStreamEstimator::GetThroughput (void) const
+{
+  return m_throughput;
+}
+
+double
+VideoStreamEstimator::GetHarmonicThroughput (void) const
+{
+  uint32_t n = std::min<uint32_t> (m_nSamples, m_samples.size ());
+  if (n == 0)
+  {
+    return 0;
+  }
+  double inverseSum = 0;
+  for (uint32_t i = 0; i < n; i++)
+  {
+    inverseSum += 1 / m_samples[i];
+  }
+  return n / inverseSum;
+}
+
+Time
+VideoStreamEstimator::GetRtt (void) const
+{
+  return m_rtt;
+}
+
+Time
+VideoStreamEstimator::GetMinRtt (void) const
+{
+  return m_minRtt;
+}
+
+Time
+VideoStreamEstimator::GetJitter (void) const
+{
+  return m_jitter;
+}
+
+} // namespace ns3
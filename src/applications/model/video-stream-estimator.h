@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_ESTIMATOR_H
+#define VIDEO_STREAM_ESTIMATOR_H
+
+#include "ns3/nstime.h"
+
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief Estimate the throughput and the round-trip time seen by a video
+   * stream client.
+   *
+   * When the fragments of a frame leave the server back to back, the pace
+   * at which they arrive is the one of the bottleneck. The estimator notes
+   * the arrival time of the first and the last fragment of each frame, and
+   * takes one throughput sample per frame from the bytes received in
+   * between; the first fragment only marks the start of the train. A frame
+   * whose fragments carry different send times was spread by the pacer of
+   * the server, or held back by its TCP send buffer. If its fragments still
+   * arrive further apart than they were sent, the bottleneck set their pace
+   * and the sample is taken the same way; otherwise the path kept up with
+   * the server, and the sample is taken over the time between the first and
+   * the last send instead, a lower bound of the throughput of the path. The
+   * samples are smoothed with an exponentially weighted moving
+   * average, which follows changes quickly, and with the harmonic mean of
+   * the last samples, which is robust to outliers. The round-trip time is a
+   * plain moving average with a gain of 1/8, the smoothed round-trip time of
+   * RFC 6298 without its variation and retransmission timeout, and the
+   * interarrival jitter of the fragments is estimated as in RFC 3550.
+   */
+  class VideoStreamEstimator
+  {
+  public:
+    /**
+     * @brief Construct a new VideoStreamEstimator object.
+     *
+     * @param ewmaWeight the weight of a new sample in the moving average
+     * @param harmonicWindow the number of samples of the harmonic mean
+     */
+    VideoStreamEstimator (double ewmaWeight, uint32_t harmonicWindow);
+
+    /**
+     * @brief Set the weight of a new sample in the moving average and the
+     * number of samples of the harmonic mean, dropping all state.
+     *
+     * @param ewmaWeight the weight of a new sample in the moving average
+     * @param harmonicWindow the number of samples of the harmonic mean
+     */
+    void Configure (double ewmaWeight, uint32_t harmonicWindow);
+
+    /**
+     * @brief Record the arrival of a fragment.
+     *
+     * @param frameNumber the frame of the fragment
+     * @param payloadSize the number of frame bytes carried by the fragment
+     * @param sendTime the time the server sent the fragment
+     * @param complete whether the fragment completed its frame
+     * @param now the arrival time
+     * @return true if the fragment gave a throughput sample
+     */
+    bool AddFragment (uint32_t frameNumber, uint32_t payloadSize, Time sendTime, bool complete, Time now);
+
+    /**
+     * @brief Record a round-trip time measured with a control message.
+     *
+     * @param rtt the round-trip time
+     */
+    void AddRttSample (Time rtt);
+
+    /**
+     * @brief Record the transit time of a fragment, from its send timestamp
+     * to its arrival.
+     *
+     * @param transit the transit time
+     */
+    void AddTransitSample (Time transit);
+
+    /**
+     * @brief Get the last throughput sample.
+     *
+     * @return the throughput in bit/s (0 if unknown)
+     */
+    double GetLastThroughput (void) const;
+
+    /**
+     * @brief Get the moving average of the throughput.
+     *
+     * @return the throughput in bit/s (0 if unknown)
+     */
+    double GetThroughput (void) const;
+
+    /**
+     * @brief Get the harmonic mean of the last throughput samples.
+     *
+     * @return the throughput in bit/s (0 if unknown)
+     */
+    double GetHarmonicThroughput (void) const;
+
+    /**
+     * @brief Get the smoothed round-trip time.
+     *
+     * @return the round-trip time (0 if unknown)
+     */
+    Time GetRtt (void) const;
+
+    /**
+     * @brief Get the smallest round-trip time measured.
+     *
+     * @return the round-trip time (0 if unknown)
+     */
+    Time GetMinRtt (void) const;
+
+    /**
+     * @brief Get the interarrival jitter.
+     *
+     * @return the smoothed variation of the transit time (0 if unknown)
+     */
+    Time GetJitter (void) const;
+
+  private:
+    double m_ewmaWeight; //!< Weight of a new sample in the moving average
+    uint32_t m_trainFrame; //!< Frame of the fragments being timed
+    Time m_trainStart; //!< Arrival time of the first fragment being timed
+    uint32_t m_trainBytes; //!< Bytes of the fragments being timed
+    uint32_t m_trainFirstBytes; //!< Bytes of the first fragment being timed
+    Time m_trainSendTime; //!< Send time of the first fragment being timed
+    Time m_trainLastSendTime; //!< Latest send time of the fragments being timed
+
+    double m_lastThroughput; //!< Last throughput sample in bit/s
+    double m_throughput; //!< Moving average of the throughput in bit/s
+    std::vector<double> m_samples; //!< Ring of the last throughput samples
+    uint32_t m_nSamples; //!< Number of throughput samples taken
+    Time m_rtt; //!< Smoothed round-trip time
+    Time m_minRtt; //!< Smallest round-trip time
+    Time m_lastTransit; //!< Transit time of the last fragment
+    Time m_jitter; //!< Interarrival jitter
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_ESTIMATOR_H */
@@ -0,0 +1,293 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/node.h"
+#include "ns3/callback.h"
+#include "ns3/video-stream-client.h"
+#include "ns3/video-stream-server.h"
+#include "ns3/video-stream-event-log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamEventLog");
+
+namespace {
+
+/**
+ * @brief Header of an event log file, 16 bytes.
+ */
+struct FileHeader
+{
+  char m_magic[4]; //!< "VSEL"
+  uint32_t m_version; //!< Format version
+  uint32_t m_recordSize; //!< Size of a record in bytes
+  uint32_t m_reserved; //!< Always 0
+};
+
+} // anonymous namespace
+
+VideoStreamEventLog::VideoStreamEventLog (const std::string &fileName, uint32_t capacity)
+  : m_file (0),
+    m_ring (std::max<uint32_t> (capacity, 1)),
+    m_head (0),
+    m_size (0),
+    m_nRecords (0),
+    m_nSources (0)
+{
+  NS_LOG_FUNCTION (this << fileName << capacity);
+
+  if (!fileName.empty ())
+  {
+    m_file = std::fopen (fileName.c_str (), "wb");
+    NS_ABORT_MSG_IF (m_file == 0, "Cannot open event log " << fileName);
+
+    FileHeader header;
+    std::memcpy (header.m_magic, "VSEL", 4);
+    header.m_version = 1;
+    header.m_recordSize = sizeof (Record);
+    header.m_reserved = 0;
+    std::fwrite (&header, sizeof (header), 1, m_file);
+  }
+}
+
+VideoStreamEventLog::~VideoStreamEventLog ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_file != 0)
+  {
+    Flush ();
+    std::fclose (m_file);
+  }
+}
+
+uint32_t
+VideoStreamEventLog::Attach (Ptr<VideoStreamClient> client)
+{
+  NS_LOG_FUNCTION (this << client);
+
+  uint32_t source = m_nSources++;
+  Add (source, SOURCE, 0, client->GetNode ()->GetId (), 0);
+  client->TraceConnectWithoutContext ("FrameCompleted", MakeBoundCallback (&VideoStreamEventLog::TraceFrameCompleted, Ptr<VideoStreamEventLog> (this), source));
+  client->TraceConnectWithoutContext ("StartupDelay", MakeBoundCallback (&VideoStreamEventLog::TraceStartup, Ptr<VideoStreamEventLog> (this), source));
+  client->TraceConnectWithoutContext ("StallStart", MakeBoundCallback (&VideoStreamEventLog::TraceStallStart, Ptr<VideoStreamEventLog> (this), source));
+  client->TraceConnectWithoutContext ("StallEnd", MakeBoundCallback (&VideoStreamEventLog::TraceStallEnd, Ptr<VideoStreamEventLog> (this), source));
+  client->TraceConnectWithoutContext ("LevelSwitch", MakeBoundCallback (&VideoStreamEventLog::TraceLevelSwitch, Ptr<VideoStreamEventLog> (this), source));
+  client->TraceConnectWithoutContext ("BufferLevel", MakeBoundCallback (&VideoStreamEventLog::TraceBufferLevel, Ptr<VideoStreamEventLog> (this), source));
+  return source;
+}
+
+uint32_t
+VideoStreamEventLog::Attach (Ptr<VideoStreamServer> server)
+{
+  NS_LOG_FUNCTION (this << server);
+
+  uint32_t source = m_nSources++;
+  Add (source, SOURCE, 0, server->GetNode ()->GetId (), 1);
+  server->TraceConnectWithoutContext ("FrameSent", MakeBoundCallback (&VideoStreamEventLog::TraceFrameSent, Ptr<VideoStreamEventLog> (this), source));
+  return source;
+}
+
+void
+VideoStreamEventLog::Attach (ApplicationContainer apps)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (ApplicationContainer::Iterator i = apps.Begin (); i != apps.End (); ++i)
+  {
+    Ptr<VideoStreamClient> client = DynamicCast<VideoStreamClient> (*i);
+    Ptr<VideoStreamServer> server = DynamicCast<VideoStreamServer> (*i);
+    if (client != 0)
+    {
+      Attach (client);
+    }
+    else if (server != 0)
+    {
+      Attach (server);
+    }
+  }
+}
+
+void
+VideoStreamEventLog::Add (uint32_t source, EventType type, uint16_t level,
+                          uint32_t value0, uint32_t value1, uint32_t value2)
+{
+  if (m_size == m_ring.size ())
+  {
+    if (m_file != 0)
+    {
+      Flush ();
+    }
+    else
+    {
+      // keep the most recent records
+      m_head = (m_head + 1) % m_ring.size ();
+      m_size--;
+    }
+  }
+
+  Record &record = m_ring[(m_head + m_size) % m_ring.size ()];
+  record.m_time = Simulator::Now ().GetTimeStep ();
+  record.m_source = source;
+  record.m_type = type;
+  record.m_level = level;
+  record.m_values[0] = value0;
+  record.m_values[1] = value1;
+  record.m_values[2] = value2;
+  record.m_values[3] = 0;
+  m_size++;
+  m_nRecords++;
+}
+
+void
+VideoStreamEventLog::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_file == 0 || m_size == 0)
+  {
+    return;
+  }
+  // at most two blocks, the end of the ring and its start
+  uint32_t first = std::min<uint32_t> (m_size, m_ring.size () - m_head);
+  std::fwrite (&m_ring[m_head], sizeof (Record), first, m_file);
+  std::fwrite (&m_ring[0], sizeof (Record), m_size - first, m_file);
+  m_head = 0;
+  m_size = 0;
+}
+
+std::vector<VideoStreamEventLog::Record>
+VideoStreamEventLog::GetRecords (void) const
+{
+  std::vector<Record> records;
+  records.reserve (m_size);
+  for (uint32_t i = 0; i < m_size; i++)
+  {
+    records.push_back (m_ring[(m_head + i) % m_ring.size ()]);
+  }
+  return records;
+}
+
+uint64_t
+VideoStreamEventLog::GetNRecords (void) const
+{
+  return m_nRecords;
+}
+
+bool
+VideoStreamEventLog::ReadFile (const std::string &fileName, std::vector<Record> &records)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  std::FILE *file = std::fopen (fileName.c_str (), "rb");
+  if (file == 0)
+  {
+    return false;
+  }
+  FileHeader header;
+  if (std::fread (&header, sizeof (header), 1, file) != 1
+      || std::memcmp (header.m_magic, "VSEL", 4) != 0
+      || header.m_version != 1 || header.m_recordSize != sizeof (Record))
+  {
+    NS_LOG_WARN (fileName << " is not an event log of this version and byte order");
+    std::fclose (file);
+    return false;
+  }
+
+  records.clear ();
+  Record block[4096];
+  size_t nRead;
+  while ((nRead = std::fread (block, sizeof (Record), 4096, file)) > 0)
+  {
+    records.insert (records.end (), block, block + nRead);
+  }
+  std::fclose (file);
+  return true;
+}
+
+std::string
+VideoStreamEventLog::GetTypeName (uint16_t type)
+{
+  switch (type)
+  {
+    case SOURCE:
+      return "SOURCE";
+    case FRAME_COMPLETED:
+      return "FRAME_COMPLETED";
+    case STARTUP:
+      return "STARTUP";
+    case STALL_START:
+      return "STALL_START";
+    case STALL_END:
+      return "STALL_END";
+    case LEVEL_SWITCH:
+      return "LEVEL_SWITCH";
+    case BUFFER_LEVEL:
+      return "BUFFER_LEVEL";
+    case FRAME_SENT:
+      return "FRAME_SENT";
+    default:
+      return "UNKNOWN";
+  }
+}
+
+uint32_t
+VideoStreamEventLog::ToMicroSeconds (Time duration)
+{
+  return std::min<int64_t> (std::max<int64_t> (duration.GetMicroSeconds (), 0), std::numeric_limits<uint32_t>::max ());
+}
+
+void
+VideoStreamEventLog::TraceFrameCompleted (Ptr<VideoStreamEventLog> log, uint32_t source, uint32_t frameNumber, uint32_t bytes, Time latency)
+{
+  log->Add (source, FRAME_COMPLETED, 0, frameNumber, bytes, ToMicroSeconds (latency));
+}
+
+void
+VideoStreamEventLog::TraceStartup (Ptr<VideoStreamEventLog> log, uint32_t source, Time delay)
+{
+  log->Add (source, STARTUP, 0, ToMicroSeconds (delay));
+}
+
+void
+VideoStreamEventLog::TraceStallStart (Ptr<VideoStreamEventLog> log, uint32_t source)
+{
+  log->Add (source, STALL_START);
+}
+
+void
+VideoStreamEventLog::TraceStallEnd (Ptr<VideoStreamEventLog> log, uint32_t source, Time duration)
+{
+  log->Add (source, STALL_END, 0, ToMicroSeconds (duration));
+}
+
+void
+VideoStreamEventLog::TraceLevelSwitch (Ptr<VideoStreamEventLog> log, uint32_t source, uint16_t oldLevel, uint16_t newLevel)
+{
+  log->Add (source, LEVEL_SWITCH, newLevel, oldLevel, newLevel);
+}
+
+void
+VideoStreamEventLog::TraceBufferLevel (Ptr<VideoStreamEventLog> log, uint32_t source, uint32_t oldFrames, uint32_t newFrames)
+{
+  log->Add (source, BUFFER_LEVEL, 0, oldFrames, newFrames);
+}
+
+void
+VideoStreamEventLog::TraceFrameSent (Ptr<VideoStreamEventLog> log, uint32_t source, const Address &address, uint32_t frameNumber, uint32_t bytes, uint16_t videoLevel)
+{
+  uint8_t buffer[Address::MAX_SIZE + 2];
+  uint32_t size = address.CopyAllTo (buffer, sizeof (buffer));
+  uint32_t hash = 2166136261U;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    hash = (hash ^ buffer[i]) * 16777619U;
+  }
+  log->Add (source, FRAME_SENT, videoLevel, frameNumber, bytes, hash);
+}
+
+} // namespace ns3
@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_EVENT_LOG_H
+#define VIDEO_STREAM_EVENT_LOG_H
+
+#include "ns3/simple-ref-count.h"
+#include "ns3/ptr.h"
+#include "ns3/nstime.h"
+#include "ns3/address.h"
+#include "ns3/application-container.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+class VideoStreamClient;
+class VideoStreamServer;
+
+  /**
+   * @brief Record the events of the video stream applications as fixed-size
+   * binary records.
+   *
+   * The log connects to the trace sources of the applications it is attached
+   * to, so the applications pay nothing when no log is used. The records
+   * are kept in a ring buffer. With a file, the buffer is written out in one
+   * block whenever it fills up, and the file starts with a header giving the
+   * magic "VSEL", the version and the record size. Without a file, the
+   * buffer keeps the most recent records only.
+   *
+   * The records are written in the byte order of the host; the
+   * videoEventDecoder program prints them as text.
+   */
+  class VideoStreamEventLog : public SimpleRefCount<VideoStreamEventLog>
+  {
+  public:
+    /**
+     * @brief The kinds of records.
+     */
+    enum EventType
+    {
+      SOURCE = 0, //!< A source was attached: values are the node id and whether it is a server
+      FRAME_COMPLETED = 1, //!< Values are the frame number, the bytes and the delay in microseconds
+      STARTUP = 2, //!< Value is the startup delay in microseconds
+      STALL_START = 3, //!< No values
+      STALL_END = 4, //!< Value is the stall duration in microseconds
+      LEVEL_SWITCH = 5, //!< Values are the old and new levels
+      BUFFER_LEVEL = 6, //!< Values are the old and new numbers of frames
+      FRAME_SENT = 7 //!< Values are the frame number, the bytes and a hash of the client address
+    };
+
+    /**
+     * @brief One event, 32 bytes.
+     */
+    typedef struct Record
+    {
+      uint64_t m_time; //!< Time of the event in time steps
+      uint32_t m_source; //!< Id of the application that emitted the event
+      uint16_t m_type; //!< Kind of the event
+      uint16_t m_level; //!< Video level, when relevant
+      uint32_t m_values[4]; //!< Values, depending on the kind
+    } Record;
+
+    /**
+     * @brief Construct a new VideoStreamEventLog object.
+     *
+     * @param fileName the file the records are written to, or an empty
+     * string to only keep the most recent records in memory
+     * @param capacity the number of records in the ring buffer
+     */
+    VideoStreamEventLog (const std::string &fileName, uint32_t capacity = 65536);
+
+    ~VideoStreamEventLog ();
+
+    /**
+     * @brief Record the events of a client.
+     *
+     * @param client the client
+     * @return the source id of the client in the records
+     */
+    uint32_t Attach (Ptr<VideoStreamClient> client);
+
+    /**
+     * @brief Record the events of a server.
+     *
+     * @param server the server
+     * @return the source id of the server in the records
+     */
+    uint32_t Attach (Ptr<VideoStreamServer> server);
+
+    /**
+     * @brief Record the events of all the video stream applications of a
+     * container.
+     *
+     * @param apps the applications
+     */
+    void Attach (ApplicationContainer apps);
+
+    /**
+     * @brief Add a record.
+     *
+     * @param source the source id
+     * @param type the kind of the event
+     * @param level the video level
+     * @param value0 the first value
+     * @param value1 the second value
+     * @param value2 the third value
+     */
+    void Add (uint32_t source, EventType type, uint16_t level = 0,
+              uint32_t value0 = 0, uint32_t value1 = 0, uint32_t value2 = 0);
+
+    /**
+     * @brief Write the buffered records to the file.
+     */
+    void Flush (void);
+
+    /**
+     * @brief Get the buffered records, oldest first.
+     *
+     * @return the records
+     */
+    std::vector<Record> GetRecords (void) const;
+
+    /**
+     * @brief Get the number of records added since the log was created.
+     *
+     * @return the number of records
+     */
+    uint64_t GetNRecords (void) const;
+
+    /**
+     * @brief Read the records of an event log file.
+     *
+     * @param fileName the file written by an event log
+     * @param records the records read, oldest first
+     * @return false if the file cannot be read or is not an event log
+     */
+    static bool ReadFile (const std::string &fileName, std::vector<Record> &records);
+
+    /**
+     * @brief Get the name of a kind of records.
+     *
+     * @param type the kind of the records
+     * @return the name, or "UNKNOWN"
+     */
+    static std::string GetTypeName (uint16_t type);
+
+  private:
+    static void TraceFrameCompleted (Ptr<VideoStreamEventLog> log, uint32_t source, uint32_t frameNumber, uint32_t bytes, Time latency);
+    static void TraceStartup (Ptr<VideoStreamEventLog> log, uint32_t source, Time delay);
+    static void TraceStallStart (Ptr<VideoStreamEventLog> log, uint32_t source);
+    static void TraceStallEnd (Ptr<VideoStreamEventLog> log, uint32_t source, Time duration);
+    static void TraceLevelSwitch (Ptr<VideoStreamEventLog> log, uint32_t source, uint16_t oldLevel, uint16_t newLevel);
+    static void TraceBufferLevel (Ptr<VideoStreamEventLog> log, uint32_t source, uint32_t oldFrames, uint32_t newFrames);
+    static void TraceFrameSent (Ptr<VideoStreamEventLog> log, uint32_t source, const Address &address, uint32_t frameNumber, uint32_t bytes, uint16_t videoLevel);
+
+    /**
+     * @brief Convert a duration to microseconds, saturating at 32 bits.
+     *
+     * @param duration the duration
+     * @return the duration in microseconds
+     */
+    static uint32_t ToMicroSeconds (Time duration);
+
+    std::FILE *m_file; //!< Output file, or 0 to keep the records in memory
+    std::vector<Record> m_ring; //!< Ring buffer of records
+    uint32_t m_head; //!< Index of the oldest record
+    uint32_t m_size; //!< Number of records in the ring
+    uint64_t m_nRecords; //!< Number of records added
+    uint32_t m_nSources; //!< Number of sources attached
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_EVENT_LOG_H */
@@ -0,0 +1,263 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/video-stream-frame-plan.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamFramePlan");
+
+std::map<VideoStreamFramePlan::CacheKey, VideoStreamFramePlan::CacheEntry> VideoStreamFramePlan::s_cache;
+
+VideoStreamFramePlan::VideoStreamFramePlan (std::vector<uint32_t> &frameSizes, std::vector<uint8_t> &frameTypes, uint32_t nFrames, uint16_t nLevels, bool scaled, uint32_t payloadSize)
+  : m_nFrames (nFrames),
+    m_nLevels (nLevels),
+    m_nColumns (nFrames == 0 ? 1 : frameSizes.size () / nFrames),
+    m_scaled (scaled),
+    m_payloadSize (payloadSize)
+{
+  NS_LOG_FUNCTION (this << nFrames << nLevels << scaled << payloadSize);
+  NS_ASSERT (nLevels > 0 && payloadSize > 0 && m_nColumns > 0 && m_nColumns <= nLevels);
+  NS_ASSERT (frameSizes.size () == (uint64_t) nFrames * m_nColumns && (!scaled || m_nColumns == 1));
+  NS_ASSERT (frameTypes.empty () || frameTypes.size () == nFrames);
+  m_frameSizes.swap (frameSizes);
+  m_frameTypes.swap (frameTypes);
+
+  // one pass per array over contiguous frames, which the compiler vectorizes
+  uint64_t nEntries = m_frameSizes.size ();
+  std::vector<uint32_t> fragmentCounts (nEntries);
+  for (uint64_t i = 0; i < nEntries; i++)
+  {
+    fragmentCounts[i] = std::max<uint32_t> (1, (m_frameSizes[i] + (uint64_t) payloadSize - 1) / payloadSize);
+  }
+  uint64_t maxCount = nEntries == 0 ? 0 : *std::max_element (fragmentCounts.begin (), fragmentCounts.end ());
+  if (m_scaled && nEntries > 0)
+  {
+    // the fragment counts of the scaled levels are computed on lookup
+    uint32_t maxSize = *std::max_element (m_frameSizes.begin (), m_frameSizes.end ());
+    maxCount = std::max<uint64_t> (maxCount, ((uint64_t) maxSize * nLevels + payloadSize - 1) / payloadSize);
+  }
+  NS_ABORT_MSG_IF (maxCount > UINT16_MAX, "A frame needs too many fragments: " << maxCount);
+  m_fragmentCounts.assign (fragmentCounts.begin (), fragmentCounts.end ());
+
+  m_byteOffsets.resize ((uint64_t) (nFrames + 1) * m_nColumns);
+  for (uint16_t column = 0; column < m_nColumns; column++)
+  {
+    const uint32_t *sizes = &m_frameSizes[0] + (uint64_t) column * nFrames;
+    uint64_t *offsets = &m_byteOffsets[(uint64_t) column * (nFrames + 1)];
+    offsets[0] = 0;
+    for (uint32_t frame = 0; frame < nFrames; frame++)
+    {
+      offsets[frame + 1] = offsets[frame] + sizes[frame];
+    }
+  }
+}
+
+Ptr<const VideoStreamFramePlan>
+VideoStreamFramePlan::Get (Ptr<const VideoStreamLadder> ladder, uint32_t nFrames, uint32_t payloadSize)
+{
+  NS_LOG_FUNCTION (ladder << nFrames << payloadSize);
+
+  // the number of frames of a ladder with a trace is the one of its traces
+  if (ladder->GetNFrames () > 0)
+  {
+    nFrames = ladder->GetNFrames ();
+  }
+  CacheKey key (PeekPointer (ladder), payloadSize, nFrames);
+  auto iter = s_cache.find (key);
+  if (iter != s_cache.end ())
+  {
+    return iter->second.m_plan;
+  }
+
+  uint16_t nLevels = ladder->GetNLevels ();
+  std::vector<uint32_t> frameSizes ((uint64_t) nFrames * nLevels);
+  for (uint16_t level = 1; level <= nLevels; level++)
+  {
+    uint32_t *sizes = &frameSizes[0] + (uint64_t) (level - 1) * nFrames;
+    for (uint32_t frame = 0; frame < nFrames; frame++)
+    {
+      sizes[frame] = ladder->GetFrameSize (frame, level);
+    }
+  }
+  std::vector<uint8_t> frameTypes (nFrames);
+  bool typed = false;
+  for (uint32_t frame = 0; frame < nFrames; frame++)
+  {
+    frameTypes[frame] = ladder->GetFrameType (frame);
+    typed |= frameTypes[frame] != VideoStreamTrace::I_FRAME;
+  }
+  if (!typed)
+  {
+    frameTypes.clear ();
+  }
+
+  CacheEntry entry;
+  entry.m_ladder = ladder;
+  entry.m_plan = Ptr<const VideoStreamFramePlan> (new VideoStreamFramePlan (frameSizes, frameTypes, nFrames, nLevels, false, payloadSize), false);
+  s_cache[key] = entry;
+  NS_LOG_INFO ("Planned " << nFrames << " frames of " << nLevels << " levels from a ladder");
+  return entry.m_plan;
+}
+
+Ptr<const VideoStreamFramePlan>
+VideoStreamFramePlan::Get (Ptr<const VideoStreamTrace> trace, uint16_t nLevels, uint32_t payloadSize)
+{
+  NS_LOG_FUNCTION (trace << nLevels << payloadSize);
+  NS_ASSERT (!trace->IsEmpty () && nLevels > 0);
+
+  CacheKey key (PeekPointer (trace), payloadSize, nLevels);
+  auto iter = s_cache.find (key);
+  if (iter != s_cache.end ())
+  {
+    return iter->second.m_plan;
+  }
+
+  // the levels of a single-column trace are multiples of its column, and the
+  // levels above the columns of a trace share its last one, so only the
+  // columns are stored
+  uint32_t nFrames = trace->GetNFrames ();
+  bool scaled = trace->GetNLevels () == 1;
+  uint16_t nColumns = std::min<uint16_t> (trace->GetNLevels (), nLevels);
+  std::vector<uint32_t> frameSizes ((uint64_t) nFrames * nColumns);
+  for (uint16_t column = 1; column <= nColumns; column++)
+  {
+    uint32_t *sizes = &frameSizes[0] + (uint64_t) (column - 1) * nFrames;
+    for (uint32_t frame = 0; frame < nFrames; frame++)
+    {
+      sizes[frame] = trace->GetFrameSize (frame, column);
+    }
+  }
+  std::vector<uint8_t> frameTypes;
+  if (trace->HasFrameTypes ())
+  {
+    frameTypes.resize (nFrames);
+    for (uint32_t frame = 0; frame < nFrames; frame++)
+    {
+      frameTypes[frame] = trace->GetFrameType (frame);
+    }
+  }
+
+  CacheEntry entry;
+  entry.m_trace = trace;
+  entry.m_plan = Ptr<const VideoStreamFramePlan> (new VideoStreamFramePlan (frameSizes, frameTypes, nFrames, nLevels, scaled, payloadSize), false);
+  s_cache[key] = entry;
+  NS_LOG_INFO ("Planned " << nFrames << " frames of " << nLevels << " levels from " << nColumns << " columns of a trace");
+  return entry.m_plan;
+}
+
+Ptr<const VideoStreamFramePlan>
+VideoStreamFramePlan::Create (const std::vector<uint32_t> &levelSizes, uint32_t nFrames, uint32_t payloadSize)
+{
+  NS_LOG_FUNCTION (levelSizes.size () << nFrames << payloadSize);
+
+  std::vector<uint32_t> frameSizes;
+  frameSizes.reserve ((uint64_t) nFrames * levelSizes.size ());
+  for (auto iter = levelSizes.begin (); iter != levelSizes.end (); iter++)
+  {
+    frameSizes.insert (frameSizes.end (), nFrames, *iter);
+  }
+  std::vector<uint8_t> frameTypes;
+  return Ptr<const VideoStreamFramePlan> (new VideoStreamFramePlan (frameSizes, frameTypes, nFrames, levelSizes.size (), false, payloadSize), false);
+}
+
+void
+VideoStreamFramePlan::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  s_cache.clear ();
+}
+
+uint32_t
+VideoStreamFramePlan::GetNFrames (void) const
+{
+  return m_nFrames;
+}
+
+uint16_t
+VideoStreamFramePlan::GetNLevels (void) const
+{
+  return m_nLevels;
+}
+
+uint32_t
+VideoStreamFramePlan::GetPayloadSize (void) const
+{
+  return m_payloadSize;
+}
+
+uint64_t
+VideoStreamFramePlan::GetLevelBase (uint16_t level) const
+{
+  NS_ASSERT (level > 0);
+  return (uint64_t) (std::min (level, m_nColumns) - 1) * m_nFrames;
+}
+
+uint32_t
+VideoStreamFramePlan::GetLevelScale (uint16_t level) const
+{
+  return m_scaled ? std::min (level, m_nLevels) : 1;
+}
+
+uint32_t
+VideoStreamFramePlan::GetFrameSize (uint32_t frame, uint16_t level) const
+{
+  NS_ASSERT (frame < m_nFrames);
+  return m_frameSizes[GetLevelBase (level) + frame] * GetLevelScale (level);
+}
+
+uint16_t
+VideoStreamFramePlan::GetFragmentCount (uint32_t frame, uint16_t level) const
+{
+  NS_ASSERT (frame < m_nFrames);
+  uint32_t scale = GetLevelScale (level);
+  if (scale == 1)
+  {
+    return m_fragmentCounts[GetLevelBase (level) + frame];
+  }
+  uint64_t frameSize = (uint64_t) m_frameSizes[GetLevelBase (level) + frame] * scale;
+  return std::max<uint64_t> (1, (frameSize + m_payloadSize - 1) / m_payloadSize);
+}
+
+uint32_t
+VideoStreamFramePlan::GetFragmentSize (uint32_t frame, uint16_t level, uint16_t fragmentIndex) const
+{
+  uint32_t frameSize = GetFrameSize (frame, level);
+  uint64_t start = (uint64_t) fragmentIndex * m_payloadSize;
+  return start >= frameSize ? 0 : std::min<uint64_t> (m_payloadSize, frameSize - start);
+}
+
+VideoStreamTrace::FrameType
+VideoStreamFramePlan::GetFrameType (uint32_t frame) const
+{
+  NS_ASSERT (frame < m_nFrames);
+  return m_frameTypes.empty () ? VideoStreamTrace::I_FRAME : (VideoStreamTrace::FrameType) m_frameTypes[frame];
+}
+
+uint64_t
+VideoStreamFramePlan::GetByteOffset (uint32_t frame, uint16_t level) const
+{
+  NS_ASSERT (frame <= m_nFrames && level > 0);
+  return m_byteOffsets[(uint64_t) (std::min (level, m_nColumns) - 1) * (m_nFrames + 1) + frame] * GetLevelScale (level);
+}
+
+uint64_t
+VideoStreamFramePlan::GetRangeSize (uint32_t first, uint32_t end, uint16_t level) const
+{
+  NS_ASSERT (first <= end);
+  return GetByteOffset (end, level) - GetByteOffset (first, level);
+}
+
+uint32_t
+VideoStreamFramePlan::FindFrame (uint64_t offset, uint16_t level) const
+{
+  NS_ASSERT (level > 0);
+  const uint64_t *offsets = &m_byteOffsets[(uint64_t) (std::min (level, m_nColumns) - 1) * (m_nFrames + 1)];
+  // the last frame starting at or before the offset, skipping empty frames;
+  // the offsets of a scaled level are multiples of the ones of its column
+  return std::upper_bound (offsets, offsets + m_nFrames + 1, offset / GetLevelScale (level)) - offsets - 1;
+}
+
+} // namespace ns3
@@ -0,0 +1,234 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_FRAME_PLAN_H
+#define VIDEO_STREAM_FRAME_PLAN_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/video-stream-ladder.h"
+#include "ns3/video-stream-trace.h"
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief An immutable table of the frame sizes of every video level, with
+   * the fragments each frame is cut into and the byte offset of each frame
+   * in the stream of its level.
+   *
+   * The table is a structure of arrays: the frame sizes, the fragment
+   * counts and the byte offsets are three contiguous arrays, each holding
+   * the frames of the first column of sizes, then those of the second, and
+   * so on. The byte offsets are prefix sums with one more entry per column
+   * than frames, so the size of any range of frames is a difference of two
+   * entries, and the frame at a given byte offset is a binary search. Every
+   * lookup of the sender is a single array access instead of a trace decode
+   * and a division. The type of each frame, shared by the levels, is a
+   * fourth array.
+   *
+   * Only the columns of the source are stored: the levels above the columns
+   * of a trace share its last column, and the levels of a single-column
+   * trace are multiples of its column, their sizes and offsets scaled by
+   * the level and their fragment counts computed on lookup.
+   *
+   * Plans built from a ladder or a trace are kept in a process-wide
+   * registry keyed by their source and payload size, so servers streaming
+   * the same video with the same packet size share a single plan.
+   */
+  class VideoStreamFramePlan : public SimpleRefCount<VideoStreamFramePlan>
+  {
+  public:
+    /**
+     * @brief Get the plan of a representation ladder, building it if needed.
+     *
+     * @param ladder the ladder
+     * @param nFrames the number of frames of the levels without a trace
+     * @param payloadSize the largest number of frame bytes in a fragment
+     * @return the shared plan
+     */
+    static Ptr<const VideoStreamFramePlan> Get (Ptr<const VideoStreamLadder> ladder, uint32_t nFrames, uint32_t payloadSize);
+
+    /**
+     * @brief Get the plan of a trace, building it if needed.
+     *
+     * @param trace the trace, not empty
+     * @param nLevels the number of video levels of the plan, the levels
+     * above the columns of the trace getting the last column, or the first
+     * column scaled by the level for single-column traces
+     * @param payloadSize the largest number of frame bytes in a fragment
+     * @return the shared plan
+     */
+    static Ptr<const VideoStreamFramePlan> Get (Ptr<const VideoStreamTrace> trace, uint16_t nLevels, uint32_t payloadSize);
+
+    /**
+     * @brief Build the plan of a video whose frames have a constant size at
+     * each level.
+     *
+     * @param levelSizes the frame size of each level, level l at index l - 1
+     * @param nFrames the number of frames
+     * @param payloadSize the largest number of frame bytes in a fragment
+     * @return the plan, not shared
+     */
+    static Ptr<const VideoStreamFramePlan> Create (const std::vector<uint32_t> &levelSizes, uint32_t nFrames, uint32_t payloadSize);
+
+    /**
+     * @brief Drop every plan held by the registry.
+     */
+    static void ClearCache (void);
+
+    /**
+     * @brief Get the number of frames.
+     *
+     * @return the number of frames of each level
+     */
+    uint32_t GetNFrames (void) const;
+
+    /**
+     * @brief Get the number of video levels.
+     *
+     * @return the number of levels
+     */
+    uint16_t GetNLevels (void) const;
+
+    /**
+     * @brief Get the largest number of frame bytes in a fragment.
+     *
+     * @return the payload size in bytes
+     */
+    uint32_t GetPayloadSize (void) const;
+
+    /**
+     * @brief Get the size of a frame.
+     *
+     * @param frame the frame number, below GetNFrames ()
+     * @param level the video level, starting at 1 (levels above the highest
+     * one get the highest one)
+     * @return the frame size in bytes
+     */
+    uint32_t GetFrameSize (uint32_t frame, uint16_t level) const;
+
+    /**
+     * @brief Get the number of fragments of a frame.
+     *
+     * @param frame the frame number, below GetNFrames ()
+     * @param level the video level, starting at 1
+     * @return the number of fragments, at least 1
+     */
+    uint16_t GetFragmentCount (uint32_t frame, uint16_t level) const;
+
+    /**
+     * @brief Get the number of frame bytes carried by a fragment.
+     *
+     * @param frame the frame number, below GetNFrames ()
+     * @param level the video level, starting at 1
+     * @param fragmentIndex the index of the fragment in the frame
+     * @return the payload size of the fragment in bytes
+     */
+    uint32_t GetFragmentSize (uint32_t frame, uint16_t level, uint16_t fragmentIndex) const;
+
+    /**
+     * @brief Get the type of a frame, the same at every level.
+     *
+     * @param frame the frame number, below GetNFrames ()
+     * @return the frame type (VideoStreamTrace::I_FRAME if the source has
+     * no frame types)
+     */
+    VideoStreamTrace::FrameType GetFrameType (uint32_t frame) const;
+
+    /**
+     * @brief Get the offset of a frame in the stream of its level.
+     *
+     * @param frame the frame number, up to GetNFrames () for the end of the
+     * stream
+     * @param level the video level, starting at 1
+     * @return the number of bytes of the frames before it
+     */
+    uint64_t GetByteOffset (uint32_t frame, uint16_t level) const;
+
+    /**
+     * @brief Get the size of a range of frames.
+     *
+     * @param first the first frame of the range
+     * @param end the frame after the last one, up to GetNFrames ()
+     * @param level the video level, starting at 1
+     * @return the number of bytes of the frames of the range
+     */
+    uint64_t GetRangeSize (uint32_t first, uint32_t end, uint16_t level) const;
+
+    /**
+     * @brief Find the frame containing a byte of the stream of a level.
+     *
+     * @param offset the offset of the byte in the stream
+     * @param level the video level, starting at 1
+     * @return the frame number (GetNFrames () past the end of the stream)
+     */
+    uint32_t FindFrame (uint64_t offset, uint16_t level) const;
+
+  private:
+    /**
+     * @brief Build the fragment counts and the byte offsets from the frame
+     * sizes.
+     *
+     * @param frameSizes the frame sizes of every column, column-major,
+     * swapped into the plan
+     * @param frameTypes the type of each frame (empty if unknown), swapped
+     * into the plan
+     * @param nFrames the number of frames of each level
+     * @param nLevels the number of levels, level l getting column l, or the
+     * last column above them
+     * @param scaled whether the levels are multiples of a single column
+     * @param payloadSize the largest number of frame bytes in a fragment
+     */
+    VideoStreamFramePlan (std::vector<uint32_t> &frameSizes, std::vector<uint8_t> &frameTypes, uint32_t nFrames, uint16_t nLevels, bool scaled, uint32_t payloadSize);
+
+    /**
+     * @brief Get the index of the first frame of the column of a level in
+     * the arrays of sizes and fragment counts.
+     *
+     * @param level the video level, starting at 1
+     * @return the index of frame 0 of the column
+     */
+    uint64_t GetLevelBase (uint16_t level) const;
+
+    /**
+     * @brief Get the factor from the column of a level to its sizes.
+     *
+     * @param level the video level, starting at 1
+     * @return the level for a scaled plan, 1 otherwise
+     */
+    uint32_t GetLevelScale (uint16_t level) const;
+
+    typedef std::tuple<const void *, uint32_t, uint32_t> CacheKey; //!< Source of a plan, its payload size and its number of frames or levels
+
+    /**
+     * @brief A plan of the registry, with its source.
+     *
+     * Holding the source keeps its address from being reused by another
+     * ladder or trace while the plan is registered.
+     */
+    typedef struct CacheEntry
+    {
+      Ptr<const VideoStreamLadder> m_ladder; //!< Ladder the plan was built from
+      Ptr<const VideoStreamTrace> m_trace; //!< Trace the plan was built from
+      Ptr<const VideoStreamFramePlan> m_plan; //!< The plan
+    } CacheEntry;
+
+    static std::map<CacheKey, CacheEntry> s_cache; //!< Plans indexed by source, payload size and shape
+
+    uint32_t m_nFrames; //!< Number of frames of each level
+    uint16_t m_nLevels; //!< Number of levels
+    uint16_t m_nColumns; //!< Number of stored columns of frame sizes
+    bool m_scaled; //!< Whether the levels are multiples of a single column
+    uint32_t m_payloadSize; //!< Largest number of frame bytes in a fragment
+    std::vector<uint32_t> m_frameSizes; //!< Size of each frame, column-major
+    std::vector<uint16_t> m_fragmentCounts; //!< Number of fragments of each frame, column-major
+    std::vector<uint64_t> m_byteOffsets; //!< Offset of each frame in its column, with an end entry per column
+    std::vector<uint8_t> m_frameTypes; //!< Type of each frame (empty if every frame is a key frame)
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_FRAME_PLAN_H */
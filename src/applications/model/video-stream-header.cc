@@ -0,0 +1,233 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/assert.h"
+#include "ns3/header.h"
+#include "ns3/simulator.h"
+#include "ns3/video-stream-header.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamHeader");
+
+NS_OBJECT_ENSURE_REGISTERED (VideoStreamHeader);
+
+VideoStreamHeader::VideoStreamHeader ()
+  : m_type (VIDEO_FRAME),
+    m_videoLevel (0),
+    m_frameNumber (0),
+    m_fragmentIndex (0),
+    m_fragmentCount (1),
+    m_payloadSize (0),
+    m_timestamp (Simulator::Now ().GetTimeStep ()),
+    m_groupSize (0),
+    m_lengthRecovery (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+VideoStreamHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::VideoStreamHeader")
+    .SetParent<Header> ()
+    .SetGroupName ("Applications")
+    .AddConstructor<VideoStreamHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+VideoStreamHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+VideoStreamHeader::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION (this << &os);
+  os << "(frame=" << m_frameNumber << " fragment=" << m_fragmentIndex << "/" << m_fragmentCount
+     << " payload=" << m_payloadSize << " level=" << (uint16_t) m_videoLevel << " time=" << TimeStep (m_timestamp).GetSeconds ();
+  if (m_type == VIDEO_PARITY)
+  {
+    os << " parity=" << m_groupSize << " length=" << m_lengthRecovery;
+  }
+  os << ")";
+}
+
+uint32_t
+VideoStreamHeader::GetSerializedSize (void) const
+{
+  if (m_type == VIDEO_PARITY)
+  {
+    return 1 + 1 + 4 + 2 + 2 + 2 + 8 + 2 + 2;
+  }
+  return 1 + 1 + 4 + 2 + 2 + 2 + 8;
+}
+
+void
+VideoStreamHeader::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  i.WriteU8 (m_type);
+  i.WriteU8 (m_videoLevel);
+  i.WriteHtonU32 (m_frameNumber);
+  i.WriteHtonU16 (m_fragmentIndex);
+  i.WriteHtonU16 (m_fragmentCount);
+  i.WriteHtonU16 (m_payloadSize);
+  i.WriteHtonU64 (m_timestamp);
+  if (m_type == VIDEO_PARITY)
+  {
+    i.WriteHtonU16 (m_groupSize);
+    i.WriteHtonU16 (m_lengthRecovery);
+  }
+}
+
+uint32_t
+VideoStreamHeader::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION (this << &start);
+  Buffer::Iterator i = start;
+  m_type = i.ReadU8 ();
+  m_videoLevel = i.ReadU8 ();
+  m_frameNumber = i.ReadNtohU32 ();
+  m_fragmentIndex = i.ReadNtohU16 ();
+  m_fragmentCount = i.ReadNtohU16 ();
+  m_payloadSize = i.ReadNtohU16 ();
+  m_timestamp = i.ReadNtohU64 ();
+  if (m_type == VIDEO_PARITY)
+  {
+    m_groupSize = i.ReadNtohU16 ();
+    m_lengthRecovery = i.ReadNtohU16 ();
+  }
+  return GetSerializedSize ();
+}
+
+uint8_t
+VideoStreamHeader::PeekMessageType (Ptr<const Packet> packet)
+{
+  uint8_t type = 0;
+  packet->CopyData (&type, 1);
+  return type;
+}
+
+void
+VideoStreamHeader::SetMessageType (MessageType type)
+{
+  NS_LOG_FUNCTION (this << type);
+  m_type = type;
+}
+
+VideoStreamHeader::MessageType
+VideoStreamHeader::GetMessageType (void) const
+{
+  return (MessageType) m_type;
+}
+
+void
+VideoStreamHeader::SetFrameNumber (uint32_t frameNumber)
+{
+  NS_LOG_FUNCTION (this << frameNumber);
+  m_frameNumber = frameNumber;
+}
+
+uint32_t
+VideoStreamHeader::GetFrameNumber (void) const
+{
+  return m_frameNumber;
+}
+
+void
+VideoStreamHeader::SetFragmentIndex (uint16_t fragmentIndex)
+{
+  NS_LOG_FUNCTION (this << fragmentIndex);
+  m_fragmentIndex = fragmentIndex;
+}
+
+uint16_t
+VideoStreamHeader::GetFragmentIndex (void) const
+{
+  return m_fragmentIndex;
+}
+
+void
+VideoStreamHeader::SetFragmentCount (uint16_t fragmentCount)
+{
+  NS_LOG_FUNCTION (this << fragmentCount);
+  m_fragmentCount = fragmentCount;
+}
+
+uint16_t
+VideoStreamHeader::GetFragmentCount (void) const
+{
+  return m_fragmentCount;
+}
+
+void
+VideoStreamHeader::SetPayloadSize (uint16_t payloadSize)
+{
+  NS_LOG_FUNCTION (this << payloadSize);
+  m_payloadSize = payloadSize;
+}
+
+uint16_t
+VideoStreamHeader::GetPayloadSize (void) const
+{
+  return m_payloadSize;
+}
+
+void
+VideoStreamHeader::SetVideoLevel (uint8_t videoLevel)
+{
+  NS_LOG_FUNCTION (this << (uint16_t) videoLevel);
+  m_videoLevel = videoLevel;
+}
+
+uint8_t
+VideoStreamHeader::GetVideoLevel (void) const
+{
+  return m_videoLevel;
+}
+
+void
+VideoStreamHeader::SetTimestamp (Time timestamp)
+{
+  NS_LOG_FUNCTION (this << timestamp);
+  m_timestamp = timestamp.GetTimeStep ();
+}
+
+Time
+VideoStreamHeader::GetTimestamp (void) const
+{
+  return TimeStep (m_timestamp);
+}
+
+void
+VideoStreamHeader::SetGroupSize (uint16_t groupSize)
+{
+  NS_LOG_FUNCTION (this << groupSize);
+  m_groupSize = groupSize;
+}
+
+uint16_t
+VideoStreamHeader::GetGroupSize (void) const
+{
+  return m_groupSize;
+}
+
+void
+VideoStreamHeader::SetLengthRecovery (uint16_t lengthRecovery)
+{
+  NS_LOG_FUNCTION (this << lengthRecovery);
+  m_lengthRecovery = lengthRecovery;
+}
+
+uint16_t
+VideoStreamHeader::GetLengthRecovery (void) const
+{
+  return m_lengthRecovery;
+}
+
+} // namespace ns3
@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_HEADER_H
+#define VIDEO_STREAM_HEADER_H
+
+#include "ns3/header.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+
+#define MAX_VIDEO_LEVEL 6 //!< Highest video level a client requests
+
+namespace ns3 {
+
+  /**
+   * @brief Header carried by every fragment of a video frame.
+   *
+   * The payload following the header is the fragment of the frame itself,
+   * so the header identifies the frame, the position of the fragment in the
+   * frame, the video level it was encoded at and when it was sent.
+   * The first byte is the message type, which lets the receiver tell data
+   * from control messages. The header also gives the size of the payload
+   * that follows it, which lets a receiver on a byte stream find where the
+   * fragment ends.
+   *
+   * The same header starts the parity packets of the forward error
+   * correction, with the VIDEO_PARITY type. The payload of a parity packet
+   * is the XOR of a group of consecutive fragments of the frame: its
+   * fragment index is the first fragment of the group, and the header goes
+   * on with the number of fragments of the group and the XOR of their
+   * payload sizes, so that the receiver can rebuild any one missing
+   * fragment of the group with its size.
+   */
+  class VideoStreamHeader : public Header
+  {
+  public:
+    /**
+     * @brief Types of the messages exchanged by the video stream applications.
+     */
+    enum MessageType
+    {
+      VIDEO_FRAME = 1, //!< A fragment of a video frame
+      CLIENT_HELLO = 2, //!< A client asks to start streaming
+      CLIENT_LEVEL = 3, //!< A client asks for another video level
+      CLIENT_TEARDOWN = 4, //!< A client stops streaming
+      CLIENT_PING = 5, //!< A client measures the round-trip time
+      SERVER_PONG = 6, //!< The server echoes a ping
+      CLIENT_SEGMENT = 7, //!< A client requests a range of frames at a video level
+      CLIENT_REPORT = 8, //!< A client reports its reception since its last report
+      VIDEO_PARITY = 9, //!< The XOR parity of a group of fragments of a video frame
+      CLIENT_NACK = 10 //!< A client asks for missing fragments of a frame
+    };
+
+    VideoStreamHeader ();
+
+    /**
+     * @brief Get the type ID.
+     *
+     * @return the object TypeId
+     */
+    static TypeId GetTypeId (void);
+    virtual TypeId GetInstanceTypeId (void) const;
+    virtual void Print (std::ostream &os) const;
+    virtual uint32_t GetSerializedSize (void) const;
+    virtual void Serialize (Buffer::Iterator start) const;
+    virtual uint32_t Deserialize (Buffer::Iterator start);
+
+    /**
+     * @brief Get the type of the message carried by a packet.
+     *
+     * @param packet the packet, starting with a video stream header or a
+     * video stream control header
+     * @return the message type
+     */
+    static uint8_t PeekMessageType (Ptr<const Packet> packet);
+
+    /**
+     * @brief Set the message type.
+     *
+     * @param type VIDEO_FRAME for a fragment or VIDEO_PARITY for a parity packet
+     */
+    void SetMessageType (MessageType type);
+
+    /**
+     * @brief Get the message type.
+     *
+     * @return VIDEO_FRAME for a fragment or VIDEO_PARITY for a parity packet
+     */
+    MessageType GetMessageType (void) const;
+
+    /**
+     * @brief Set the frame number.
+     *
+     * @param frameNumber the number of the frame the fragment belongs to
+     */
+    void SetFrameNumber (uint32_t frameNumber);
+
+    /**
+     * @brief Get the frame number.
+     *
+     * @return the number of the frame the fragment belongs to
+     */
+    uint32_t GetFrameNumber (void) const;
+
+    /**
+     * @brief Set the index of the fragment in the frame.
+     *
+     * @param fragmentIndex the index of the fragment, starting from 0
+     */
+    void SetFragmentIndex (uint16_t fragmentIndex);
+
+    /**
+     * @brief Get the index of the fragment in the frame.
+     *
+     * @return the index of the fragment, starting from 0
+     */
+    uint16_t GetFragmentIndex (void) const;
+
+    /**
+     * @brief Set the number of fragments of the frame.
+     *
+     * @param fragmentCount the number of fragments
+     */
+    void SetFragmentCount (uint16_t fragmentCount);
+
+    /**
+     * @brief Get the number of fragments of the frame.
+     *
+     * @return the number of fragments
+     */
+    uint16_t GetFragmentCount (void) const;
+
+    /**
+     * @brief Set the number of frame bytes following the header.
+     *
+     * @param payloadSize the payload size
+     */
+    void SetPayloadSize (uint16_t payloadSize);
+
+    /**
+     * @brief Get the number of frame bytes following the header.
+     *
+     * @return the payload size
+     */
+    uint16_t GetPayloadSize (void) const;
+
+    /**
+     * @brief Set the video level the frame was encoded at.
+     *
+     * @param videoLevel the video level
+     */
+    void SetVideoLevel (uint8_t videoLevel);
+
+    /**
+     * @brief Get the video level the frame was encoded at.
+     *
+     * @return the video level
+     */
+    uint8_t GetVideoLevel (void) const;
+
+    /**
+     * @brief Set the time the fragment was sent.
+     *
+     * @param timestamp the send time
+     */
+    void SetTimestamp (Time timestamp);
+
+    /**
+     * @brief Get the time the fragment was sent.
+     *
+     * @return the send time
+     */
+    Time GetTimestamp (void) const;
+
+    /**
+     * @brief Set the number of fragments protected by a parity packet.
+     *
+     * @param groupSize the number of fragments, from the fragment index on
+     */
+    void SetGroupSize (uint16_t groupSize);
+
+    /**
+     * @brief Get the number of fragments protected by a parity packet.
+     *
+     * @return the number of fragments, from the fragment index on
+     */
+    uint16_t GetGroupSize (void) const;
+
+    /**
+     * @brief Set the XOR of the payload sizes of the fragments protected by
+     * a parity packet.
+     *
+     * @param lengthRecovery the XOR of the payload sizes
+     */
+    void SetLengthRecovery (uint16_t lengthRecovery);
+
+    /**
+     * @brief Get the XOR of the payload sizes of the fragments protected by
+     * a parity packet.
+     *
+     * @return the XOR of the payload sizes
+     */
+    uint16_t GetLengthRecovery (void) const;
+
+  private:
+    uint8_t m_type; //!< Message type
+    uint8_t m_videoLevel; //!< Video level of the frame
+    uint32_t m_frameNumber; //!< Frame number
+    uint16_t m_fragmentIndex; //!< Index of the fragment in the frame
+    uint16_t m_fragmentCount; //!< Number of fragments of the frame
+    uint16_t m_payloadSize; //!< Number of frame bytes following the header
+    uint64_t m_timestamp; //!< Send time in time steps
+    uint16_t m_groupSize; //!< Number of fragments protected by a parity packet
+    uint16_t m_lengthRecovery; //!< XOR of the payload sizes of the protected fragments
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_HEADER_H */
@@ -0,0 +1,170 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/data-rate.h"
+#include "ns3/video-stream-ladder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamLadder");
+
+std::map<std::string, Ptr<const VideoStreamLadder> > VideoStreamLadder::s_cache;
+
+VideoStreamLadder::VideoStreamLadder (std::vector<Level> &levels, uint32_t frameRate)
+  : m_frameRate (frameRate),
+    m_nFrames (std::numeric_limits<uint32_t>::max ())
+{
+  NS_LOG_FUNCTION (this << levels.size () << frameRate);
+  m_levels.swap (levels);
+  for (auto iter = m_levels.begin (); iter != m_levels.end (); iter++)
+  {
+    m_constantSizes.push_back (iter->m_bitrate / 8 / m_frameRate);
+    if (iter->m_trace != 0)
+    {
+      m_nFrames = std::min (m_nFrames, iter->m_trace->GetNFrames ());
+      if (m_typeTrace == 0 && iter->m_trace->HasFrameTypes ())
+      {
+        m_typeTrace = iter->m_trace;
+      }
+    }
+  }
+  if (m_nFrames == std::numeric_limits<uint32_t>::max ())
+  {
+    m_nFrames = 0;
+  }
+}
+
+Ptr<const VideoStreamLadder>
+VideoStreamLadder::Load (std::string fileName)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  auto cacheIter = s_cache.find (fileName);
+  if (cacheIter != s_cache.end ())
+  {
+    return cacheIter->second;
+  }
+
+  std::ifstream fileStream (fileName);
+  NS_ABORT_MSG_IF (!fileStream, "Can not open the ladder file " << fileName);
+  std::string directory;
+  size_t slash = fileName.find_last_of ('/');
+  if (slash != std::string::npos)
+  {
+    directory = fileName.substr (0, slash + 1);
+  }
+
+  std::vector<Level> levels;
+  uint32_t frameRate = 25;
+  std::string line;
+  uint32_t lineNumber = 0;
+  while (std::getline (fileStream, line))
+  {
+    lineNumber++;
+    std::istringstream lineStream (line.substr (0, line.find ('#')));
+    std::string bitrate;
+    if (!(lineStream >> bitrate))
+    {
+      continue;
+    }
+    if (bitrate == "frameRate")
+    {
+      NS_ABORT_MSG_IF (!(lineStream >> frameRate) || frameRate == 0,
+                       fileName << ":" << lineNumber << ": invalid frame rate");
+      continue;
+    }
+
+    std::string resolution;
+    std::string traceFile;
+    char separator = 0;
+    Level level;
+    std::istringstream resolutionStream;
+    NS_ABORT_MSG_IF (!(lineStream >> resolution >> traceFile),
+                     fileName << ":" << lineNumber << ": expected a bitrate, a resolution and a trace");
+    resolutionStream.str (resolution);
+    NS_ABORT_MSG_IF (!(resolutionStream >> level.m_width >> separator >> level.m_height) || separator != 'x',
+                     fileName << ":" << lineNumber << ": invalid resolution " << resolution);
+    level.m_bitrate = DataRate (bitrate).GetBitRate ();
+    NS_ABORT_MSG_IF (level.m_bitrate == 0, fileName << ":" << lineNumber << ": invalid bitrate " << bitrate);
+    if (traceFile != "-")
+    {
+      level.m_trace = VideoStreamTrace::Load (traceFile[0] == '/' ? traceFile : directory + traceFile);
+      NS_ABORT_MSG_IF (level.m_trace->IsEmpty (), fileName << ":" << lineNumber << ": empty trace " << traceFile);
+    }
+    levels.push_back (level);
+  }
+  NS_ABORT_MSG_IF (levels.empty (), "The ladder file " << fileName << " has no level");
+
+  Ptr<const VideoStreamLadder> ladder = Ptr<const VideoStreamLadder> (new VideoStreamLadder (levels, frameRate), false);
+  NS_LOG_INFO ("Loaded " << ladder->GetNLevels () << " levels from " << fileName);
+  s_cache[fileName] = ladder;
+  return ladder;
+}
+
+void
+VideoStreamLadder::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  s_cache.clear ();
+}
+
+uint16_t
+VideoStreamLadder::GetNLevels (void) const
+{
+  return m_levels.size ();
+}
+
+const VideoStreamLadder::Level &
+VideoStreamLadder::GetLevel (uint16_t level) const
+{
+  NS_ASSERT (level > 0);
+  return m_levels[std::min<uint16_t> (level, m_levels.size ()) - 1];
+}
+
+uint64_t
+VideoStreamLadder::GetBitrate (uint16_t level) const
+{
+  return GetLevel (level).m_bitrate;
+}
+
+uint32_t
+VideoStreamLadder::GetFrameRate (void) const
+{
+  return m_frameRate;
+}
+
+uint32_t
+VideoStreamLadder::GetNFrames (void) const
+{
+  return m_nFrames;
+}
+
+uint32_t
+VideoStreamLadder::GetFrameSize (uint32_t frame, uint16_t level) const
+{
+  NS_ASSERT (level > 0);
+  uint16_t index = std::min<uint16_t> (level, m_levels.size ()) - 1;
+  const Ptr<const VideoStreamTrace> &trace = m_levels[index].m_trace;
+  if (trace == 0)
+  {
+    return m_constantSizes[index];
+  }
+  return trace->GetFrameSize (frame);
+}
+
+VideoStreamTrace::FrameType
+VideoStreamLadder::GetFrameType (uint32_t frame) const
+{
+  if (m_typeTrace == 0)
+  {
+    return VideoStreamTrace::I_FRAME;
+  }
+  return m_typeTrace->GetFrameType (frame);
+}
+
+} // namespace ns3
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_LADDER_H
+#define VIDEO_STREAM_LADDER_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+#include "ns3/video-stream-trace.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief An immutable representation ladder: the video levels a server
+   * offers, each with its bitrate, its resolution and the frame sizes of
+   * its encode.
+   *
+   * Ladders are only created through Load (), which keeps a process-wide
+   * registry keyed by the file path, and the traces of the levels come from
+   * VideoStreamTrace::Load (), so every server and client using the same
+   * ladder shares a single copy of it.
+   *
+   * The ladder file is text, with one level per line from the lowest to the
+   * highest, and an optional frame rate line (25 frames per second if
+   * missing). Text after a '#' is a comment:
+   * @verbatim
+     frameRate 25
+     # bitrate  resolution  trace
+     800kbps    640x360     trace-360p.txt
+     2500kbps   1280x720    trace-720p.vstr
+     5Mbps      1920x1080   -
+     @endverbatim
+   * The bitrate accepts the units of DataRate. The trace is the frame size
+   * file of the level, as text or in the binary trace format (first column
+   * only), relative to the directory of the ladder file unless absolute.
+   * A level without a trace ('-') has frames of constant size, its bitrate
+   * divided by the frame rate. The levels of an encode share its group of
+   * pictures structure, so the frame types of the ladder are those of the
+   * first trace with frame types.
+   */
+  class VideoStreamLadder : public SimpleRefCount<VideoStreamLadder>
+  {
+  public:
+    /**
+     * @brief One level of the ladder.
+     */
+    typedef struct Level
+    {
+      uint64_t m_bitrate; //!< Nominal bitrate in bit/s
+      uint16_t m_width; //!< Width of the frames in pixels
+      uint16_t m_height; //!< Height of the frames in pixels
+      Ptr<const VideoStreamTrace> m_trace; //!< Frame sizes of the encode (0 for constant frame sizes)
+    } Level;
+
+    /**
+     * @brief Get the ladder stored in the given file, loading it if needed.
+     *
+     * @param fileName the name of the ladder file
+     * @return the shared ladder
+     */
+    static Ptr<const VideoStreamLadder> Load (std::string fileName);
+
+    /**
+     * @brief Drop every ladder held by the registry.
+     */
+    static void ClearCache (void);
+
+    /**
+     * @brief Get the number of levels.
+     *
+     * @return the number of levels
+     */
+    uint16_t GetNLevels (void) const;
+
+    /**
+     * @brief Get a level of the ladder.
+     *
+     * @param level the video level, starting at 1
+     * @return the level
+     */
+    const Level &GetLevel (uint16_t level) const;
+
+    /**
+     * @brief Get the nominal bitrate of a level.
+     *
+     * @param level the video level, starting at 1
+     * @return the bitrate in bit/s
+     */
+    uint64_t GetBitrate (uint16_t level) const;
+
+    /**
+     * @brief Get the frame rate of the video.
+     *
+     * @return the number of frames per second
+     */
+    uint32_t GetFrameRate (void) const;
+
+    /**
+     * @brief Get the number of frames of the video.
+     *
+     * @return the length of the shortest trace (0 if no level has a trace)
+     */
+    uint32_t GetNFrames (void) const;
+
+    /**
+     * @brief Get the size of a frame.
+     *
+     * @param frame the index of the frame, below GetNFrames () if a level
+     * has a trace
+     * @param level the video level, starting at 1 (levels above the highest
+     * one get the highest one)
+     * @return the frame size in bytes
+     */
+    uint32_t GetFrameSize (uint32_t frame, uint16_t level) const;
+
+    /**
+     * @brief Get the type of a frame, the same at every level.
+     *
+     * @param frame the index of the frame, below GetNFrames () if a level
+     * has a trace
+     * @return the frame type (VideoStreamTrace::I_FRAME if no trace has
+     * frame types)
+     */
+    VideoStreamTrace::FrameType GetFrameType (uint32_t frame) const;
+
+  private:
+    /**
+     * @brief Construct a ladder from its parsed levels.
+     *
+     * @param levels the levels, swapped into the ladder
+     * @param frameRate the frame rate of the video
+     */
+    VideoStreamLadder (std::vector<Level> &levels, uint32_t frameRate);
+
+    static std::map<std::string, Ptr<const VideoStreamLadder> > s_cache; //!< Ladders indexed by file path
+
+    std::vector<Level> m_levels; //!< Levels from the lowest to the highest
+    std::vector<uint32_t> m_constantSizes; //!< Frame size of each level without a trace
+    uint32_t m_frameRate; //!< Number of frames per second
+    uint32_t m_nFrames; //!< Length of the shortest trace
+    Ptr<const VideoStreamTrace> m_typeTrace; //!< First trace with frame types (0 if none)
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_LADDER_H */
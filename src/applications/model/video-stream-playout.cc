@@ -0,0 +1,112 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/video-stream-playout.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamPlayout");
+
+VideoStreamPlayout::VideoStreamPlayout (uint32_t frameRate)
+{
+  NS_LOG_FUNCTION (this << frameRate);
+  SetFrameRate (frameRate);
+}
+
+void
+VideoStreamPlayout::SetFrameRate (uint32_t frameRate)
+{
+  NS_LOG_FUNCTION (this << frameRate);
+  NS_ASSERT_MSG (frameRate > 0, "The frame rate must be positive");
+  m_frameRate = frameRate;
+  m_receivedFrames = 0;
+  m_playedFrames = 0;
+  m_playing = false;
+  m_playTime = Time ();
+}
+
+uint32_t
+VideoStreamPlayout::GetFrameRate (void) const
+{
+  return m_frameRate;
+}
+
+void
+VideoStreamPlayout::AddFrame (void)
+{
+  m_receivedFrames++;
+}
+
+void
+VideoStreamPlayout::Play (Time now)
+{
+  NS_LOG_FUNCTION (this << now);
+  if (!m_playing)
+  {
+    m_playing = true;
+    m_playTime = now;
+  }
+}
+
+void
+VideoStreamPlayout::Pause (Time now)
+{
+  NS_LOG_FUNCTION (this << now);
+  if (m_playing)
+  {
+    m_playedFrames = GetPlayedFrames (now);
+    m_playing = false;
+  }
+}
+
+bool
+VideoStreamPlayout::IsPlaying (void) const
+{
+  return m_playing;
+}
+
+uint32_t
+VideoStreamPlayout::GetBufferedFrames (Time now) const
+{
+  return m_receivedFrames - GetPlayedFrames (now);
+}
+
+Time
+VideoStreamPlayout::GetBufferLevel (Time now) const
+{
+  if (!m_playing)
+  {
+    return GetPlaybackTime (m_receivedFrames - m_playedFrames);
+  }
+  return std::max (GetDepletionTime () - now, Time ());
+}
+
+uint64_t
+VideoStreamPlayout::GetPlayedFrames (Time now) const
+{
+  if (!m_playing || now <= m_playTime)
+  {
+    return m_playedFrames;
+  }
+  // a frame is played once its whole period has elapsed
+  uint64_t elapsed = (now - m_playTime).GetTimeStep ();
+  uint64_t played = elapsed * m_frameRate / Seconds (1.0).GetTimeStep ();
+  return std::min (m_playedFrames + played, m_receivedFrames);
+}
+
+Time
+VideoStreamPlayout::GetDepletionTime (void) const
+{
+  return m_playTime + GetPlaybackTime (m_receivedFrames - m_playedFrames);
+}
+
+Time
+VideoStreamPlayout::GetPlaybackTime (uint64_t frames) const
+{
+  uint64_t second = Seconds (1.0).GetTimeStep ();
+  return TimeStep ((frames * second + m_frameRate - 1) / m_frameRate);
+}
+
+} // namespace ns3
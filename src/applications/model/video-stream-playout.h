@@ -0,0 +1,122 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_PLAYOUT_H
+#define VIDEO_STREAM_PLAYOUT_H
+
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+  /**
+   * @brief Play the complete frames of the client buffer at the frame rate.
+   *
+   * Frames are played one after the other, each one for a frame period, and
+   * a frame leaves the buffer when it has been shown for its whole period.
+   * The engine does not schedule anything: it stores the time the playback
+   * last started and the number of frames played before, from which the
+   * frames played at any later time follow. The owner only needs an event
+   * at the depletion time, when the buffered frames run out, to decide
+   * whether the playback stalls or goes on with the frames received since.
+   */
+  class VideoStreamPlayout
+  {
+  public:
+    /**
+     * @brief Construct a new VideoStreamPlayout object.
+     *
+     * @param frameRate the number of frames played per second
+     */
+    VideoStreamPlayout (uint32_t frameRate);
+
+    /**
+     * @brief Set the frame rate, dropping all state.
+     *
+     * @param frameRate the number of frames played per second
+     */
+    void SetFrameRate (uint32_t frameRate);
+
+    /**
+     * @brief Get the frame rate.
+     *
+     * @return the number of frames played per second
+     */
+    uint32_t GetFrameRate (void) const;
+
+    /**
+     * @brief Add a complete frame at the end of the buffer.
+     */
+    void AddFrame (void);
+
+    /**
+     * @brief Start or resume the playback.
+     *
+     * @param now the current time
+     */
+    void Play (Time now);
+
+    /**
+     * @brief Stop the playback, keeping the frames not played yet.
+     *
+     * @param now the current time
+     */
+    void Pause (Time now);
+
+    /**
+     * @brief Get whether the playback is running.
+     *
+     * @return true if the frames are being played
+     */
+    bool IsPlaying (void) const;
+
+    /**
+     * @brief Get the number of frames in the buffer, including the one being
+     * shown.
+     *
+     * @param now the current time
+     * @return the number of buffered frames
+     */
+    uint32_t GetBufferedFrames (Time now) const;
+
+    /**
+     * @brief Get the playback time left in the buffer.
+     *
+     * @param now the current time
+     * @return the buffer level
+     */
+    Time GetBufferLevel (Time now) const;
+
+    /**
+     * @brief Get the number of frames played completely.
+     *
+     * @param now the current time
+     * @return the number of played frames
+     */
+    uint64_t GetPlayedFrames (Time now) const;
+
+    /**
+     * @brief Get the time the buffered frames run out if no frame is added.
+     *
+     * @return the depletion time (only meaningful while playing)
+     */
+    Time GetDepletionTime (void) const;
+
+  private:
+    /**
+     * @brief Get the playback time of a number of frames, rounded up to the
+     * next time step.
+     *
+     * @param frames the number of frames
+     * @return the playback time
+     */
+    Time GetPlaybackTime (uint64_t frames) const;
+
+    uint32_t m_frameRate; //!< Number of frames played per second
+    uint64_t m_receivedFrames; //!< Number of frames added to the buffer
+    uint64_t m_playedFrames; //!< Number of frames played when the playback last started
+    bool m_playing; //!< Whether the playback is running
+    Time m_playTime; //!< Time the playback last started
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_PLAYOUT_H */
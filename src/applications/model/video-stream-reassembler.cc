@@ -0,0 +1,309 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/log.h"
+#include "ns3/video-stream-reassembler.h"
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamReassembler");
+
+VideoStreamReassembler::VideoStreamReassembler (uint32_t windowSize)
+{
+  NS_LOG_FUNCTION (this << windowSize);
+  SetWindowSize (windowSize);
+}
+
+void
+VideoStreamReassembler::SetWindowSize (uint32_t windowSize)
+{
+  NS_LOG_FUNCTION (this << windowSize);
+  NS_ASSERT_MSG (windowSize > 0, "The reassembly window must hold at least one frame");
+  m_slots.assign (windowSize, FrameSlot ());
+  m_started = false;
+  m_base = 0;
+  m_completeFrames = 0;
+  m_lostFrames = 0;
+  m_lastFragmentCount = 1;
+  m_expectedFragments = 0;
+  m_receivedFragments = 0;
+  m_recoveredFragments = 0;
+}
+
+uint32_t
+VideoStreamReassembler::GetWindowSize (void) const
+{
+  return m_slots.size ();
+}
+
+VideoStreamReassembler::FragmentStatus
+VideoStreamReassembler::AddFragment (const VideoStreamHeader &header, uint32_t payloadSize)
+{
+  NS_LOG_FUNCTION (this << header.GetFrameNumber () << header.GetFragmentIndex ());
+
+  uint32_t frameNumber = header.GetFrameNumber ();
+  if (!m_started)
+  {
+    m_started = true;
+    m_base = frameNumber;
+  }
+  if (frameNumber < m_base)
+  {
+    return FRAGMENT_LATE;
+  }
+  if (frameNumber - m_base >= m_slots.size ())
+  {
+    Advance (frameNumber - m_slots.size () + 1);
+  }
+
+  FrameSlot &slot = m_slots[frameNumber % m_slots.size ()];
+  if (!slot.m_used)
+  {
+    // the bitmap keeps its capacity from the previous frames in this slot
+    slot.m_used = true;
+    slot.m_complete = false;
+    slot.m_frameNumber = frameNumber;
+    slot.m_fragmentCount = header.GetFragmentCount ();
+    slot.m_receivedFragments = 0;
+    slot.m_recoveredFragments = 0;
+    slot.m_receivedBytes = 0;
+    slot.m_bitmap.assign ((slot.m_fragmentCount + 63) / 64, 0);
+    slot.m_fragmentSizes.resize (slot.m_fragmentCount);
+    slot.m_parities.clear ();
+    m_lastFragmentCount = slot.m_fragmentCount;
+  }
+  NS_ASSERT (slot.m_frameNumber == frameNumber);
+  if (slot.m_complete)
+  {
+    return FRAGMENT_DUPLICATE;
+  }
+
+  uint16_t index = header.GetFragmentIndex ();
+  if (header.GetMessageType () == VideoStreamHeader::VIDEO_PARITY)
+  {
+    Parity parity;
+    parity.m_first = index;
+    parity.m_count = header.GetGroupSize ();
+    parity.m_lengthRecovery = header.GetLengthRecovery ();
+    if (parity.m_count == 0 || (uint32_t) index + parity.m_count > slot.m_fragmentCount)
+    {
+      NS_LOG_WARN ("Parity of fragments " << index << " to " << index + parity.m_count << " out of range for frame " << frameNumber);
+      return FRAGMENT_DUPLICATE;
+    }
+    slot.m_parities.push_back (parity);
+    Recover (slot, parity);
+  }
+  else
+  {
+    if (index >= slot.m_fragmentCount)
+    {
+      NS_LOG_WARN ("Fragment " << index << " out of range for frame " << frameNumber);
+      return FRAGMENT_DUPLICATE;
+    }
+    if (slot.m_bitmap[index / 64] & ((uint64_t) 1 << (index % 64)))
+    {
+      return FRAGMENT_DUPLICATE;
+    }
+    Store (slot, index, payloadSize);
+    for (const auto &parity : slot.m_parities)
+    {
+      if (index >= parity.m_first && index < parity.m_first + parity.m_count)
+      {
+        Recover (slot, parity);
+        break;
+      }
+    }
+  }
+
+  if (slot.m_receivedFragments == slot.m_fragmentCount)
+  {
+    slot.m_complete = true;
+    m_completeFrames++;
+    return FRAGMENT_COMPLETE;
+  }
+  return FRAGMENT_PARTIAL;
+}
+
+void
+VideoStreamReassembler::Store (FrameSlot &slot, uint16_t index, uint16_t payloadSize)
+{
+  slot.m_bitmap[index / 64] |= (uint64_t) 1 << (index % 64);
+  slot.m_fragmentSizes[index] = payloadSize;
+  slot.m_receivedFragments++;
+  slot.m_receivedBytes += payloadSize;
+}
+
+bool
+VideoStreamReassembler::Recover (FrameSlot &slot, const Parity &parity)
+{
+  // the payload sizes of the group XOR to the recovery field, so the
+  // missing size is what the received ones leave of it
+  uint32_t missing = slot.m_fragmentCount;
+  uint16_t payloadSize = parity.m_lengthRecovery;
+  for (uint32_t index = parity.m_first; index < (uint32_t) parity.m_first + parity.m_count; index++)
+  {
+    if (slot.m_bitmap[index / 64] & ((uint64_t) 1 << (index % 64)))
+    {
+      payloadSize ^= slot.m_fragmentSizes[index];
+    }
+    else if (missing == slot.m_fragmentCount)
+    {
+      missing = index;
+    }
+    else
+    {
+      // two fragments of the group are missing
+      return false;
+    }
+  }
+  if (missing == slot.m_fragmentCount)
+  {
+    return false;
+  }
+
+  NS_LOG_LOGIC ("Fragment " << missing << " of frame " << slot.m_frameNumber << " recovered from parity");
+  Store (slot, missing, payloadSize);
+  slot.m_recoveredFragments++;
+  m_recoveredFragments++;
+  return true;
+}
+
+void
+VideoStreamReassembler::Advance (uint32_t base)
+{
+  NS_LOG_FUNCTION (this << base);
+
+  // frames leaving the window without all their fragments are lost,
+  // including the ones of which no fragment arrived at all
+  uint32_t end = std::min<uint64_t> (base, (uint64_t) m_base + m_slots.size ());
+  for (uint32_t frameNumber = m_base; frameNumber < end; frameNumber++)
+  {
+    FrameSlot &slot = m_slots[frameNumber % m_slots.size ()];
+    if (!slot.m_used || !slot.m_complete)
+    {
+      NS_LOG_LOGIC ("Frame " << frameNumber << " lost with " << (slot.m_used ? slot.m_receivedFragments : 0) << " fragments");
+      m_lostFrames++;
+    }
+    m_expectedFragments += slot.m_used ? slot.m_fragmentCount : m_lastFragmentCount;
+    m_receivedFragments += slot.m_used ? slot.m_receivedFragments - slot.m_recoveredFragments : 0;
+    slot.m_used = false;
+  }
+  m_lostFrames += base - end;
+  m_expectedFragments += (uint64_t) (base - end) * m_lastFragmentCount;
+  m_base = base;
+}
+
+uint32_t
+VideoStreamReassembler::GetFrameBytes (uint32_t frameNumber) const
+{
+  const FrameSlot &slot = m_slots[frameNumber % m_slots.size ()];
+  if (!slot.m_used || slot.m_frameNumber != frameNumber)
+  {
+    return 0;
+  }
+  return slot.m_receivedBytes;
+}
+
+uint32_t
+VideoStreamReassembler::GetFirstIncompleteFrame (uint32_t first, uint32_t end) const
+{
+  if (!m_started)
+  {
+    return first;
+  }
+  // the frames ahead of the window were not received at all
+  uint32_t frameNumber = std::max (first, m_base);
+  for (; frameNumber < end && frameNumber - m_base < m_slots.size (); frameNumber++)
+  {
+    const FrameSlot &slot = m_slots[frameNumber % m_slots.size ()];
+    if (!slot.m_used || slot.m_frameNumber != frameNumber || !slot.m_complete)
+    {
+      break;
+    }
+  }
+  return std::min (frameNumber, end);
+}
+
+bool
+VideoStreamReassembler::GetMissingRanges (uint32_t frameNumber, std::vector<std::pair<uint16_t, uint16_t> > &ranges) const
+{
+  ranges.clear ();
+  if (!m_started || frameNumber < m_base || frameNumber - m_base >= m_slots.size ())
+  {
+    return false;
+  }
+  const FrameSlot &slot = m_slots[frameNumber % m_slots.size ()];
+  if (!slot.m_used || slot.m_frameNumber != frameNumber)
+  {
+    ranges.push_back (std::make_pair (0, UINT16_MAX));
+    return true;
+  }
+  if (slot.m_complete)
+  {
+    return false;
+  }
+
+  for (uint32_t index = 0; index < slot.m_fragmentCount; index++)
+  {
+    if (slot.m_bitmap[index / 64] & ((uint64_t) 1 << (index % 64)))
+    {
+      continue;
+    }
+    if (!ranges.empty () && ranges.back ().first + ranges.back ().second == index)
+    {
+      ranges.back ().second++;
+    }
+    else
+    {
+      ranges.push_back (std::make_pair (index, 1));
+    }
+  }
+  return true;
+}
+
+uint32_t
+VideoStreamReassembler::GetCompleteFrames (void) const
+{
+  return m_completeFrames;
+}
+
+uint32_t
+VideoStreamReassembler::GetLostFrames (void) const
+{
+  return m_lostFrames;
+}
+
+uint32_t
+VideoStreamReassembler::GetPartialFrames (void) const
+{
+  uint32_t partialFrames = 0;
+  for (const auto &slot : m_slots)
+  {
+    if (slot.m_used && !slot.m_complete)
+    {
+      partialFrames++;
+    }
+  }
+  return partialFrames;
+}
+
+uint64_t
+VideoStreamReassembler::GetExpectedFragments (void) const
+{
+  return m_expectedFragments;
+}
+
+uint64_t
+VideoStreamReassembler::GetReceivedFragments (void) const
+{
+  return m_receivedFragments;
+}
+
+uint64_t
+VideoStreamReassembler::GetRecoveredFragments (void) const
+{
+  return m_recoveredFragments;
+}
+
+} // namespace ns3
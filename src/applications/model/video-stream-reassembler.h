@@ -0,0 +1,218 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_REASSEMBLER_H
+#define VIDEO_STREAM_REASSEMBLER_H
+
+#include "ns3/video-stream-header.h"
+
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief Reassemble video frames from their fragments.
+   *
+   * The reassembler keeps a window of the most recent frames in a ring
+   * indexed by frame number, with one bitmap of received fragments per frame.
+   * Fragments may arrive in any order as long as their frame is still in the
+   * window. When a fragment of a frame beyond the window arrives, the oldest
+   * frames leave the window, and those that were not complete are counted as
+   * lost.
+   *
+   * Parity packets are kept with their frame. Whenever a group of fragments
+   * protected by a parity packet misses a single fragment, the fragment is
+   * rebuilt from the parity and the other fragments of the group.
+   */
+  class VideoStreamReassembler
+  {
+  public:
+    /**
+     * @brief The outcome of adding a fragment.
+     */
+    enum FragmentStatus
+    {
+      FRAGMENT_PARTIAL, //!< The fragment was stored, the frame is not complete yet
+      FRAGMENT_COMPLETE, //!< The fragment completed its frame
+      FRAGMENT_DUPLICATE, //!< The fragment was already received
+      FRAGMENT_LATE //!< The frame of the fragment already left the window
+    };
+
+    /**
+     * @brief Construct a new VideoStreamReassembler object.
+     *
+     * @param windowSize the number of frames kept in the window
+     */
+    VideoStreamReassembler (uint32_t windowSize);
+
+    /**
+     * @brief Set the number of frames kept in the window, dropping all state.
+     *
+     * @param windowSize the number of frames kept in the window
+     */
+    void SetWindowSize (uint32_t windowSize);
+
+    /**
+     * @brief Get the number of frames kept in the window.
+     *
+     * @return the number of frames kept in the window
+     */
+    uint32_t GetWindowSize (void) const;
+
+    /**
+     * @brief Record the reception of a fragment or of a parity packet.
+     *
+     * @param header the header of the fragment or of the parity packet
+     * @param payloadSize the number of frame bytes carried by the fragment
+     * @return the status of the fragment
+     */
+    FragmentStatus AddFragment (const VideoStreamHeader &header, uint32_t payloadSize);
+
+    /**
+     * @brief Get the number of bytes received for a frame in the window.
+     *
+     * @param frameNumber the frame number
+     * @return the number of bytes received (0 if the frame is not in the window)
+     */
+    uint32_t GetFrameBytes (uint32_t frameNumber) const;
+
+    /**
+     * @brief Get the ranges of the missing fragments of a frame in the
+     * window.
+     *
+     * A frame of which no fragment arrived has a single range from
+     * fragment 0 to the largest fragment count, its own being unknown.
+     *
+     * @param frameNumber the frame number
+     * @param [out] ranges the first fragment and the number of fragments of
+     * each missing range
+     * @return false if the frame is complete or not in the window
+     */
+    bool GetMissingRanges (uint32_t frameNumber, std::vector<std::pair<uint16_t, uint16_t> > &ranges) const;
+
+    /**
+     * @brief Get the first frame of a range not received completely.
+     *
+     * The frames that left the window are skipped, since they can not be
+     * completed any more.
+     *
+     * @param first the first frame of the range
+     * @param end the frame after the last one of the range
+     * @return the first incomplete frame, or end if all the frames of the
+     * range are complete or left the window
+     */
+    uint32_t GetFirstIncompleteFrame (uint32_t first, uint32_t end) const;
+
+    /**
+     * @brief Get the number of frames received completely.
+     *
+     * @return the number of complete frames
+     */
+    uint32_t GetCompleteFrames (void) const;
+
+    /**
+     * @brief Get the number of frames that left the window incomplete.
+     *
+     * @return the number of lost frames
+     */
+    uint32_t GetLostFrames (void) const;
+
+    /**
+     * @brief Get the number of frames in the window with missing fragments.
+     *
+     * @return the number of partial frames
+     */
+    uint32_t GetPartialFrames (void) const;
+
+    /**
+     * @brief Get the number of fragments of the frames that left the window.
+     *
+     * The frames of which no fragment arrived are counted with the
+     * fragment count of the last new frame, since their own is unknown.
+     *
+     * @return the number of expected fragments
+     */
+    uint64_t GetExpectedFragments (void) const;
+
+    /**
+     * @brief Get the number of fragments received for the frames that left
+     * the window, not counting the ones rebuilt from parity.
+     *
+     * @return the number of received fragments
+     */
+    uint64_t GetReceivedFragments (void) const;
+
+    /**
+     * @brief Get the number of fragments rebuilt from parity.
+     *
+     * @return the number of recovered fragments
+     */
+    uint64_t GetRecoveredFragments (void) const;
+
+  private:
+    /**
+     * @brief A parity packet received for a frame.
+     */
+    typedef struct Parity
+    {
+      uint16_t m_first; //!< First fragment of the group
+      uint16_t m_count; //!< Number of fragments of the group
+      uint16_t m_lengthRecovery; //!< XOR of the payload sizes of the group
+    } Parity;
+
+    /**
+     * @brief The reassembly state of one frame.
+     */
+    typedef struct FrameSlot
+    {
+      uint32_t m_frameNumber; //!< Frame number
+      bool m_used; //!< Whether the slot holds a frame
+      bool m_complete; //!< Whether all the fragments were received
+      uint16_t m_fragmentCount; //!< Number of fragments of the frame
+      uint16_t m_receivedFragments; //!< Number of fragments received or recovered
+      uint16_t m_recoveredFragments; //!< Number of fragments rebuilt from parity
+      uint32_t m_receivedBytes; //!< Number of frame bytes received or recovered
+      std::vector<uint64_t> m_bitmap; //!< Received fragments, one bit per fragment
+      std::vector<uint16_t> m_fragmentSizes; //!< Payload size of each received fragment
+      std::vector<Parity> m_parities; //!< Parity packets received for the frame
+    } FrameSlot;
+
+    /**
+     * @brief Mark a fragment of a frame as received.
+     *
+     * @param slot the frame
+     * @param index the index of the fragment, not received yet
+     * @param payloadSize the payload size of the fragment
+     */
+    void Store (FrameSlot &slot, uint16_t index, uint16_t payloadSize);
+
+    /**
+     * @brief Rebuild the missing fragment of a group if it is the only one.
+     *
+     * @param slot the frame
+     * @param parity the parity packet of the group
+     * @return true if a fragment was rebuilt
+     */
+    bool Recover (FrameSlot &slot, const Parity &parity);
+
+    /**
+     * @brief Move the window so that it starts at the given frame.
+     *
+     * @param base the first frame of the window
+     */
+    void Advance (uint32_t base);
+
+    std::vector<FrameSlot> m_slots; //!< Ring of frames indexed by frame number
+    bool m_started; //!< Whether any fragment was received
+    uint32_t m_base; //!< First frame of the window
+    uint32_t m_completeFrames; //!< Number of complete frames
+    uint32_t m_lostFrames; //!< Number of lost frames
+    uint16_t m_lastFragmentCount; //!< Number of fragments of the last new frame
+    uint64_t m_expectedFragments; //!< Number of fragments of the frames that left the window
+    uint64_t m_receivedFragments; //!< Number of fragments received for the frames that left the window
+    uint64_t m_recoveredFragments; //!< Number of fragments rebuilt from parity
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_REASSEMBLER_H */
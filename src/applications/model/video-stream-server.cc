@@ -9,16 +9,58 @@
 #include "ns3/inet6-socket-address.h"
 #include "ns3/socket.h"
 #include "ns3/udp-socket.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/tcp-socket-factory.h"
 #include "ns3/simulator.h"
 #include "ns3/socket-factory.h"
 #include "ns3/packet.h"
 #include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/boolean.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/video-stream-header.h"
+#include "ns3/video-stream-control-header.h"
 #include "ns3/video-stream-server.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("VideoStreamServerApplication");
 
+namespace {
+
+/**
+ * @brief Format the IP address and port of a socket address for logging.
+ *
+ * @param address an InetSocketAddress or an Inet6SocketAddress
+ * @return the formatted address
+ */
+std::string
+FormatAddress (const Address &address)
+{
+  std::ostringstream oss;
+  if (InetSocketAddress::IsMatchingType (address))
+  {
+    oss << InetSocketAddress::ConvertFrom (address).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (address).GetPort ();
+  }
+  else if (Inet6SocketAddress::IsMatchingType (address))
+  {
+    oss << Inet6SocketAddress::ConvertFrom (address).GetIpv6 () << " port " << Inet6SocketAddress::ConvertFrom (address).GetPort ();
+  }
+  else
+  {
+    oss << address;
+  }
+  return oss.str ();
+}
+
+} // anonymous namespace
+
 NS_OBJECT_ENSURE_REGISTERED (VideoStreamServer);
 
 TypeId
@@ -36,18 +78,112 @@ VideoStreamServer::GetTypeId (void)
                     UintegerValue (5000),
                     MakeUintegerAccessor (&VideoStreamServer::m_port),
                     MakeUintegerChecker<uint16_t> ())
-    .AddAttribute ("MaxPacketSize", "The maximum size of a packet",
+    .AddAttribute ("Protocol", "The type of the socket factory, ns3::UdpSocketFactory or ns3::TcpSocketFactory",
+                    TypeIdValue (UdpSocketFactory::GetTypeId ()),
+                    MakeTypeIdAccessor (&VideoStreamServer::m_protocol),
+                    MakeTypeIdChecker ())
+    .AddAttribute ("MaxPacketSize", "The maximum size of a packet, including the video stream header",
                     UintegerValue (1400),
                     MakeUintegerAccessor (&VideoStreamServer::m_maxPacketSize),
                     MakeUintegerChecker<uint16_t> ())
-    .AddAttribute ("FrameFile", "The file that contains the video frame sizes",
+    .AddAttribute ("FrameFile", "The file that contains the video frame sizes, as text or in the binary trace format",
                     StringValue (""),
                     MakeStringAccessor (&VideoStreamServer::SetFrameFile, &VideoStreamServer::GetFrameFile),
                     MakeStringChecker ())
+    .AddAttribute ("LadderFile", "The file that defines the bitrate, resolution and frame sizes of each video level, used instead of FrameFile",
+                    StringValue (""),
+                    MakeStringAccessor (&VideoStreamServer::SetLadderFile, &VideoStreamServer::GetLadderFile),
+                    MakeStringChecker ())
     .AddAttribute ("VideoLength", "The length of the video in seconds",
                     UintegerValue (60),
                     MakeUintegerAccessor (&VideoStreamServer::m_videoLength),
                     MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PacingMode", "How the fragments of a frame are spread in time",
+                    EnumValue (NO_PACING),
+                    MakeEnumAccessor (&VideoStreamServer::m_pacingMode),
+                    MakeEnumChecker (NO_PACING, "None",
+                                     FRAME_INTERVAL_PACING, "FrameInterval",
+                                     TOKEN_BUCKET_PACING, "TokenBucket"))
+    .AddAttribute ("PacingRate", "The rate of the token bucket pacer of each client",
+                    DataRateValue (DataRate ("10Mbps")),
+                    MakeDataRateAccessor (&VideoStreamServer::m_pacingRate),
+                    MakeDataRateChecker ())
+    .AddAttribute ("PacingBurst", "The size of the token bucket of each client in bytes",
+                    UintegerValue (14000),
+                    MakeUintegerAccessor (&VideoStreamServer::m_pacingBurst),
+                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("PacingQueueLimit", "The maximum number of frames in the pacing queue of a client, a frame chosen by DropPolicy is dropped beyond it (segments requested by a client are never dropped, and a TCP client gets no new frame until its queue drains)",
+                    UintegerValue (8),
+                    MakeUintegerAccessor (&VideoStreamServer::m_pacingQueueLimit),
+                    MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("DropPolicy", "Which frames are dropped from a full pacing queue, the frame types coming from the trace or the ladder (FrameType drops the oldest frame, as Oldest, on traces without frame types)",
+                    EnumValue (DROP_OLDEST),
+                    MakeEnumAccessor (&VideoStreamServer::m_dropPolicy),
+                    MakeEnumChecker (DROP_OLDEST, "Oldest",
+                                     DROP_BY_FRAME_TYPE, "FrameType"))
+    .AddAttribute ("BatchedTick", "Serve all the clients from a single frame clock instead of one event per client",
+                    BooleanValue (false),
+                    MakeBooleanAccessor (&VideoStreamServer::m_batchedTick),
+                    MakeBooleanChecker ())
+    .AddAttribute ("SessionTimeout", "The time without any message from a client after which its session is closed, the clients pinging the server every second",
+                    TimeValue (Seconds (30.0)),
+                    MakeTimeAccessor (&VideoStreamServer::m_sessionTimeout),
+                    MakeTimeChecker ())
+    .AddAttribute ("PacketCache", "Build each fragment once per time step and hand copies of it to the clients at the same frame and level",
+                    BooleanValue (true),
+                    MakeBooleanAccessor (&VideoStreamServer::m_packetCacheEnabled),
+                    MakeBooleanChecker ())
+    .AddAttribute ("MulticastGroup", "The multicast group of video level 1, the next addresses being the groups of the next levels (0.0.0.0 to send to each client)",
+                    Ipv4AddressValue (Ipv4Address::GetAny ()),
+                    MakeIpv4AddressAccessor (&VideoStreamServer::m_multicastGroup),
+                    MakeIpv4AddressChecker ())
+    .AddAttribute ("MulticastPort", "The destination port of the multicast groups",
+                    UintegerValue (5001),
+                    MakeUintegerAccessor (&VideoStreamServer::m_multicastPort),
+                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("FecGroupSize", "The number of fragments of a frame protected by each XOR parity packet, the overhead being one packet per group (0 for no forward error correction)",
+                    UintegerValue (0),
+                    MakeUintegerAccessor (&VideoStreamServer::m_fecGroupSize),
+                    MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("RetransmissionWindow", "The number of recent frames of a client whose fragments are sent again on a NACK (0 to ignore the NACKs)",
+                    UintegerValue (32),
+                    MakeUintegerAccessor (&VideoStreamServer::m_retransmissionWindow),
+                    MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("RateControl", "How the server caps the video level of a client from its receiver reports",
+                    EnumValue (NO_RATE_CONTROL),
+                    MakeEnumAccessor (&VideoStreamServer::m_rateControl),
+                    MakeEnumChecker (NO_RATE_CONTROL, "None",
+                                     AIMD_RATE_CONTROL, "Aimd"))
+    .AddAttribute ("LossThreshold", "The fraction of lost fragments in a receiver report above which the target rate of the client is cut",
+                    DoubleValue (0.02),
+                    MakeDoubleAccessor (&VideoStreamServer::m_lossThreshold),
+                    MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("RateIncrease", "The step the target rate of a client is raised by on a receiver report without loss",
+                    DataRateValue (DataRate ("100kbps")),
+                    MakeDataRateAccessor (&VideoStreamServer::m_rateIncrease),
+                    MakeDataRateChecker ())
+    .AddAttribute ("RateDecrease", "The factor the target rate of a client is multiplied by on a receiver report with loss",
+                    DoubleValue (0.5),
+                    MakeDoubleAccessor (&VideoStreamServer::m_rateDecrease),
+                    MakeDoubleChecker<double> (0, 1))
+    .AddTraceSource ("PacingQueue", "Number of fragments waiting in the pacing queue of a client",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_pacingQueueTrace),
+                    "ns3::VideoStreamServer::PacingQueueTracedCallback")
+    .AddTraceSource ("FrameSent", "A frame was handed to the pacer or sent to a client",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_frameSentTrace),
+                    "ns3::VideoStreamServer::FrameSentTracedCallback")
+    .AddTraceSource ("FrameDropped", "A frame was dropped for a client falling behind",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_frameDroppedTrace),
+                    "ns3::VideoStreamServer::FrameDroppedTracedCallback")
+    .AddTraceSource ("ReceiverReport", "A client reported its reception",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_receiverReportTrace),
+                    "ns3::VideoStreamServer::ReceiverReportTracedCallback")
+    .AddTraceSource ("SessionRate", "The rate control updated the target rate and the level cap of a client",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_sessionRateTrace),
+                    "ns3::VideoStreamServer::SessionRateTracedCallback")
+    .AddTraceSource ("Retransmission", "Fragments of a frame were sent again to a client on a NACK",
+                    MakeTraceSourceAccessor (&VideoStreamServer::m_retransmissionTrace),
+                    "ns3::VideoStreamServer::RetransmissionTracedCallback")
     ;
     return tid;
 }
@@ -56,20 +192,43 @@ VideoStreamServer::VideoStreamServer ()
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_socket6 = 0;
+  m_tcp = false;
   m_frameRate = 25;
-  m_frameSizeList = std::vector<uint32_t>();
+  m_trace = 0;
+  m_ladder = 0;
+  m_plan = 0;
+  m_pacingMode = NO_PACING;
+  m_dropPolicy = DROP_OLDEST;
+  m_rateControl = NO_RATE_CONTROL;
+  m_fecGroupSize = 0;
+  m_retransmissionWindow = 32;
+  m_batchedTick = false;
+  m_wheel.resize (64);
+  m_wheelEntries = 0;
+  m_tick = 0;
+  m_groupFrame = 0;
+  m_packetCacheEnabled = true;
 }
 
 VideoStreamServer::~VideoStreamServer ()
 {
   NS_LOG_FUNCTION (this);
   m_socket = 0;
+  m_socket6 = 0;
 }
 
 void 
 VideoStreamServer::DoDispose (void)
 {
   NS_LOG_FUNCTION (this);
+  m_trace = 0;
+  m_ladder = 0;
+  m_plan = 0;
+  m_sessions.clear ();
+  m_freeSlots.clear ();
+  m_clients.clear ();
+  m_packetCache.clear ();
   Application::DoDispose ();
 }
 
@@ -77,11 +236,15 @@ void
 VideoStreamServer::StartApplication (void)
 {
   NS_LOG_FUNCTION (this);
+  NS_ABORT_MSG_IF (m_maxPacketSize <= GetMaxHeaderSize (), "MaxPacketSize must be larger than the video stream header");
+  UpdatePlan ();
+  m_tcp = m_protocol == TcpSocketFactory::GetTypeId ();
+  NS_ABORT_MSG_IF (m_tcp && m_multicastGroup.IsMulticast (), "The multicast groups need UDP");
+  NS_ABORT_MSG_IF (m_tcp && m_fecGroupSize > 0, "TCP does not lose fragments, the forward error correction needs UDP");
 
   if (m_socket == 0)
   {
-    TypeId tid = TypeId::LookupByName ("ns3::UdpSocketFactory");
-    m_socket = Socket::CreateSocket (GetNode (), tid);
+    m_socket = Socket::CreateSocket (GetNode (), m_protocol);
     InetSocketAddress local = InetSocketAddress (Ipv4Address::GetAny (), m_port);
     if (m_socket->Bind (local) == -1)
     {
@@ -101,8 +264,27 @@ VideoStreamServer::StartApplication (void)
     }
   }
 
+  if (m_socket6 == 0)
+  {
+    m_socket6 = Socket::CreateSocket (GetNode (), m_protocol);
+    Inet6SocketAddress local6 = Inet6SocketAddress (Ipv6Address::GetAny (), m_port);
+    if (m_socket6->Bind (local6) == -1)
+    {
+      NS_FATAL_ERROR ("Failed to bind socket");
+    }
+  }
+
+  if (m_tcp)
+  {
+    m_socket->Listen ();
+    m_socket6->Listen ();
+    m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (), MakeCallback (&VideoStreamServer::HandleAccept, this));
+    m_socket6->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (), MakeCallback (&VideoStreamServer::HandleAccept, this));
+    return;
+  }
   m_socket->SetAllowBroadcast (true);
   m_socket->SetRecvCallback (MakeCallback (&VideoStreamServer::HandleRead, this));
+  m_socket6->SetRecvCallback (MakeCallback (&VideoStreamServer::HandleRead, this));
 }
 
 void
@@ -117,11 +299,28 @@ VideoStreamServer::StopApplication ()
     m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
     m_socket = 0;
   }
+  if (m_socket6 != 0)
+  {
+    m_socket6->Close();
+    m_socket6->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+    m_socket6 = 0;
+  }
 
-  for (auto iter = m_clients.begin (); iter != m_clients.end (); iter++)
+  for (uint32_t slot = 0; slot < m_sessions.size (); slot++)
   {
-    Simulator::Cancel (iter->second->m_sendEvent);
+    if (m_sessions[slot].m_active)
+    {
+      CloseSession (((uint64_t) m_sessions[slot].m_generation << 32) | slot);
+    }
   }
+  Simulator::Cancel (m_evictEvent);
+  Simulator::Cancel (m_tickEvent);
+  Simulator::Cancel (m_groupEvent);
+  for (auto iter = m_wheel.begin (); iter != m_wheel.end (); iter++)
+  {
+    iter->clear ();
+  }
+  m_wheelEntries = 0;
   
 }
 
@@ -130,17 +329,17 @@ VideoStreamServer::SetFrameFile (std::string frameFile)
 {
   NS_LOG_FUNCTION (this << frameFile);
   m_frameFile = frameFile;
+  m_trace = 0;
   if (frameFile != "")
   {
-    std::string line;
-    std::ifstream fileStream(frameFile);
-    while (std::getline (fileStream, line))
-    {
-      int result = std::stoi(line);
-      m_frameSizeList.push_back (result);
-    }
+    // the trace is parsed once and shared by every server using the same file
+    m_trace = VideoStreamTrace::Load (frameFile);
+    NS_LOG_INFO ("Frame list size: " << m_trace->GetNFrames ());
+  }
+  if (m_plan != 0)
+  {
+    UpdatePlan ();
   }
-  NS_LOG_INFO ("Frame list size: " << m_frameSizeList.size());
 }
 
 std::string
@@ -150,10 +349,41 @@ VideoStreamServer::GetFrameFile (void) const
   return m_frameFile;
 }
 
+void
+VideoStreamServer::SetLadderFile (std::string ladderFile)
+{
+  NS_LOG_FUNCTION (this << ladderFile);
+  m_ladderFile = ladderFile;
+  m_ladder = 0;
+  if (ladderFile != "")
+  {
+    m_ladder = VideoStreamLadder::Load (ladderFile);
+    if (m_ladder->GetFrameRate () != m_frameRate)
+    {
+      NS_LOG_WARN ("The ladder is encoded at " << m_ladder->GetFrameRate () << " frames per second, the server sends " << m_frameRate);
+    }
+  }
+  if (m_plan != 0)
+  {
+    UpdatePlan ();
+  }
+}
+
+std::string
+VideoStreamServer::GetLadderFile (void) const
+{
+  NS_LOG_FUNCTION (this);
+  return m_ladderFile;
+}
+
 void
 VideoStreamServer::SetMaxPacketSize (uint32_t maxPacketSize)
 {
   m_maxPacketSize = maxPacketSize;
+  if (m_plan != 0)
+  {
+    UpdatePlan ();
+  }
 }
 
 uint32_t
@@ -162,53 +392,710 @@ VideoStreamServer::GetMaxPacketSize (void) const
   return m_maxPacketSize;
 }
 
+uint32_t
+VideoStreamServer::GetNSessions (void) const
+{
+  return m_clients.size ();
+}
+
+size_t
+VideoStreamServer::AddressHash::operator() (const Address &address) const
+{
+  uint8_t buffer[Address::MAX_SIZE + 2];
+  uint32_t size = address.CopyAllTo (buffer, sizeof (buffer));
+
+  // 64-bit FNV-1a over the type, length and bytes of the address
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    hash ^= buffer[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t
+VideoStreamServer::OpenSession (const Address &address)
+{
+  NS_LOG_FUNCTION (this << address);
+
+  // reuse a released slot before growing the table
+  uint32_t slot;
+  if (!m_freeSlots.empty ())
+  {
+    slot = m_freeSlots.back ();
+    m_freeSlots.pop_back ();
+  }
+  else
+  {
+    slot = m_sessions.size ();
+    m_sessions.push_back (ClientInfo ());
+    m_sessions[slot].m_generation = 0;
+  }
+
+  ClientInfo *newClient = &m_sessions[slot];
+  newClient->m_active = true;
+  newClient->m_pull = false;
+  newClient->m_sent = 0;
+  newClient->m_videoLevel = 3;
+  newClient->m_address = address;
+  newClient->m_lastActivity = Simulator::Now ();
+  newClient->m_queuedFragments = 0;
+  newClient->m_awaitKeyFrame = false;
+  newClient->m_stalled = false;
+  newClient->m_tokens = m_pacingBurst;
+  newClient->m_lastRefill = Simulator::Now ();
+  newClient->m_targetRate = 0;
+  newClient->m_levelCap = std::numeric_limits<uint16_t>::max ();
+  m_clients[address] = slot;
+
+  if (!m_evictEvent.IsRunning ())
+  {
+    m_evictEvent = Simulator::Schedule (m_sessionTimeout, &VideoStreamServer::EvictIdleSessions, this);
+  }
+  return ((uint64_t) newClient->m_generation << 32) | slot;
+}
+
+void
+VideoStreamServer::CloseSession (uint64_t sessionId)
+{
+  NS_LOG_FUNCTION (this << sessionId);
+
+  ClientInfo *clientInfo = GetSession (sessionId);
+  if (clientInfo == 0)
+  {
+    return;
+  }
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server closed the session of " << FormatAddress (clientInfo->m_address));
+
+  Simulator::Cancel (clientInfo->m_sendEvent);
+  Simulator::Cancel (clientInfo->m_pacingEvent);
+  if (m_multicastGroup.IsMulticast () && !clientInfo->m_pull)
+  {
+    Unsubscribe (clientInfo->m_videoLevel);
+  }
+  if (clientInfo->m_socket != 0)
+  {
+    clientInfo->m_socket->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+    clientInfo->m_socket->Close ();
+    clientInfo->m_socket = 0;
+  }
+  // release the memory of the queue instead of keeping its capacity in the slot
+  std::vector<QueuedFrame> ().swap (clientInfo->m_pacingQueue);
+  std::deque<QueuedFrame> ().swap (clientInfo->m_sentFrames);
+  clientInfo->m_queuedFragments = 0;
+  clientInfo->m_active = false;
+  clientInfo->m_generation++;
+
+  m_clients.erase (clientInfo->m_address);
+  m_freeSlots.push_back (sessionId & 0xffffffff);
+}
+
+VideoStreamServer::ClientInfo *
+VideoStreamServer::GetSession (uint64_t sessionId)
+{
+  uint32_t slot = sessionId & 0xffffffff;
+  if (slot >= m_sessions.size () || !m_sessions[slot].m_active
+      || m_sessions[slot].m_generation != (sessionId >> 32))
+  {
+    return 0;
+  }
+  return &m_sessions[slot];
+}
+
+void
+VideoStreamServer::EvictIdleSessions (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Time now = Simulator::Now ();
+  for (uint32_t slot = 0; slot < m_sessions.size (); slot++)
+  {
+    ClientInfo &clientInfo = m_sessions[slot];
+    if (clientInfo.m_active && now - clientInfo.m_lastActivity >= m_sessionTimeout)
+    {
+      CloseSession (((uint64_t) clientInfo.m_generation << 32) | slot);
+    }
+  }
+
+  if (!m_clients.empty ())
+  {
+    m_evictEvent = Simulator::Schedule (m_sessionTimeout, &VideoStreamServer::EvictIdleSessions, this);
+  }
+}
+
 void 
-VideoStreamServer::Send (uint32_t ipAddress)
+VideoStreamServer::Send (uint64_t sessionId)
 {
   NS_LOG_FUNCTION (this);
 
-  uint32_t frameSize, totalFrames;
-  ClientInfo *clientInfo = m_clients.at (ipAddress);
+  ClientInfo *clientInfo = GetSession (sessionId);
+  if (clientInfo == 0)
+  {
+    return;
+  }
 
   NS_ASSERT (clientInfo->m_sendEvent.IsExpired ());
-  // If the frame sizes are not from the text file, and the list is empty
-  if (m_frameSizeList.empty ())
+  // the connection holds the frames back, the next one waits for room
+  // instead of dropping a queued one
+  if (m_tcp && clientInfo->m_pacingQueue.size () >= m_pacingQueueLimit)
+  {
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server holds frame " << clientInfo->m_sent << " for " << FormatAddress (clientInfo->m_address));
+    clientInfo->m_stalled = true;
+    return;
+  }
+  SendFrame (sessionId, clientInfo->m_sent);
+  clientInfo->m_sent += 1;
+  if (clientInfo->m_sent < GetNFrames ())
+  {
+    ScheduleSend (sessionId, m_interval);
+  }
+}
+
+void
+VideoStreamServer::SendFrame (uint64_t sessionId, uint32_t frameNumber)
+{
+  ClientInfo *clientInfo = GetSession (sessionId);
+  QueuedFrame frame = MakeFrame (frameNumber, std::min (clientInfo->m_videoLevel, clientInfo->m_levelCap));
+
+  // the rest of a group of pictures whose reference frame was dropped can not be decoded
+  if (clientInfo->m_awaitKeyFrame)
   {
-    frameSize = m_frameSizes[clientInfo->m_videoLevel];
-    totalFrames = m_videoLength * m_frameRate;
+    if (frame.m_frameType != VideoStreamTrace::I_FRAME)
+    {
+      NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server dropped frame " << frameNumber << " waiting for a key frame for " << FormatAddress (clientInfo->m_address));
+      m_frameDroppedTrace (clientInfo->m_address, frameNumber, frame.m_frameType);
+      return;
+    }
+    clientInfo->m_awaitKeyFrame = false;
+  }
+
+  if (m_pacingMode == NO_PACING && !m_tcp)
+  {
+    for (uint32_t i = 0; i < frame.m_packetCount; i++)
+    {
+      SendPacket (clientInfo->m_address, frame, i);
+    }
   }
   else
   {
-    frameSize = m_frameSizeList[clientInfo->m_sent] * clientInfo->m_videoLevel;
-    totalFrames = m_frameSizeList.size ();
+    // keep the footprint of a session bounded when it falls behind, a TCP
+    // session bounds it by stopping its frame clock instead
+    if (!clientInfo->m_pull && !m_tcp && clientInfo->m_pacingQueue.size () >= m_pacingQueueLimit
+        && !MakeRoom (clientInfo, frame))
+    {
+      NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server dropped frame " << frameNumber << " for " << FormatAddress (clientInfo->m_address));
+      m_frameDroppedTrace (clientInfo->m_address, frameNumber, frame.m_frameType);
+      return;
+    }
+    clientInfo->m_pacingQueue.push_back (frame);
+    clientInfo->m_queuedFragments += frame.m_packetCount;
+    m_pacingQueueTrace (clientInfo->m_address, clientInfo->m_queuedFragments);
+    if (m_tcp)
+    {
+      SendStream (sessionId);
+    }
+    else if (!clientInfo->m_pacingEvent.IsRunning ())
+    {
+      SendPaced (sessionId);
+    }
   }
 
-  // the frame might require several packets to send
-  for (uint i = 0; i < frameSize / m_maxPacketSize; i++)
+  if (m_retransmissionWindow > 0 && !m_tcp)
   {
-    SendPacket (clientInfo, m_maxPacketSize);
+    clientInfo->m_sentFrames.push_back (frame);
+    if (clientInfo->m_sentFrames.size () > m_retransmissionWindow)
+    {
+      clientInfo->m_sentFrames.pop_front ();
+    }
   }
-  uint32_t remainder = frameSize % m_maxPacketSize;
-  SendPacket (clientInfo, remainder);
 
-  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server sent frame " << clientInfo->m_sent << " and " << frameSize << " bytes to " << InetSocketAddress::ConvertFrom (clientInfo->m_address).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (clientInfo->m_address).GetPort ());
+  m_frameSentTrace (clientInfo->m_address, frameNumber, frame.m_frameSize, frame.m_videoLevel);
+  NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server sent frame " << frameNumber << " and " << frame.m_frameSize << " bytes to " << FormatAddress (clientInfo->m_address));
+}
 
-  clientInfo->m_sent += 1;
-  if (clientInfo->m_sent < totalFrames)
+bool
+VideoStreamServer::MakeRoom (ClientInfo *clientInfo, const QueuedFrame &frame)
+{
+  NS_LOG_FUNCTION (this << frame.m_frameNumber);
+
+  // the frame at the front may be partly sent already, dropping it would
+  // waste the fragments on the wire and leave the client an incomplete frame
+  std::vector<QueuedFrame> &queue = clientInfo->m_pacingQueue;
+  uint32_t first = !queue.empty () && queue.front ().m_nextPacket > 0 ? 1 : 0;
+  if (first == queue.size ())
+  {
+    clientInfo->m_awaitKeyFrame |= m_dropPolicy == DROP_BY_FRAME_TYPE && frame.m_frameType == VideoStreamTrace::P_FRAME;
+    return false;
+  }
+  if (m_dropPolicy == DROP_OLDEST)
   {
-    clientInfo->m_sendEvent = Simulator::Schedule (m_interval, &VideoStreamServer::Send, this, ipAddress);
+    DropQueuedFrame (clientInfo, first);
+    return true;
   }
+
+  // the least important type among the queued frames and the new one
+  VideoStreamTrace::FrameType worst = frame.m_frameType;
+  for (uint32_t i = first; i < queue.size (); i++)
+  {
+    worst = std::max (worst, queue[i].m_frameType);
+  }
+
+  if (worst == VideoStreamTrace::B_FRAME)
+  {
+    // no frame depends on a B frame, the oldest one is the least useful
+    for (uint32_t i = first; i < queue.size (); i++)
+    {
+      if (queue[i].m_frameType == VideoStreamTrace::B_FRAME)
+      {
+        DropQueuedFrame (clientInfo, i);
+        return true;
+      }
+    }
+    return false;
+  }
+  if (worst == VideoStreamTrace::P_FRAME)
+  {
+    // the newest P frame has the fewest frames depending on it, which the
+    // client could not decode anyway
+    if (frame.m_frameType == VideoStreamTrace::P_FRAME)
+    {
+      clientInfo->m_awaitKeyFrame = true;
+      return false;
+    }
+    for (uint32_t i = queue.size (); i-- > first; )
+    {
+      if (queue[i].m_frameType == VideoStreamTrace::P_FRAME)
+      {
+        DropQueuedFrame (clientInfo, i);
+        return true;
+      }
+    }
+  }
+  // only key frames, the oldest one is the most stale
+  DropQueuedFrame (clientInfo, first);
+  return true;
 }
 
-void 
-VideoStreamServer::SendPacket (ClientInfo *client, uint32_t packetSize)
+void
+VideoStreamServer::DropQueuedFrame (ClientInfo *clientInfo, uint32_t index)
+{
+  std::vector<QueuedFrame> &queue = clientInfo->m_pacingQueue;
+  NS_ASSERT (index < queue.size ());
+  const QueuedFrame &frame = queue[index];
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server dropped frame " << frame.m_frameNumber << " for " << FormatAddress (clientInfo->m_address));
+  m_frameDroppedTrace (clientInfo->m_address, frame.m_frameNumber, frame.m_frameType);
+  clientInfo->m_queuedFragments -= frame.m_packetCount - frame.m_nextPacket;
+
+  // a dropped frame is not sent again on a NACK
+  if (!frame.m_retransmission)
+  {
+    std::deque<QueuedFrame> &sentFrames = clientInfo->m_sentFrames;
+    for (auto iter = sentFrames.begin (); iter != sentFrames.end (); iter++)
+    {
+      if (iter->m_frameNumber == frame.m_frameNumber)
+      {
+        sentFrames.erase (iter);
+        break;
+      }
+    }
+  }
+  queue.erase (queue.begin () + index);
+}
+
+void
+VideoStreamServer::SendSegment (uint64_t sessionId, uint32_t firstFrame, uint16_t frameCount)
+{
+  NS_LOG_FUNCTION (this << sessionId << firstFrame << frameCount);
+
+  ClientInfo *clientInfo = GetSession (sessionId);
+  uint32_t endFrame = std::min<uint64_t> ((uint64_t) firstFrame + frameCount, GetNFrames ());
+  uint16_t videoLevel = std::min (clientInfo->m_videoLevel, clientInfo->m_levelCap);
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server sends frames " << firstFrame << " to " << endFrame << " at level " << videoLevel
+               << " (" << (firstFrame < endFrame ? m_plan->GetRangeSize (firstFrame, endFrame, videoLevel) : 0) << " bytes) to " << FormatAddress (clientInfo->m_address));
+  for (uint32_t frameNumber = firstFrame; frameNumber < endFrame; frameNumber++)
+  {
+    SendFrame (sessionId, frameNumber);
+  }
+}
+
+void
+VideoStreamServer::ScheduleSend (uint64_t sessionId, Time delay)
+{
+  NS_LOG_FUNCTION (this << sessionId << delay);
+
+  if (!m_batchedTick)
+  {
+    GetSession (sessionId)->m_sendEvent = Simulator::Schedule (delay, &VideoStreamServer::Send, this, sessionId);
+    return;
+  }
+
+  // the tick being served is m_tick, so later frames go at least one tick further
+  WheelEntry entry;
+  entry.m_sessionId = sessionId;
+  entry.m_dueTick = m_tick + (delay.IsZero () ? 0 : std::max<int64_t> (1, std::llround (delay.GetSeconds () / m_interval.GetSeconds ())));
+  m_wheel[entry.m_dueTick % m_wheel.size ()].push_back (entry);
+  m_wheelEntries++;
+
+  // the clock stops when no client is waiting, and restarts right away
+  if (!m_tickEvent.IsRunning ())
+  {
+    m_tickEvent = Simulator::ScheduleNow (&VideoStreamServer::Tick, this);
+  }
+}
+
+void
+VideoStreamServer::Tick (void)
+{
+  NS_LOG_FUNCTION (this << m_tick);
+
+  // scheduled first, so that clients rescheduled below see a running clock
+  m_tickEvent = Simulator::Schedule (m_interval, &VideoStreamServer::Tick, this);
+
+  std::vector<WheelEntry> bucket;
+  bucket.swap (m_wheel[m_tick % m_wheel.size ()]);
+  for (auto iter = bucket.begin (); iter != bucket.end (); iter++)
+  {
+    if (iter->m_dueTick == m_tick)
+    {
+      // entries of closed sessions are dropped here
+      m_wheelEntries--;
+      Send (iter->m_sessionId);
+    }
+    else
+    {
+      // due in a later turn of the wheel
+      m_wheel[m_tick % m_wheel.size ()].push_back (*iter);
+    }
+  }
+
+  m_tick++;
+  if (m_wheelEntries == 0)
+  {
+    Simulator::Cancel (m_tickEvent);
+  }
+}
+
+void
+VideoStreamServer::SendPaced (uint64_t sessionId)
+{
+  NS_LOG_FUNCTION (this);
+
+  ClientInfo *clientInfo = GetSession (sessionId);
+  Time delay;
+
+  if (m_pacingMode == FRAME_INTERVAL_PACING)
+  {
+    // one fragment at a time, so that the frame takes the whole interval,
+    // and all the queued fragments within one interval so that a backlog
+    // drains; a retransmission only holds the range of its frame up to
+    // m_packetCount, and is paced as its whole frame
+    QueuedFrame &frame = clientInfo->m_pacingQueue.front ();
+    SendPacket (clientInfo->m_address, frame, frame.m_nextPacket);
+    uint32_t framePackets = frame.m_retransmission ? frame.m_fragmentCount : frame.m_packetCount;
+    delay = m_interval / std::max (framePackets, clientInfo->m_queuedFragments);
+    frame.m_nextPacket++;
+    clientInfo->m_queuedFragments--;
+    if (frame.m_nextPacket == frame.m_packetCount)
+    {
+      clientInfo->m_pacingQueue.erase (clientInfo->m_pacingQueue.begin ());
+    }
+  }
+  else
+  {
+    Time now = Simulator::Now ();
+    clientInfo->m_tokens = std::min<double> (m_pacingBurst, clientInfo->m_tokens + (now - clientInfo->m_lastRefill).GetSeconds () * m_pacingRate.GetBitRate () / 8);
+    clientInfo->m_lastRefill = now;
+
+    // send as many fragments as the bucket allows, then wait for the tokens of the next one
+    while (!clientInfo->m_pacingQueue.empty ())
+    {
+      QueuedFrame &frame = clientInfo->m_pacingQueue.front ();
+      uint32_t packetSize = GetPacketSize (frame, frame.m_nextPacket);
+      // a packet larger than the bucket is sent when the bucket is full
+      if (clientInfo->m_tokens < packetSize && clientInfo->m_tokens < m_pacingBurst)
+      {
+        delay = m_pacingRate.CalculateBytesTxTime (std::ceil (std::min (packetSize, m_pacingBurst) - clientInfo->m_tokens));
+        break;
+      }
+      clientInfo->m_tokens -= SendPacket (clientInfo->m_address, frame, frame.m_nextPacket);
+      frame.m_nextPacket++;
+      clientInfo->m_queuedFragments--;
+      if (frame.m_nextPacket == frame.m_packetCount)
+      {
+        clientInfo->m_pacingQueue.erase (clientInfo->m_pacingQueue.begin ());
+      }
+    }
+  }
+
+  m_pacingQueueTrace (clientInfo->m_address, clientInfo->m_queuedFragments);
+  if (!clientInfo->m_pacingQueue.empty ())
+  {
+    clientInfo->m_pacingEvent = Simulator::Schedule (delay, &VideoStreamServer::SendPaced, this, sessionId);
+  }
+}
+
+uint32_t
+VideoStreamServer::GetFrameSize (uint32_t frameNumber, uint16_t videoLevel) const
+{
+  return m_plan->GetFrameSize (frameNumber, videoLevel);
+}
+
+uint32_t
+VideoStreamServer::GetNFrames (void) const
+{
+  return m_plan->GetNFrames ();
+}
+
+void
+VideoStreamServer::UpdatePlan (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t payloadSize = m_maxPacketSize - GetMaxHeaderSize ();
+  if (m_ladder != 0)
+  {
+    m_plan = VideoStreamFramePlan::Get (m_ladder, m_videoLength * m_frameRate, payloadSize);
+  }
+  else if (m_trace != 0 && !m_trace->IsEmpty ())
+  {
+    // a single column is scaled to every level a client may ask for
+    uint16_t nLevels = m_trace->GetNLevels () == 1 ? MAX_VIDEO_LEVEL : m_trace->GetNLevels ();
+    m_plan = VideoStreamFramePlan::Get (m_trace, nLevels, payloadSize);
+  }
+  else
+  {
+    // If the frame sizes are not from the text file, and the list is empty
+    std::vector<uint32_t> levelSizes (m_frameSizes + 1, m_frameSizes + sizeof (m_frameSizes) / sizeof (m_frameSizes[0]));
+    m_plan = VideoStreamFramePlan::Create (levelSizes, m_videoLength * m_frameRate, payloadSize);
+  }
+
+  m_levelBitrates.clear ();
+  for (uint16_t level = 1; level <= m_plan->GetNLevels (); level++)
+  {
+    uint32_t nFrames = std::max<uint32_t> (m_plan->GetNFrames (), 1);
+    m_levelBitrates.push_back (m_ladder != 0 ? m_ladder->GetBitrate (level)
+                               : m_plan->GetRangeSize (0, m_plan->GetNFrames (), level) * 8.0 * m_frameRate / nFrames);
+  }
+}
+
+uint32_t
+VideoStreamServer::GetMaxHeaderSize (void) const
+{
+  // the parity packets have the longest header, and must fit as well
+  VideoStreamHeader header;
+  if (m_fecGroupSize > 0)
+  {
+    header.SetMessageType (VideoStreamHeader::VIDEO_PARITY);
+  }
+  return header.GetSerializedSize ();
+}
+
+double
+VideoStreamServer::GetLevelBitrate (uint16_t videoLevel) const
+{
+  NS_ASSERT (videoLevel > 0 && !m_levelBitrates.empty ());
+  return m_levelBitrates[std::min<size_t> (videoLevel, m_levelBitrates.size ()) - 1];
+}
+
+VideoStreamServer::QueuedFrame
+VideoStreamServer::MakeFrame (uint32_t frameNumber, uint16_t videoLevel) const
+{
+  // the frame might require several packets to send, each starting with a header
+  QueuedFrame frame;
+  frame.m_frameNumber = frameNumber;
+  frame.m_frameSize = m_plan->GetFrameSize (frameNumber, videoLevel);
+  frame.m_videoLevel = videoLevel;
+  frame.m_frameType = m_plan->GetFrameType (frameNumber);
+  frame.m_fragmentCount = m_plan->GetFragmentCount (frameNumber, videoLevel);
+  // one parity packet follows each group of fragments
+  uint32_t packetCount = frame.m_fragmentCount;
+  if (m_fecGroupSize > 0)
+  {
+    packetCount += (frame.m_fragmentCount + m_fecGroupSize - 1) / m_fecGroupSize;
+  }
+  NS_ABORT_MSG_IF (packetCount > UINT16_MAX, "Frame " << frameNumber << " needs too many packets: " << packetCount);
+  frame.m_packetCount = packetCount;
+  frame.m_nextPacket = 0;
+  frame.m_retransmission = false;
+  return frame;
+}
+
+uint16_t
+VideoStreamServer::LocatePacket (const QueuedFrame &frame, uint16_t packetIndex, uint16_t &fragmentIndex) const
+{
+  if (m_fecGroupSize == 0 || frame.m_retransmission)
+  {
+    fragmentIndex = packetIndex;
+    return 0;
+  }
+  // group g takes the packets from g * (size + 1), its fragments then its parity
+  uint32_t group = packetIndex / (m_fecGroupSize + 1);
+  uint32_t offset = packetIndex % (m_fecGroupSize + 1);
+  uint32_t first = group * m_fecGroupSize;
+  uint16_t groupSize = std::min<uint32_t> (m_fecGroupSize, frame.m_fragmentCount - first);
+  if (offset < groupSize)
+  {
+    fragmentIndex = first + offset;
+    return 0;
+  }
+  fragmentIndex = first;
+  return groupSize;
+}
+
+uint32_t
+VideoStreamServer::GetPacketSize (const QueuedFrame &frame, uint16_t packetIndex) const
+{
+  uint16_t fragmentIndex;
+  VideoStreamHeader header;
+  if (LocatePacket (frame, packetIndex, fragmentIndex) > 0)
+  {
+    header.SetMessageType (VideoStreamHeader::VIDEO_PARITY);
+  }
+  // the parity is as long as the first fragment of its group, the longest one
+  return header.GetSerializedSize () + m_plan->GetFragmentSize (frame.m_frameNumber, frame.m_videoLevel, fragmentIndex);
+}
+
+uint32_t
+VideoStreamServer::SendPacket (const Address &address, const QueuedFrame &frame, uint16_t packetIndex)
+{
+  return SendTo (address, MakePacket (frame, packetIndex));
+}
+
+Ptr<Packet>
+VideoStreamServer::MakePacket (const QueuedFrame &frame, uint16_t packetIndex)
 {
-  uint8_t dataBuffer[packetSize];
-  sprintf ((char *) dataBuffer, "%u", client->m_sent);
-  Ptr<Packet> p = Create<Packet> (dataBuffer, packetSize);
-  if (m_socket->SendTo (p, 0, client->m_address) < 0)
+  // the packets only differ by their frame, level and index at a given time
+  uint64_t key = ((uint64_t) frame.m_frameNumber << 32) | ((uint64_t) frame.m_videoLevel << 16) | packetIndex;
+  // a retransmission goes to a single client, and its indices are not the ones of the frame
+  bool cacheable = m_packetCacheEnabled && !frame.m_retransmission;
+  if (cacheable)
   {
-    NS_LOG_INFO ("Error while sending " << packetSize << "bytes to " << InetSocketAddress::ConvertFrom (client->m_address).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (client->m_address).GetPort ());
+    if (m_packetCacheTime != Simulator::Now ())
+    {
+      m_packetCache.clear ();
+      m_packetCacheTime = Simulator::Now ();
+    }
+    auto cached = m_packetCache.find (key);
+    if (cached != m_packetCache.end ())
+    {
+      // the copy shares the buffer of the cached packet until it is written to
+      return cached->second->Copy ();
+    }
+  }
+
+  uint16_t fragmentIndex;
+  uint16_t groupSize = LocatePacket (frame, packetIndex, fragmentIndex);
+  uint32_t payloadSize = m_plan->GetFragmentSize (frame.m_frameNumber, frame.m_videoLevel, fragmentIndex);
+  VideoStreamHeader header;
+  if (groupSize > 0)
+  {
+    uint16_t lengthRecovery = 0;
+    for (uint16_t i = fragmentIndex; i < fragmentIndex + groupSize; i++)
+    {
+      lengthRecovery ^= m_plan->GetFragmentSize (frame.m_frameNumber, frame.m_videoLevel, i);
+    }
+    header.SetMessageType (VideoStreamHeader::VIDEO_PARITY);
+    header.SetGroupSize (groupSize);
+    header.SetLengthRecovery (lengthRecovery);
+  }
+  header.SetFrameNumber (frame.m_frameNumber);
+  header.SetFragmentIndex (fragmentIndex);
+  header.SetFragmentCount (frame.m_fragmentCount);
+  header.SetPayloadSize (payloadSize);
+  header.SetVideoLevel (frame.m_videoLevel);
+  header.SetTimestamp (Simulator::Now ());
+
+  // the payload is zero-filled and does not allocate any buffer
+  Ptr<Packet> p = Create<Packet> (payloadSize);
+  p->AddHeader (header);
+  if (!cacheable)
+  {
+    return p;
+  }
+  m_packetCache[key] = p;
+  return p->Copy ();
+}
+
+uint32_t
+VideoStreamServer::SendTo (const Address &address, Ptr<Packet> p)
+{
+  uint32_t size = p->GetSize ();
+  Ptr<Socket> socket = Inet6SocketAddress::IsMatchingType (address) ? m_socket6 : m_socket;
+  if (socket->SendTo (p, 0, address) < 0)
+  {
+    NS_LOG_INFO ("Error while sending " << size << "bytes to " << FormatAddress (address));
+  }
+  return size;
+}
+
+Address
+VideoStreamServer::GetGroupAddress (uint16_t videoLevel) const
+{
+  return InetSocketAddress (Ipv4Address (m_multicastGroup.Get () + videoLevel - 1), m_multicastPort);
+}
+
+void
+VideoStreamServer::Subscribe (uint16_t videoLevel)
+{
+  NS_LOG_FUNCTION (this << videoLevel);
+
+  if (videoLevel >= m_groupSubscribers.size ())
+  {
+    m_groupSubscribers.resize (videoLevel + 1, 0);
+  }
+  m_groupSubscribers[videoLevel]++;
+  // the groups share one frame clock, which runs as long as anyone watches
+  if (!m_groupEvent.IsRunning () && m_groupFrame < GetNFrames ())
+  {
+    m_groupEvent = Simulator::ScheduleNow (&VideoStreamServer::SendGroups, this);
+  }
+}
+
+void
+VideoStreamServer::Unsubscribe (uint16_t videoLevel)
+{
+  NS_LOG_FUNCTION (this << videoLevel);
+
+  if (videoLevel < m_groupSubscribers.size () && m_groupSubscribers[videoLevel] > 0)
+  {
+    m_groupSubscribers[videoLevel]--;
+  }
+}
+
+void
+VideoStreamServer::SendGroups (void)
+{
+  NS_LOG_FUNCTION (this << m_groupFrame);
+
+  bool watched = false;
+  for (uint16_t videoLevel = 1; videoLevel < m_groupSubscribers.size (); videoLevel++)
+  {
+    if (m_groupSubscribers[videoLevel] == 0)
+    {
+      continue;
+    }
+    watched = true;
+    // the same packets reach all the clients of the level
+    QueuedFrame frame = MakeFrame (m_groupFrame, videoLevel);
+    Address group = GetGroupAddress (videoLevel);
+    for (uint32_t i = 0; i < frame.m_packetCount; i++)
+    {
+      SendPacket (group, frame, i);
+    }
+    m_frameSentTrace (group, m_groupFrame, frame.m_frameSize, videoLevel);
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server sent frame " << m_groupFrame << " and " << frame.m_frameSize << " bytes to " << FormatAddress (group));
+  }
+
+  // the clock stops when nobody watches, and goes on from the same frame
+  if (!watched)
+  {
+    return;
+  }
+  m_groupFrame++;
+  if (m_groupFrame < GetNFrames ())
+  {
+    m_groupEvent = Simulator::Schedule (m_interval, &VideoStreamServer::SendGroups, this);
   }
 }
 
@@ -223,35 +1110,334 @@ VideoStreamServer::HandleRead (Ptr<Socket> socket)
   while ((packet = socket->RecvFrom (from)))
   {
     socket->GetSockName (localAddress);
-    if (InetSocketAddress::IsMatchingType (from))
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server received " << packet->GetSize () << " bytes from " << FormatAddress (from));
+
+    if (!m_tcp)
+    {
+      // a datagram holds a single message, anything else is dropped
+      uint32_t messageSize = VideoStreamControlHeader::PeekMessageSize (packet);
+      if (messageSize == 0 || packet->GetSize () < messageSize)
+      {
+        NS_LOG_WARN ("At time " << Simulator::Now ().GetSeconds () << "s server dropped a malformed datagram of " << packet->GetSize () << " bytes from " << FormatAddress (from));
+        continue;
+      }
+      VideoStreamControlHeader header;
+      packet->RemoveHeader (header);
+      HandleControl (socket, header, from);
+      continue;
+    }
+
+    // the byte stream may split or merge the control messages
+    Ptr<Packet> &buffer = m_receiveBuffers[socket];
+    if (buffer == 0)
+    {
+      buffer = packet;
+    }
+    else
     {
-      NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server received " << packet->GetSize () << " bytes from " << InetSocketAddress::ConvertFrom (from).GetIpv4 () << " port " << InetSocketAddress::ConvertFrom (from).GetPort ());
+      buffer->AddAtEnd (packet);
+    }
+    while (buffer->GetSize () > 0)
+    {
+      uint32_t messageSize = VideoStreamControlHeader::PeekMessageSize (buffer);
+      if (messageSize == 0)
+      {
+        // the stream can not be framed past an unknown message
+        NS_LOG_WARN ("At time " << Simulator::Now ().GetSeconds () << "s server dropped " << buffer->GetSize () << " bytes of an unknown message from " << FormatAddress (from));
+        buffer = 0;
+        break;
+      }
+      if (buffer->GetSize () < messageSize)
+      {
+        break;
+      }
+      VideoStreamControlHeader header;
+      buffer->RemoveHeader (header);
+      HandleControl (socket, header, from);
+    }
+  }
+}
 
-      uint32_t ipAddr = InetSocketAddress::ConvertFrom (from).GetIpv4 ().Get ();
+void
+VideoStreamServer::HandleControl (Ptr<Socket> socket, const VideoStreamControlHeader &header, const Address &from)
+{
+  // the level comes from the network, and indexes the tables of the plan
+  uint16_t videoLevel = std::min<uint16_t> (std::max<uint16_t> (header.GetVideoLevel (), 1), m_plan->GetNLevels ());
 
-      // the first time we received the message from the client
-      if (m_clients.find (ipAddr) == m_clients.end ())
+  auto iter = m_clients.find (from);
+  if (iter == m_clients.end ())
+  {
+    // the first time we received the message from the client
+    if (header.GetMessageType () != VideoStreamHeader::CLIENT_HELLO
+        && header.GetMessageType () != VideoStreamHeader::CLIENT_SEGMENT)
+    {
+      return;
+    }
+    uint64_t sessionId = OpenSession (from);
+    ClientInfo *clientInfo = GetSession (sessionId);
+    clientInfo->m_videoLevel = videoLevel;
+    if (m_tcp)
+    {
+      clientInfo->m_socket = socket;
+    }
+    if (header.GetMessageType () == VideoStreamHeader::CLIENT_SEGMENT)
+    {
+      // the client pulls its frames, nothing is pushed to it
+      clientInfo->m_pull = true;
+      SendSegment (sessionId, header.GetFirstFrame (), header.GetFrameCount ());
+    }
+    else if (m_multicastGroup.IsMulticast ())
+    {
+      // the client joins the group of its level, no frame is sent to it alone
+      Subscribe (videoLevel);
+    }
+    else
+    {
+      ScheduleSend (sessionId, Seconds (0.0));
+    }
+    return;
+  }
+
+  ClientInfo *clientInfo = &m_sessions[iter->second];
+  uint64_t sessionId = ((uint64_t) clientInfo->m_generation << 32) | iter->second;
+  clientInfo->m_lastActivity = Simulator::Now ();
+  switch (header.GetMessageType ())
+  {
+    case VideoStreamHeader::CLIENT_LEVEL:
+      NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server received video level " << videoLevel);
+      // a pull client is not in the group of its level
+      if (m_multicastGroup.IsMulticast () && !clientInfo->m_pull)
       {
-        ClientInfo *newClient = new ClientInfo();
-        newClient->m_sent = 0;
-        newClient->m_videoLevel = 3;
-        newClient->m_address = from;
-        // newClient->m_sendEvent = EventId ();
-        m_clients[ipAddr] = newClient;
-        newClient->m_sendEvent = Simulator::Schedule (Seconds (0.0), &VideoStreamServer::Send, this, ipAddr);
+        Unsubscribe (clientInfo->m_videoLevel);
+        Subscribe (videoLevel);
       }
-      else
+      clientInfo->m_videoLevel = videoLevel;
+      break;
+    case VideoStreamHeader::CLIENT_SEGMENT:
+      clientInfo->m_videoLevel = videoLevel;
+      SendSegment (sessionId, header.GetFirstFrame (), header.GetFrameCount ());
+      break;
+    case VideoStreamHeader::CLIENT_REPORT:
+      HandleReport (sessionId, header);
+      break;
+    case VideoStreamHeader::CLIENT_NACK:
+      HandleNack (sessionId, header);
+      break;
+    case VideoStreamHeader::CLIENT_TEARDOWN:
+      CloseSession (sessionId);
+      break;
+    case VideoStreamHeader::CLIENT_PING:
       {
-        uint8_t dataBuffer[10];
-        packet->CopyData (dataBuffer, 10);
+        // echo the timestamp of the ping for the client to get the round-trip time
+        VideoStreamControlHeader pong;
+        pong.SetMessageType (VideoStreamHeader::SERVER_PONG);
+        pong.SetVideoLevel (clientInfo->m_videoLevel);
+        pong.SetTimestamp (header.GetTimestamp ());
+        Ptr<Packet> reply = Create<Packet> ();
+        reply->AddHeader (pong);
+        socket->SendTo (reply, 0, from);
+        break;
+      }
+    default:
+      break;
+  }
+}
+
+void
+VideoStreamServer::HandleReport (uint64_t sessionId, const VideoStreamControlHeader &header)
+{
+  NS_LOG_FUNCTION (this << sessionId);
+
+  ClientInfo *clientInfo = GetSession (sessionId);
+  NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server got a report of " << header.GetFractionLost () << " lost, "
+                << header.GetReceivedBytes () << " bytes, " << header.GetJitter ().GetSeconds () << "s jitter and "
+                << header.GetBufferLevel ().GetSeconds () << "s buffered from " << FormatAddress (clientInfo->m_address));
+  m_receiverReportTrace (clientInfo->m_address, header.GetFractionLost (), header.GetReceivedBytes (), header.GetJitter (), header.GetBufferLevel ());
+  if (m_rateControl == NO_RATE_CONTROL || m_multicastGroup.IsMulticast ())
+  {
+    // the groups carry every level whatever the loss of a single client
+    return;
+  }
+
+  // start from the level being sent, the first report tells how it goes
+  double maxRate = m_levelBitrates.back ();
+  if (clientInfo->m_targetRate == 0)
+  {
+    clientInfo->m_targetRate = GetLevelBitrate (std::min (clientInfo->m_videoLevel, clientInfo->m_levelCap));
+  }
+  if (header.GetFractionLost () > m_lossThreshold)
+  {
+    clientInfo->m_targetRate *= m_rateDecrease;
+  }
+  else
+  {
+    clientInfo->m_targetRate = std::min (maxRate, clientInfo->m_targetRate + m_rateIncrease.GetBitRate ());
+  }
+
+  uint16_t levelCap = 1;
+  while (levelCap < m_levelBitrates.size () && m_levelBitrates[levelCap] <= clientInfo->m_targetRate)
+  {
+    levelCap++;
+  }
+  if (levelCap != clientInfo->m_levelCap)
+  {
+    NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server caps " << FormatAddress (clientInfo->m_address)
+                 << " at level " << levelCap << " for a target rate of " << clientInfo->m_targetRate << " bit/s");
+  }
+  clientInfo->m_levelCap = levelCap;
+  m_sessionRateTrace (clientInfo->m_address, clientInfo->m_targetRate, levelCap);
+}
+
+void
+VideoStreamServer::HandleNack (uint64_t sessionId, const VideoStreamControlHeader &header)
+{
+  NS_LOG_FUNCTION (this << sessionId << header.GetFirstFrame ());
+
+  ClientInfo *clientInfo = GetSession (sessionId);
+  uint32_t frameNumber = header.GetFirstFrame ();
+  auto iter = clientInfo->m_sentFrames.rbegin ();
+  while (iter != clientInfo->m_sentFrames.rend () && iter->m_frameNumber != frameNumber)
+  {
+    iter++;
+  }
+  if (iter == clientInfo->m_sentFrames.rend ())
+  {
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server ignored a NACK of frame " << frameNumber << " out of the window of " << FormatAddress (clientInfo->m_address));
+    return;
+  }
 
-        uint16_t videoLevel;
-        sscanf((char *) dataBuffer, "%hu", &videoLevel);
-        NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server received video level " << videoLevel);
-        m_clients.at (ipAddr)->m_videoLevel = videoLevel;
+  // the fragments take as long to reach the client as the NACK took to come
+  Time oneWay = Simulator::Now () - header.GetTimestamp ();
+  Time deadline = header.GetTimestamp () + header.GetBufferLevel ();
+  if (Simulator::Now () + oneWay >= deadline)
+  {
+    NS_LOG_LOGIC ("At time " << Simulator::Now ().GetSeconds () << "s server dropped a NACK of frame " << frameNumber << " past its playout deadline");
+    return;
+  }
+
+  QueuedFrame frame = *iter;
+  frame.m_retransmission = true;
+  uint16_t resent = 0;
+  const std::vector<std::pair<uint16_t, uint16_t> > &ranges = header.GetNackRanges ();
+  for (auto range = ranges.begin (); range != ranges.end (); range++)
+  {
+    uint32_t end = std::min<uint32_t> ((uint32_t) range->first + range->second, frame.m_fragmentCount);
+    if (range->first >= end)
+    {
+      continue;
+    }
+    resent += end - range->first;
+    if (m_pacingMode == NO_PACING)
+    {
+      for (uint32_t index = range->first; index < end; index++)
+      {
+        SendPacket (clientInfo->m_address, frame, index);
       }
+      continue;
+    }
+
+    // a paced session is congested, so the fragments go through the pacer,
+    // right behind the frame it is sending since they are already late
+    frame.m_nextPacket = range->first;
+    frame.m_packetCount = end;
+    auto position = clientInfo->m_pacingQueue.begin ();
+    if (position != clientInfo->m_pacingQueue.end ())
+    {
+      position++;
     }
+    clientInfo->m_pacingQueue.insert (position, frame);
+    clientInfo->m_queuedFragments += end - range->first;
+  }
+  if (m_pacingMode != NO_PACING && resent > 0)
+  {
+    m_pacingQueueTrace (clientInfo->m_address, clientInfo->m_queuedFragments);
+    if (!clientInfo->m_pacingEvent.IsRunning ())
+    {
+      SendPaced (sessionId);
+    }
+  }
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server sent " << resent << " fragments of frame " << frameNumber << " again to " << FormatAddress (clientInfo->m_address));
+  m_retransmissionTrace (clientInfo->m_address, frameNumber, resent);
+}
+
+void
+VideoStreamServer::HandleAccept (Ptr<Socket> socket, const Address &from)
+{
+  NS_LOG_FUNCTION (this << socket << from);
+  NS_LOG_INFO ("At time " << Simulator::Now ().GetSeconds () << "s server accepted a connection from " << FormatAddress (from));
+  socket->SetRecvCallback (MakeCallback (&VideoStreamServer::HandleRead, this));
+  socket->SetSendCallback (MakeCallback (&VideoStreamServer::HandleSendSpace, this));
+  socket->SetCloseCallbacks (MakeCallback (&VideoStreamServer::HandlePeerClose, this),
+                             MakeCallback (&VideoStreamServer::HandlePeerClose, this));
+}
+
+void
+VideoStreamServer::HandlePeerClose (Ptr<Socket> socket)
+{
+  NS_LOG_FUNCTION (this << socket);
+
+  m_receiveBuffers.erase (socket);
+  Address peer;
+  if (socket->GetPeerName (peer) != 0)
+  {
+    // the session is left to the idle timeout
+    return;
+  }
+  auto iter = m_clients.find (peer);
+  if (iter != m_clients.end () && m_sessions[iter->second].m_socket == socket)
+  {
+    CloseSession (((uint64_t) m_sessions[iter->second].m_generation << 32) | iter->second);
+  }
+}
+
+void
+VideoStreamServer::HandleSendSpace (Ptr<Socket> socket, uint32_t available)
+{
+  Address peer;
+  if (socket->GetPeerName (peer) != 0)
+  {
+    return;
+  }
+  auto iter = m_clients.find (peer);
+  if (iter != m_clients.end () && m_sessions[iter->second].m_socket == socket)
+  {
+    SendStream (((uint64_t) m_sessions[iter->second].m_generation << 32) | iter->second);
+  }
+}
+
+void
+VideoStreamServer::SendStream (uint64_t sessionId)
+{
+  ClientInfo *clientInfo = GetSession (sessionId);
+  if (clientInfo == 0 || clientInfo->m_pacingQueue.empty ())
+  {
+    return;
+  }
+
+  while (!clientInfo->m_pacingQueue.empty ())
+  {
+    // a fragment is only written whole, so that its header starts the next record of the stream
+    QueuedFrame &frame = clientInfo->m_pacingQueue.front ();
+    uint32_t packetSize = GetPacketSize (frame, frame.m_nextPacket);
+    if (clientInfo->m_socket->GetTxAvailable () < packetSize)
+    {
+      break;
+    }
+    clientInfo->m_socket->Send (MakePacket (frame, frame.m_nextPacket));
+    frame.m_nextPacket++;
+    clientInfo->m_queuedFragments--;
+    if (frame.m_nextPacket == frame.m_packetCount)
+    {
+      clientInfo->m_pacingQueue.erase (clientInfo->m_pacingQueue.begin ());
+    }
+  }
+  m_pacingQueueTrace (clientInfo->m_address, clientInfo->m_queuedFragments);
+
+  if (clientInfo->m_stalled && clientInfo->m_pacingQueue.size () < m_pacingQueueLimit)
+  {
+    clientInfo->m_stalled = false;
+    ScheduleSend (sessionId, Seconds (0.0));
   }
 }
 
-} // namespace ns3
\ No newline at end of file
+} // namespace ns3
@@ -8,17 +8,67 @@
 #include "ns3/ptr.h"
 #include "ns3/string.h"
 #include "ns3/ipv4-address.h"
+#include "ns3/address.h"
+#include "ns3/nstime.h"
 #include "ns3/traced-callback.h"
+#include "ns3/data-rate.h"
+#include "ns3/type-id.h"
+#include "ns3/video-stream-frame-plan.h"
+#include "ns3/video-stream-ladder.h"
+#include "ns3/video-stream-trace.h"
 
+#include <deque>
 #include <fstream>
+#include <map>
 #include <unordered_map>
+#include <vector>
 namespace ns3 {
 
 class Socket;
 class Packet;
+class VideoStreamControlHeader;
 
   /**
    * @brief A Video Stream Server
+   *
+   * By default every client gets its own stream. With a multicast group
+   * set, the server sends each frame once per video level instead, to the
+   * group of the level: the first group for level 1, the next address for
+   * level 2, and so on. The clients follow the group of their level, and
+   * the server only sends the levels with at least one client, all on the
+   * same frame clock so that the frame numbers go on when a client switches
+   * levels. The sessions then only track the level and the activity of the
+   * clients.
+   *
+   * Over TCP, each client connects to the server and every fragment is
+   * written whole into the connection, its header giving the size of its
+   * payload so that the client can cut the byte stream back into fragments.
+   * The fragments wait in the queue of the session until the send buffer of
+   * the connection has room for them, so a slow path holds the frames back
+   * at the server instead of dropping them in the network. A TCP session is
+   * not bound by PacingQueueLimit: once that many frames wait, its frame
+   * clock stops, and the connection draining its queue starts it again, so
+   * that no frame is dropped and the later ones go out late.
+   *
+   * The clients send receiver reports with the fraction of fragments they
+   * lost, the bytes they received, the interarrival jitter and their buffer
+   * level. With AIMD rate control, the server keeps a target rate per
+   * session, cuts it by a factor when a report shows more loss than the
+   * threshold and raises it by a step otherwise, and sends each client at
+   * most the highest level whose bitrate fits in its target rate, whatever
+   * level the client asks for.
+   *
+   * With forward error correction, the fragments of each frame are cut in
+   * groups of FecGroupSize, and each group is followed by a parity packet,
+   * the XOR of its fragments, from which the client rebuilds any single
+   * fragment lost in the group.
+   *
+   * The server also keeps the last RetransmissionWindow frames sent to each
+   * client. When a client NACKs missing fragments of one of them, the
+   * server sends them again, unless they would arrive after the frame is
+   * played: at once without pacing, through the pacer of the client right
+   * behind the frame being sent otherwise. The frames dropped from a full
+   * pacing queue and those sent to the multicast groups are not kept.
    */
   class VideoStreamServer : public Application
   {
@@ -48,6 +98,20 @@ class Packet;
      */
     std::string GetFrameFile (void) const;
 
+    /**
+     * @brief Set the name of the file defining the representation ladder.
+     * 
+     * @param ladderFile the file name
+     */
+    void SetLadderFile (std::string ladderFile);
+
+    /**
+     * @brief Get the name of the file defining the representation ladder.
+     * 
+     * @return the file name 
+     */
+    std::string GetLadderFile (void) const;
+
     /**
      * @brief Set the maximum packet size.
      * 
@@ -62,38 +126,399 @@ class Packet;
      */
     uint32_t GetMaxPacketSize (void) const;
 
+    /**
+     * @brief Get the number of open client sessions.
+     * 
+     * @return the number of sessions
+     */
+    uint32_t GetNSessions (void) const;
+
+    /**
+     * @brief How the fragments of a frame are spread in time.
+     */
+    enum PacingMode
+    {
+      NO_PACING, //!< Send all the fragments of a frame at once
+      FRAME_INTERVAL_PACING, //!< Spread the queued fragments evenly over the next frame interval
+      TOKEN_BUCKET_PACING //!< Send the fragments at the pacing rate, with bursts up to the bucket size
+    };
+
+    /**
+     * @brief How the server reacts to the receiver reports of a session.
+     */
+    enum RateControl
+    {
+      NO_RATE_CONTROL, //!< Send the level asked by the client
+      AIMD_RATE_CONTROL //!< Cap the level by a target rate with additive increase and multiplicative decrease
+    };
+
+    /**
+     * @brief Which frames the server drops when the pacing queue of a
+     * session is full.
+     */
+    enum DropPolicy
+    {
+      DROP_OLDEST, //!< Drop the oldest queued frame
+      DROP_BY_FRAME_TYPE //!< Drop the B frames first, then the P frames closing their group of pictures, then the oldest I frame
+    };
+
+    /**
+     * TracedCallback signature for the pacing queue of a client.
+     *
+     * @param [in] address the address of the client
+     * @param [in] queuedFragments the number of fragments waiting to be sent
+     */
+    typedef void (* PacingQueueTracedCallback) (const Address &address, uint32_t queuedFragments);
+
+    /**
+     * TracedCallback signature for a frame sent to a client.
+     *
+     * @param [in] address the address of the client
+     * @param [in] frameNumber the frame number
+     * @param [in] bytes the size of the frame in bytes
+     * @param [in] videoLevel the video level of the frame
+     */
+    typedef void (* FrameSentTracedCallback) (const Address &address, uint32_t frameNumber, uint32_t bytes, uint16_t videoLevel);
+
+    /**
+     * TracedCallback signature for a receiver report of a client.
+     *
+     * @param [in] address the address of the client
+     * @param [in] fractionLost the fraction of the fragments lost since the last report
+     * @param [in] receivedBytes the number of bytes received since the last report
+     * @param [in] jitter the interarrival jitter
+     * @param [in] bufferLevel the playback time in the buffer of the client
+     */
+    typedef void (* ReceiverReportTracedCallback) (const Address &address, double fractionLost, uint32_t receivedBytes, Time jitter, Time bufferLevel);
+
+    /**
+     * TracedCallback signature for the rate control of a session.
+     *
+     * @param [in] address the address of the client
+     * @param [in] targetRate the target rate in bit/s
+     * @param [in] levelCap the highest video level sent to the client
+     */
+    typedef void (* SessionRateTracedCallback) (const Address &address, double targetRate, uint16_t levelCap);
+
+    /**
+     * TracedCallback signature for the fragments sent again on a NACK.
+     *
+     * @param [in] address the address of the client
+     * @param [in] frameNumber the frame number
+     * @param [in] fragments the number of fragments sent again
+     */
+    typedef void (* RetransmissionTracedCallback) (const Address &address, uint32_t frameNumber, uint16_t fragments);
+
+    /**
+     * TracedCallback signature for a frame dropped for a client.
+     *
+     * @param [in] address the address of the client
+     * @param [in] frameNumber the frame number
+     * @param [in] frameType the type of the frame
+     */
+    typedef void (* FrameDroppedTracedCallback) (const Address &address, uint32_t frameNumber, VideoStreamTrace::FrameType frameType);
+
   protected:
     virtual void DoDispose (void);
 
   private:
+    friend class VideoStreamServerNackTestCase;
+    friend class VideoStreamServerDropTestCase;
 
     virtual void StartApplication (void);
     virtual void StopApplication (void);
 
+    /**
+     * @brief A frame whose fragments are waiting to be sent.
+     */
+    typedef struct QueuedFrame
+    {
+      uint32_t m_frameNumber; //!< Frame number
+      uint32_t m_frameSize; //!< Size of the frame in bytes
+      uint16_t m_videoLevel; //!< Video level the frame is sent at
+      VideoStreamTrace::FrameType m_frameType; //!< Type of the frame
+      uint16_t m_fragmentCount; //!< Number of fragments of the frame
+      uint16_t m_packetCount; //!< Number of packets of the frame, fragments and parity packets
+      uint16_t m_nextPacket; //!< Index of the next packet to send
+      bool m_retransmission; //!< Whether the packets are fragments sent again, indexed by fragment without parity
+    } QueuedFrame;
+
     /**
      * @brief The information required for each client.
+     * 
+     * Sessions live in the slots of the session table and are referred to
+     * by a session id, made of the slot index in the low 32 bits and the
+     * generation of the slot in the high 32 bits. The generation changes
+     * whenever the slot is released, so the ids of closed sessions held by
+     * pending events no longer match.
      */
     typedef struct ClientInfo
     {
       Address m_address; //!< Address
       uint32_t m_sent; //!< Counter for sent frames
       uint16_t m_videoLevel; //! Video level
+      bool m_active; //!< Whether the slot holds an open session
+      bool m_pull; //!< Whether the client requests segments instead of getting frames pushed
+      uint32_t m_generation; //!< Generation of the slot
+      Time m_lastActivity; //!< Last time a message was received from the client
       EventId m_sendEvent; //! Send event used by the client
+      std::vector<QueuedFrame> m_pacingQueue; //!< Frames waiting for paced transmission or room in the TCP send buffer, oldest first
+      uint32_t m_queuedFragments; //!< Number of packets in the pacing queue, fragments and parity packets
+      bool m_awaitKeyFrame; //!< Whether the frames are dropped until the next I frame, a reference frame of the group of pictures being dropped
+      bool m_stalled; //!< Whether the frame clock of a TCP session waits for its full queue to drain
+      EventId m_pacingEvent; //!< Event to send the next paced fragment
+      double m_tokens; //!< Bytes available in the token bucket
+      Time m_lastRefill; //!< Last time the token bucket was refilled
+      Ptr<Socket> m_socket; //!< Connection of a TCP client (0 over UDP)
+      double m_targetRate; //!< Target rate of the rate control in bit/s (0 before the first report)
+      uint16_t m_levelCap; //!< Highest video level sent to the client
+      std::deque<QueuedFrame> m_sentFrames; //!< Last frames sent, oldest first, for the retransmissions
     } ClientInfo; //! To be compatible with C language
 
     /**
-     * @brief Send a packet with specified size.
+     * @brief Hash of a socket address, to index the session table.
+     */
+    struct AddressHash
+    {
+      /**
+       * @brief Hash the serialized bytes of an address.
+       * 
+       * @param address the address
+       * @return the hash
+       */
+      size_t operator() (const Address &address) const;
+    };
+
+    /**
+     * @brief Open a session for a new client.
+     * 
+     * @param address the socket address of the client
+     * @return the session id
+     */
+    uint64_t OpenSession (const Address &address);
+
+    /**
+     * @brief Close a session and release its slot.
+     * 
+     * @param sessionId the session id
+     */
+    void CloseSession (uint64_t sessionId);
+
+    /**
+     * @brief Get an open session.
+     * 
+     * @param sessionId the session id
+     * @return the session, or 0 if it was closed
+     */
+    ClientInfo *GetSession (uint64_t sessionId);
+
+    /**
+     * @brief Close the sessions whose client sent no message for the
+     * session timeout, and schedule the next check.
+     */
+    void EvictIdleSessions (void);
+
+    /**
+     * @brief Get the size of a frame.
+     * 
+     * @param frameNumber the frame number
+     * @param videoLevel the video level
+     * @return the size of the frame in bytes
+     */
+    uint32_t GetFrameSize (uint32_t frameNumber, uint16_t videoLevel) const;
+
+    /**
+     * @brief Get the number of frames of the video.
+     * 
+     * @return the number of frames
+     */
+    uint32_t GetNFrames (void) const;
+
+    /**
+     * @brief Build the frame plan of the video from the ladder, the trace
+     * or the default frame sizes.
+     */
+    void UpdatePlan (void);
+
+    /**
+     * @brief Get the bitrate of a video level, from the ladder if set, from
+     * the mean frame size of the level otherwise.
+     * 
+     * @param videoLevel the video level
+     * @return the bitrate in bit/s
+     */
+    double GetLevelBitrate (uint16_t videoLevel) const;
+
+    /**
+     * @brief Get the size of the longest header of the packets sent.
+     * 
+     * @return the size of the header of the parity packets with forward
+     * error correction, of the fragments otherwise
+     */
+    uint32_t GetMaxHeaderSize (void) const;
+
+    /**
+     * @brief Describe a frame to be sent.
+     * 
+     * @param frameNumber the frame number
+     * @param videoLevel the video level
+     * @return the frame, none of its fragments sent yet
+     */
+    QueuedFrame MakeFrame (uint32_t frameNumber, uint16_t videoLevel) const;
+
+    /**
+     * @brief Drop queued frames of a client until its pacing queue has room
+     * for one more frame, according to the drop policy.
+     *
+     * The frame at the front of the queue is never dropped once some of its
+     * fragments were sent.
+     * 
+     * @param clientInfo the client
+     * @param frame the frame about to be queued
+     * @return false if the frame itself is the one to drop
+     */
+    bool MakeRoom (ClientInfo *clientInfo, const QueuedFrame &frame);
+
+    /**
+     * @brief Drop a frame of the pacing queue of a client.
      * 
-     * @param packetSize the number of bytes for the packet to be sent
+     * @param clientInfo the client
+     * @param index the index of the frame in the queue
      */
-    void SendPacket (ClientInfo *client, uint32_t packetSize);
+    void DropQueuedFrame (ClientInfo *clientInfo, uint32_t index);
+
+    /**
+     * @brief Find what a packet of a frame carries.
+     * 
+     * @param frame the frame
+     * @param packetIndex the index of the packet in the frame
+     * @param [out] fragmentIndex the fragment carried by the packet, or the
+     * first fragment protected by the parity packet
+     * @return the number of fragments protected by the parity packet, 0 if
+     * the packet is a fragment
+     */
+    uint16_t LocatePacket (const QueuedFrame &frame, uint16_t packetIndex, uint16_t &fragmentIndex) const;
+
+    /**
+     * @brief Get the size of a packet of a frame.
+     * 
+     * @param frame the frame
+     * @param packetIndex the index of the packet in the frame
+     * @return the size of the packet, header included
+     */
+    uint32_t GetPacketSize (const QueuedFrame &frame, uint16_t packetIndex) const;
+
+    /**
+     * @brief Send one fragment or parity packet of a frame.
+     * 
+     * With the packet cache, the packets built at the current time are
+     * kept, and the clients at the same frame and level get copies of the
+     * same packet, which share its buffer.
+     * 
+     * @param address the address of the client or of the multicast group
+     * @param frame the frame the packet belongs to
+     * @param packetIndex the index of the packet in the frame
+     * @return the size of the packet sent
+     */
+    uint32_t SendPacket (const Address &address, const QueuedFrame &frame, uint16_t packetIndex);
+
+    /**
+     * @brief Build one fragment or parity packet of a frame, or copy it
+     * from the packet cache.
+     * 
+     * @param frame the frame the packet belongs to
+     * @param packetIndex the index of the packet in the frame
+     * @return the packet, header included
+     */
+    Ptr<Packet> MakePacket (const QueuedFrame &frame, uint16_t packetIndex);
+
+    /**
+     * @brief Send a packet from the socket of the address family.
+     * 
+     * @param address the destination address
+     * @param p the packet
+     * @return the size of the packet
+     */
+    uint32_t SendTo (const Address &address, Ptr<Packet> p);
+
+    /**
+     * @brief Get the multicast group of a video level.
+     * 
+     * @param videoLevel the video level
+     * @return the socket address of the group
+     */
+    Address GetGroupAddress (uint16_t videoLevel) const;
+
+    /**
+     * @brief Count a client watching a video level, and start the frame
+     * clock of the groups if needed.
+     * 
+     * @param videoLevel the video level
+     */
+    void Subscribe (uint16_t videoLevel);
+
+    /**
+     * @brief Stop counting a client watching a video level.
+     * 
+     * @param videoLevel the video level
+     */
+    void Unsubscribe (uint16_t videoLevel);
+
+    /**
+     * @brief Send the next frame to the group of every level watched by a
+     * client, and schedule the next frame.
+     */
+    void SendGroups (void);
+
+    /**
+     * @brief Schedule the next frame of a client.
+     * 
+     * With the batched tick, the client is put on the timer wheel for the
+     * tick closest to the delay, otherwise it gets its own event.
+     * 
+     * @param sessionId the session id
+     * @param delay the time until the next frame
+     */
+    void ScheduleSend (uint64_t sessionId, Time delay);
+
+    /**
+     * @brief Send the frames of all the clients due at the current tick
+     * of the timer wheel, and schedule the next tick.
+     */
+    void Tick (void);
+
+    /**
+     * @brief Send the queued fragments of a client allowed by the pacer,
+     * and schedule the next paced transmission.
+     * 
+     * @param sessionId the session id
+     */
+    void SendPaced (uint64_t sessionId);
     
     /**
-     * @brief Send the video frame to the given ipv4 address.
+     * @brief Send the next video frame of a session.
+     * 
+     * @param sessionId the session id
+     */
+    void Send (uint64_t sessionId);
+
+    /**
+     * @brief Send a frame to a session, at once or through its pacer.
+     * 
+     * @param sessionId the session id
+     * @param frameNumber the frame number
+     */
+    void SendFrame (uint64_t sessionId, uint32_t frameNumber);
+
+    /**
+     * @brief Send the frames of a segment requested by a session back to
+     * back.
      * 
-     * @param ipAddress ipv4 address
+     * @param sessionId the session id
+     * @param firstFrame the first frame of the segment
+     * @param frameCount the number of frames of the segment
      */
-    void Send (uint32_t ipAddress);
+    void SendSegment (uint64_t sessionId, uint32_t firstFrame, uint16_t frameCount);
 
     /**
      * @brief Handle a packet reception.
@@ -104,9 +529,72 @@ class Packet;
      */
     void HandleRead (Ptr<Socket> socket);
 
+    /**
+     * @brief Handle a control message of a client.
+     * 
+     * @param socket the socket the message was received to
+     * @param header the control message
+     * @param from the address of the client
+     */
+    void HandleControl (Ptr<Socket> socket, const VideoStreamControlHeader &header, const Address &from);
+
+    /**
+     * @brief Record a receiver report of a session, and update its target
+     * rate and level cap.
+     * 
+     * @param sessionId the session id
+     * @param header the report
+     */
+    void HandleReport (uint64_t sessionId, const VideoStreamControlHeader &header);
+
+    /**
+     * @brief Send again the fragments NACKed by a session that can still
+     * arrive before the playout of their frame.
+     * 
+     * @param sessionId the session id
+     * @param header the NACK
+     */
+    void HandleNack (uint64_t sessionId, const VideoStreamControlHeader &header);
+
+    /**
+     * @brief Handle a new TCP connection.
+     * 
+     * @param socket the connected socket
+     * @param from the address of the client
+     */
+    void HandleAccept (Ptr<Socket> socket, const Address &from);
+
+    /**
+     * @brief Handle the end of a TCP connection.
+     * 
+     * @param socket the connected socket
+     */
+    void HandlePeerClose (Ptr<Socket> socket);
+
+    /**
+     * @brief Write more fragments once the TCP send buffer has room.
+     * 
+     * @param socket the connected socket
+     * @param available the number of free bytes in the send buffer
+     */
+    void HandleSendSpace (Ptr<Socket> socket, uint32_t available);
+
+    /**
+     * @brief Write the queued fragments of a TCP session that fit in the
+     * send buffer of its connection, and restart its frame clock once its
+     * queue is below PacingQueueLimit again.
+     * 
+     * @param sessionId the session id
+     */
+    void SendStream (uint64_t sessionId);
+
     Time m_interval; //!< Packet inter-send time
     uint32_t m_maxPacketSize; //!< Maximum size of the packet to be sent
-    Ptr<Socket> m_socket; //!< Socket
+    Ptr<Socket> m_socket; //!< IPv4 socket
+    Ptr<Socket> m_socket6; //!< IPv6 socket
+    TypeId m_protocol; //!< Type of the socket factory
+    bool m_tcp; //!< Whether the clients connect over TCP
+    std::map<Ptr<Socket>, Ptr<Packet> > m_receiveBuffers; //!< Received bytes not forming a whole control message yet, by TCP connection
 
     uint16_t m_port; //!< The port 
     Address m_local; //!< Local multicast address
@@ -114,9 +602,62 @@ class Packet;
     uint32_t m_frameRate; //!< Number of frames per second to be sent
     uint32_t m_videoLength; //!< Length of the video in seconds
     std::string m_frameFile; //!< Name of the file containing frame sizes
-    std::vector<uint32_t> m_frameSizeList; //!< List of video frame sizes
+    Ptr<const VideoStreamTrace> m_trace; //!< Shared list of video frame sizes
+    std::string m_ladderFile; //!< Name of the file defining the representation ladder
+    Ptr<const VideoStreamLadder> m_ladder; //!< Shared representation ladder, used instead of the frame sizes when set
+    Ptr<const VideoStreamFramePlan> m_plan; //!< Frame sizes and fragments of every level, built when the application starts
     
-    std::unordered_map<uint32_t, ClientInfo*> m_clients; //!< Information saved for each client
+    PacingMode m_pacingMode; //!< How fragments are spread in time
+    DataRate m_pacingRate; //!< Rate of the token bucket pacer
+    uint32_t m_pacingBurst; //!< Size of the token bucket in bytes
+    uint32_t m_pacingQueueLimit; //!< Maximum number of frames in the pacing queue of a client
+    DropPolicy m_dropPolicy; //!< Which frames are dropped from a full pacing queue
+    TracedCallback<const Address &, uint32_t, VideoStreamTrace::FrameType> m_frameDroppedTrace; //!< Trace of the frames dropped
+    TracedCallback<const Address &, uint32_t> m_pacingQueueTrace; //!< Trace of the pacing queue depth
+    TracedCallback<const Address &, uint32_t, uint32_t, uint16_t> m_frameSentTrace; //!< Trace of the frames sent
+
+    uint16_t m_fecGroupSize; //!< Number of fragments protected by each parity packet (0 for none)
+    uint32_t m_retransmissionWindow; //!< Number of recent frames of a client kept for the retransmissions
+    TracedCallback<const Address &, uint32_t, uint16_t> m_retransmissionTrace; //!< Trace of the fragments sent again
+
+    RateControl m_rateControl; //!< How the server reacts to the receiver reports
+    double m_lossThreshold; //!< Fraction of lost fragments above which the target rate is cut
+    DataRate m_rateIncrease; //!< Step of the target rate on a report without loss
+    double m_rateDecrease; //!< Factor of the target rate on a report with loss
+    std::vector<double> m_levelBitrates; //!< Bitrate of each level of the plan in bit/s, level l at index l - 1
+    TracedCallback<const Address &, double, uint32_t, Time, Time> m_receiverReportTrace; //!< Trace of the receiver reports
+    TracedCallback<const Address &, double, uint16_t> m_sessionRateTrace; //!< Trace of the target rates and level caps
+
+    bool m_packetCacheEnabled; //!< Whether the fragments built at the current time are reused
+    std::unordered_map<uint64_t, Ptr<Packet> > m_packetCache; //!< Fragments built at the current time, by frame, level and index
+    Time m_packetCacheTime; //!< Time the fragments of the cache were built
+
+    Ipv4Address m_multicastGroup; //!< Group of the first video level, or 0.0.0.0 to send to each client
+    uint16_t m_multicastPort; //!< Destination port of the multicast groups
+    std::vector<uint32_t> m_groupSubscribers; //!< Number of clients watching each video level
+    uint32_t m_groupFrame; //!< Number of the next frame sent to the groups
+    EventId m_groupEvent; //!< Event to send the next frame to the groups
+
+    /**
+     * @brief A client waiting on the timer wheel.
+     */
+    typedef struct WheelEntry
+    {
+      uint64_t m_dueTick; //!< Tick at which the next frame is due
+      uint64_t m_sessionId; //!< Session of the client
+    } WheelEntry;
+
+    bool m_batchedTick; //!< Whether all the clients are served by a single frame clock
+    std::vector<std::vector<WheelEntry> > m_wheel; //!< Clients indexed by due tick modulo the wheel size
+    uint32_t m_wheelEntries; //!< Number of clients on the wheel
+    uint64_t m_tick; //!< Number of the next tick
+    EventId m_tickEvent; //!< Event of the next tick
+
+    std::vector<ClientInfo> m_sessions; //!< Slots of the session table
+    std::vector<uint32_t> m_freeSlots; //!< Indexes of the released slots
+    std::unordered_map<Address, uint32_t, AddressHash> m_clients; //!< Slot of the session of each client address
+    Time m_sessionTimeout; //!< Time without activity after which a session is closed
+    EventId m_evictEvent; //!< Event to close the idle sessions
     const uint32_t m_frameSizes[6] = {0, 230400, 345600, 921600, 2073600, 2211840}; //!< Frame size for 360p, 480p, 720p, 1080p and 2K
   };
 
@@ -0,0 +1,460 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/boolean.h"
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/video-stream-trace.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("VideoStreamTrace");
+
+namespace {
+
+const uint8_t BINARY_MAGIC[4] = {'V', 'S', 'T', 'R'}; //!< First bytes of a binary trace
+const uint16_t BINARY_VERSION = 1; //!< Version of the binary trace format
+const uint32_t BINARY_HEADER_SIZE = 32; //!< Size of the fixed binary trace header
+const uint32_t CHECKPOINT_INTERVAL = 64; //!< Frames between two checkpoints written by WriteBinary
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL; //!< Hash of no bytes
+
+uint64_t
+HashBytes (const uint8_t *data, uint64_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+  // 64-bit FNV-1a, continuing from the hash of the previous bytes
+  for (uint64_t i = 0; i < size; i++)
+  {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t
+ReadLittleEndian (const uint8_t *data, uint32_t bytes)
+{
+  uint64_t value = 0;
+  for (uint32_t i = 0; i < bytes; i++)
+  {
+    value |= (uint64_t) data[i] << (8 * i);
+  }
+  return value;
+}
+
+void
+WriteLittleEndian (std::vector<uint8_t> &out, uint64_t value, uint32_t bytes)
+{
+  for (uint32_t i = 0; i < bytes; i++)
+  {
+    out.push_back ((value >> (8 * i)) & 0xff);
+  }
+}
+
+void
+WriteLittleEndian (std::vector<uint8_t> &out, uint64_t offset, uint64_t value, uint32_t bytes)
+{
+  for (uint32_t i = 0; i < bytes; i++)
+  {
+    out[offset + i] = (value >> (8 * i)) & 0xff;
+  }
+}
+
+} // anonymous namespace
+
+static GlobalValue g_verifyTraceHash ("VideoStreamTraceVerifyHash",
+                                      "Hash the whole of every binary trace when it is mapped and check it against the hash of its header, which reads every page of the file",
+                                      BooleanValue (false),
+                                      MakeBooleanChecker ());
+
+std::map<std::string, VideoStreamTrace::PathEntry> VideoStreamTrace::s_pathCache;
+std::map<uint64_t, Ptr<const VideoStreamTrace> > VideoStreamTrace::s_contentCache;
+
+VideoStreamTrace::VideoStreamTrace (std::vector<uint32_t> &frameSizes, std::vector<uint8_t> &frameTypes, uint64_t contentHash)
+  : m_mapped (0),
+    m_mappedSize (0),
+    m_typeOffset (0),
+    m_nLevels (1),
+    m_frameRate (0),
+    m_checkpointInterval (0),
+    m_contentHash (contentHash)
+{
+  NS_LOG_FUNCTION (this << contentHash);
+  m_frameSizes.swap (frameSizes);
+  m_frameTypes.swap (frameTypes);
+  m_nFrames = m_frameSizes.size ();
+}
+
+VideoStreamTrace::VideoStreamTrace (const uint8_t *data, uint64_t size)
+  : m_mapped (data),
+    m_mappedSize (size)
+{
+  NS_LOG_FUNCTION (this << size);
+  m_nLevels = ReadLittleEndian (data + 6, 2);
+  m_frameRate = ReadLittleEndian (data + 8, 4);
+  m_nFrames = ReadLittleEndian (data + 12, 4);
+  m_checkpointInterval = ReadLittleEndian (data + 16, 4);
+  for (uint16_t i = 0; i < m_nLevels; i++)
+  {
+    m_columnOffsets.push_back (ReadLittleEndian (data + BINARY_HEADER_SIZE + 8 * i, 8));
+  }
+  m_typeOffset = ReadLittleEndian (data + BINARY_HEADER_SIZE + 8 * m_nLevels, 8);
+  m_contentHash = ReadLittleEndian (data + 24, 8);
+}
+
+VideoStreamTrace::~VideoStreamTrace ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_mapped != 0)
+  {
+    munmap ((void *) m_mapped, m_mappedSize);
+  }
+}
+
+Ptr<const VideoStreamTrace>
+VideoStreamTrace::Load (std::string fileName)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  struct stat fileStat;
+  bool hasStat = (stat (fileName.c_str (), &fileStat) == 0);
+
+  // the same path was loaded before and the file has not changed since
+  auto pathIter = s_pathCache.find (fileName);
+  if (hasStat && pathIter != s_pathCache.end ()
+      && pathIter->second.m_fileSize == (uint64_t) fileStat.st_size
+      && pathIter->second.m_modifyTime == (int64_t) fileStat.st_mtime)
+  {
+    return pathIter->second.m_trace;
+  }
+
+  Ptr<const VideoStreamTrace> trace = MapBinary (fileName);
+  if (trace != 0)
+  {
+    // binary traces are keyed by the hash stored in their header
+    auto contentIter = s_contentCache.find (trace->GetContentHash ());
+    if (contentIter != s_contentCache.end ())
+    {
+      trace = contentIter->second;
+    }
+    else
+    {
+      s_contentCache[trace->GetContentHash ()] = trace;
+      NS_LOG_INFO ("Mapped " << trace->GetNFrames () << " frames from " << fileName);
+    }
+  }
+  else
+  {
+    std::ifstream fileStream (fileName, std::ios::in | std::ios::binary);
+    if (!fileStream)
+    {
+      NS_LOG_WARN ("Can not open the frame file " << fileName);
+    }
+    std::string content ((std::istreambuf_iterator<char> (fileStream)), std::istreambuf_iterator<char> ());
+    uint64_t contentHash = HashBytes ((const uint8_t *) content.data (), content.size ());
+
+    auto contentIter = s_contentCache.find (contentHash);
+    if (contentIter != s_contentCache.end ())
+    {
+      // another path with the same content was loaded before
+      trace = contentIter->second;
+    }
+    else
+    {
+      std::vector<uint32_t> frameSizes;
+      std::vector<uint8_t> frameTypes;
+      bool typed = false;
+      const char *cursor = content.c_str ();
+      char *end;
+      while (*cursor != '\0')
+      {
+        unsigned long result = std::strtoul (cursor, &end, 10);
+        if (end == cursor)
+        {
+          // skip anything that is not a number, such as blank lines
+          cursor++;
+          continue;
+        }
+        frameSizes.push_back (result);
+        cursor = end;
+
+        // an optional frame type on the same line
+        while (*cursor == ' ' || *cursor == '\t')
+        {
+          cursor++;
+        }
+        const char *type = std::strchr ("IPB", std::toupper ((unsigned char) *cursor));
+        if (*cursor != '\0' && type != 0 && !std::isalnum ((unsigned char) cursor[1]))
+        {
+          frameTypes.push_back (type - "IPB");
+          typed = true;
+          cursor++;
+        }
+        else
+        {
+          frameTypes.push_back (P_FRAME);
+        }
+      }
+      if (!typed)
+      {
+        frameTypes.clear ();
+      }
+      trace = Ptr<const VideoStreamTrace> (new VideoStreamTrace (frameSizes, frameTypes, contentHash), false);
+      s_contentCache[contentHash] = trace;
+      NS_LOG_INFO ("Loaded " << trace->GetNFrames () << " frames from " << fileName);
+    }
+  }
+
+  if (hasStat)
+  {
+    PathEntry entry;
+    entry.m_fileSize = fileStat.st_size;
+    entry.m_modifyTime = fileStat.st_mtime;
+    entry.m_trace = trace;
+    s_pathCache[fileName] = entry;
+  }
+  return trace;
+}
+
+Ptr<VideoStreamTrace>
+VideoStreamTrace::MapBinary (std::string fileName)
+{
+  NS_LOG_FUNCTION (fileName);
+
+  int fd = open (fileName.c_str (), O_RDONLY);
+  if (fd < 0)
+  {
+    return 0;
+  }
+  struct stat fileStat;
+  uint8_t magic[sizeof (BINARY_MAGIC)];
+  if (fstat (fd, &fileStat) != 0 || (uint64_t) fileStat.st_size < BINARY_HEADER_SIZE
+      || read (fd, magic, sizeof (magic)) != sizeof (magic)
+      || std::memcmp (magic, BINARY_MAGIC, sizeof (magic)) != 0)
+  {
+    close (fd);
+    return 0;
+  }
+
+  uint64_t size = fileStat.st_size;
+  void *mapping = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (mapping == MAP_FAILED)
+  {
+    NS_FATAL_ERROR ("Failed to map the binary frame file " << fileName);
+  }
+  const uint8_t *data = (const uint8_t *) mapping;
+
+  uint16_t version = ReadLittleEndian (data + 4, 2);
+  uint16_t nLevels = ReadLittleEndian (data + 6, 2);
+  uint32_t checkpointInterval = ReadLittleEndian (data + 16, 4);
+  if (version != BINARY_VERSION || nLevels == 0 || checkpointInterval == 0
+      || BINARY_HEADER_SIZE + 8 * ((uint64_t) nLevels + 1) > size)
+  {
+    munmap (mapping, size);
+    NS_FATAL_ERROR ("Unsupported binary frame file " << fileName << " (version " << version << ")");
+  }
+
+  // hashing the file would read all of it, so the hash written in the
+  // header is trusted unless asked otherwise
+  BooleanValue verifyHash;
+  g_verifyTraceHash.GetValue (verifyHash);
+  if (verifyHash.Get ()
+      && ReadLittleEndian (data + 24, 8) != HashBytes (data + BINARY_HEADER_SIZE, size - BINARY_HEADER_SIZE, HashBytes (data, 24)))
+  {
+    munmap (mapping, size);
+    NS_FATAL_ERROR ("Corrupted binary frame file " << fileName << " (hash mismatch)");
+  }
+
+  Ptr<VideoStreamTrace> trace = Ptr<VideoStreamTrace> (new VideoStreamTrace (data, size), false);
+  uint64_t nCheckpoints = (trace->m_nFrames + checkpointInterval - 1) / checkpointInterval;
+  for (uint16_t i = 0; i < nLevels; i++)
+  {
+    if (trace->m_columnOffsets[i] + 4 * nCheckpoints > size)
+    {
+      NS_FATAL_ERROR ("Truncated binary frame file " << fileName);
+    }
+  }
+  if (trace->m_typeOffset + trace->m_nFrames > size)
+  {
+    NS_FATAL_ERROR ("Truncated binary frame file " << fileName);
+  }
+  return trace;
+}
+
+bool
+VideoStreamTrace::WriteBinary (std::string fileName, const std::vector<std::vector<uint32_t> > &levels, const std::vector<uint8_t> &frameTypes, uint32_t frameRate)
+{
+  NS_LOG_FUNCTION (fileName << levels.size () << frameTypes.size () << frameRate);
+  NS_ASSERT_MSG (!levels.empty () && levels.size () < UINT16_MAX, "Invalid number of levels: " << levels.size ());
+  NS_ASSERT_MSG (frameTypes.empty () || frameTypes.size () == levels[0].size (), "There are " << frameTypes.size () << " frame types for " << levels[0].size () << " frames");
+
+  uint32_t nFrames = levels[0].size ();
+  uint32_t nCheckpoints = (nFrames + CHECKPOINT_INTERVAL - 1) / CHECKPOINT_INTERVAL;
+
+  std::vector<uint8_t> out;
+  out.insert (out.end (), BINARY_MAGIC, BINARY_MAGIC + sizeof (BINARY_MAGIC));
+  WriteLittleEndian (out, BINARY_VERSION, 2);
+  WriteLittleEndian (out, levels.size (), 2);
+  WriteLittleEndian (out, frameRate, 4);
+  WriteLittleEndian (out, nFrames, 4);
+  WriteLittleEndian (out, CHECKPOINT_INTERVAL, 4);
+  WriteLittleEndian (out, 0, 4);
+  WriteLittleEndian (out, 0, 8);
+  out.resize (BINARY_HEADER_SIZE + 8 * (levels.size () + 1));
+
+  for (uint32_t i = 0; i < levels.size (); i++)
+  {
+    NS_ASSERT_MSG (levels[i].size () == nFrames, "Level " << i << " has " << levels[i].size () << " frames instead of " << nFrames);
+    uint64_t columnOffset = out.size ();
+    WriteLittleEndian (out, BINARY_HEADER_SIZE + 8 * i, columnOffset, 8);
+    out.resize (columnOffset + 4 * nCheckpoints);
+    uint64_t dataOffset = out.size ();
+
+    int64_t previous = 0;
+    for (uint32_t frame = 0; frame < nFrames; frame++)
+    {
+      if (frame % CHECKPOINT_INTERVAL == 0)
+      {
+        WriteLittleEndian (out, columnOffset + 4 * (frame / CHECKPOINT_INTERVAL), out.size () - dataOffset, 4);
+        previous = 0;
+      }
+      int64_t delta = (int64_t) levels[i][frame] - previous;
+      uint64_t zigzag = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+      while (zigzag >= 0x80)
+      {
+        out.push_back ((zigzag & 0x7f) | 0x80);
+        zigzag >>= 7;
+      }
+      out.push_back (zigzag);
+      previous = levels[i][frame];
+    }
+  }
+  if (!frameTypes.empty ())
+  {
+    WriteLittleEndian (out, BINARY_HEADER_SIZE + 8 * levels.size (), out.size (), 8);
+    out.insert (out.end (), frameTypes.begin (), frameTypes.end ());
+  }
+  uint64_t hash = HashBytes (out.data (), 24);
+  WriteLittleEndian (out, 24, HashBytes (out.data () + BINARY_HEADER_SIZE, out.size () - BINARY_HEADER_SIZE, hash), 8);
+
+  std::ofstream fileStream (fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+  fileStream.write ((const char *) out.data (), out.size ());
+  return fileStream.good ();
+}
+
+void
+VideoStreamTrace::ClearCache (void)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  s_pathCache.clear ();
+  s_contentCache.clear ();
+}
+
+uint32_t
+VideoStreamTrace::GetNFrames (void) const
+{
+  return m_nFrames;
+}
+
+uint16_t
+VideoStreamTrace::GetNLevels (void) const
+{
+  return m_nLevels;
+}
+
+uint32_t
+VideoStreamTrace::GetFrameRate (void) const
+{
+  return m_frameRate;
+}
+
+bool
+VideoStreamTrace::IsEmpty (void) const
+{
+  return m_nFrames == 0;
+}
+
+uint32_t
+VideoStreamTrace::GetFrameSize (uint32_t frame) const
+{
+  NS_ASSERT (frame < m_nFrames);
+  if (m_mapped == 0)
+  {
+    return m_frameSizes[frame];
+  }
+  return DecodeFrameSize (frame, 0);
+}
+
+uint32_t
+VideoStreamTrace::GetFrameSize (uint32_t frame, uint16_t level) const
+{
+  NS_ASSERT (frame < m_nFrames && level > 0);
+  if (m_nLevels == 1)
+  {
+    return GetFrameSize (frame) * level;
+  }
+  return DecodeFrameSize (frame, std::min<uint16_t> (level, m_nLevels) - 1);
+}
+
+uint32_t
+VideoStreamTrace::DecodeFrameSize (uint32_t frame, uint16_t column) const
+{
+  uint64_t nCheckpoints = (m_nFrames + m_checkpointInterval - 1) / m_checkpointInterval;
+  const uint8_t *checkpoints = m_mapped + m_columnOffsets[column];
+  const uint8_t *cursor = checkpoints + 4 * nCheckpoints
+    + ReadLittleEndian (checkpoints + 4 * (frame / m_checkpointInterval), 4);
+  const uint8_t *end = m_mapped + m_mappedSize;
+
+  // walk the deltas from the closest checkpoint
+  int64_t value = 0;
+  for (uint32_t i = 0; i <= frame % m_checkpointInterval; i++)
+  {
+    uint64_t zigzag = 0;
+    uint32_t shift = 0;
+    do
+    {
+      NS_ABORT_MSG_IF (cursor >= end, "Corrupted binary frame file");
+      zigzag |= (uint64_t) (*cursor & 0x7f) << shift;
+      shift += 7;
+    }
+    while (*cursor++ & 0x80);
+    value += (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+  }
+  return value;
+}
+
+bool
+VideoStreamTrace::HasFrameTypes (void) const
+{
+  return m_mapped == 0 ? !m_frameTypes.empty () : m_typeOffset != 0;
+}
+
+VideoStreamTrace::FrameType
+VideoStreamTrace::GetFrameType (uint32_t frame) const
+{
+  NS_ASSERT (frame < m_nFrames);
+  if (m_mapped == 0)
+  {
+    return m_frameTypes.empty () ? I_FRAME : (FrameType) m_frameTypes[frame];
+  }
+  return m_typeOffset == 0 ? I_FRAME : (FrameType) std::min<uint8_t> (m_mapped[m_typeOffset + frame], B_FRAME);
+}
+
+uint64_t
+VideoStreamTrace::GetContentHash (void) const
+{
+  return m_contentHash;
+}
+
+} // namespace ns3
@@ -0,0 +1,237 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#ifndef VIDEO_STREAM_TRACE_H
+#define VIDEO_STREAM_TRACE_H
+
+#include "ns3/ptr.h"
+#include "ns3/simple-ref-count.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+  /**
+   * @brief An immutable list of video frame sizes, and optionally of frame
+   * types, read from a trace file.
+   *
+   * Traces are only created through Load (), which keeps a process-wide
+   * registry keyed by the file path and by the hash of the file content.
+   * Every server streaming the same trace therefore shares a single read-only
+   * copy, and the file is parsed only once. A binary trace is keyed by the
+   * hash written in its header, which is only checked against the file when
+   * the VideoStreamTraceVerifyHash global value is set, since hashing the
+   * file reads all of it.
+   *
+   * Two file formats are understood:
+   * - text: one frame size in bytes per line, optionally followed by the
+   *   type of the frame (I, P or B);
+   * - binary: the compact format written by WriteBinary (), which is memory
+   *   mapped instead of parsed.
+   *
+   * The frame types give the group of pictures structure of the video: each
+   * I frame starts a group, whose P and B frames depend on it. Traces
+   * without types, or the untyped lines of a text trace with types, hold
+   * key frames and P frames respectively.
+   *
+   * The binary format is little-endian and laid out as follows:
+   * @verbatim
+     offset  size  field
+          0     4  magic "VSTR"
+          4     2  format version (1)
+          6     2  number of level columns L
+          8     4  frame rate (0 if unknown)
+         12     4  number of frames N
+         16     4  checkpoint interval K
+         20     4  reserved
+         24     8  FNV-1a hash of the bytes before and after this field
+         32   8*L  file offset of each column
+     32+8*L     8  file offset of the frame type column (0 if none)
+     each column:
+              4*C  byte offset of every K-th frame within the column data,
+                   with C = ceil (N / K)
+                   column data: zigzag varint of the difference to the
+                   previous frame size, restarting from 0 at each checkpoint
+     frame type column:
+                N  FrameType of each frame
+     @endverbatim
+   */
+  class VideoStreamTrace : public SimpleRefCount<VideoStreamTrace>
+  {
+  public:
+    /**
+     * @brief Type of a video frame, from the most to the least important.
+     */
+    enum FrameType
+    {
+      I_FRAME = 0, //!< Key frame, decoded on its own and starting a group of pictures
+      P_FRAME = 1, //!< Frame predicted from the previous reference frames of its group
+      B_FRAME = 2  //!< Frame predicted from the reference frames around it, and referenced by no other frame
+    };
+
+    ~VideoStreamTrace ();
+
+    /**
+     * @brief Get the trace stored in the given file, loading it if needed.
+     *
+     * @param fileName the name of the text or binary trace file
+     * @return the shared trace (empty if the file cannot be read)
+     */
+    static Ptr<const VideoStreamTrace> Load (std::string fileName);
+
+    /**
+     * @brief Drop every trace held by the registry.
+     *
+     * Traces still referenced by applications stay valid, they are only
+     * forgotten by the registry.
+     */
+    static void ClearCache (void);
+
+    /**
+     * @brief Write frame sizes to a file in the binary trace format.
+     *
+     * @param fileName the name of the output file
+     * @param levels the frame sizes of each level column, all of the same length
+     * @param frameTypes the FrameType of each frame (empty if unknown)
+     * @param frameRate the frame rate of the video (0 if unknown)
+     * @return true if the file was written successfully
+     */
+    static bool WriteBinary (std::string fileName, const std::vector<std::vector<uint32_t> > &levels, const std::vector<uint8_t> &frameTypes, uint32_t frameRate);
+
+    /**
+     * @brief Get the number of frames in the trace.
+     *
+     * @return the number of frames
+     */
+    uint32_t GetNFrames (void) const;
+
+    /**
+     * @brief Get the number of level columns in the trace.
+     *
+     * @return the number of levels (1 for text traces)
+     */
+    uint16_t GetNLevels (void) const;
+
+    /**
+     * @brief Get the frame rate stored in the trace.
+     *
+     * @return the frame rate (0 if the trace does not record it)
+     */
+    uint32_t GetFrameRate (void) const;
+
+    /**
+     * @brief Check whether the trace contains any frame.
+     *
+     * @return true if the trace has no frames
+     */
+    bool IsEmpty (void) const;
+
+    /**
+     * @brief Get the size of the given frame in the first level column.
+     *
+     * @param frame the frame number
+     * @return the frame size in bytes
+     */
+    uint32_t GetFrameSize (uint32_t frame) const;
+
+    /**
+     * @brief Get the size of the given frame at a video level.
+     *
+     * Traces with per-level columns return the column of the level (the last
+     * column for higher levels), the others scale the first column linearly
+     * by the level.
+     *
+     * @param frame the frame number
+     * @param level the video level, starting from 1
+     * @return the frame size in bytes
+     */
+    uint32_t GetFrameSize (uint32_t frame, uint16_t level) const;
+
+    /**
+     * @brief Check whether the trace records the type of its frames.
+     *
+     * @return true if the trace has a frame type column or typed lines
+     */
+    bool HasFrameTypes (void) const;
+
+    /**
+     * @brief Get the type of the given frame.
+     *
+     * @param frame the frame number
+     * @return the frame type (I_FRAME if the trace has no types)
+     */
+    FrameType GetFrameType (uint32_t frame) const;
+
+    /**
+     * @brief Get the hash of the content the trace was loaded from.
+     *
+     * @return the 64-bit FNV-1a hash of the file content (as written in the
+     * header for binary traces)
+     */
+    uint64_t GetContentHash (void) const;
+
+  private:
+    /**
+     * @brief Construct a trace from already parsed frame sizes.
+     *
+     * @param frameSizes the frame sizes
+     * @param frameTypes the frame types (empty if unknown)
+     * @param contentHash the hash of the file content
+     */
+    VideoStreamTrace (std::vector<uint32_t> &frameSizes, std::vector<uint8_t> &frameTypes, uint64_t contentHash);
+
+    /**
+     * @brief Construct a trace over a mapped binary trace file.
+     *
+     * @param data the start of the mapping
+     * @param size the size of the mapping in bytes
+     */
+    VideoStreamTrace (const uint8_t *data, uint64_t size);
+
+    /**
+     * @brief Map a binary trace file into memory.
+     *
+     * @param fileName the name of the file
+     * @return the trace, or 0 if the file is not a valid binary trace
+     */
+    static Ptr<VideoStreamTrace> MapBinary (std::string fileName);
+
+    /**
+     * @brief Decode a frame size from a column of a binary trace.
+     *
+     * @param frame the frame number
+     * @param column the column index
+     * @return the frame size in bytes
+     */
+    uint32_t DecodeFrameSize (uint32_t frame, uint16_t column) const;
+
+    /**
+     * @brief An entry of the registry indexed by file path.
+     */
+    typedef struct PathEntry
+    {
+      uint64_t m_fileSize; //!< Size of the file when it was loaded
+      int64_t m_modifyTime; //!< Modification time of the file when it was loaded
+      Ptr<const VideoStreamTrace> m_trace; //!< The loaded trace
+    } PathEntry;
+
+    static std::map<std::string, PathEntry> s_pathCache; //!< Traces indexed by file path
+    static std::map<uint64_t, Ptr<const VideoStreamTrace> > s_contentCache; //!< Traces indexed by content hash
+
+    std::vector<uint32_t> m_frameSizes; //!< List of video frame sizes of a text trace
+    std::vector<uint8_t> m_frameTypes; //!< List of video frame types of a text trace (empty if untyped)
+    const uint8_t *m_mapped; //!< Start of the mapped binary trace (0 for text traces)
+    uint64_t m_mappedSize; //!< Size of the mapped binary trace
+    std::vector<uint64_t> m_columnOffsets; //!< File offset of each level column of a binary trace
+    uint64_t m_typeOffset; //!< File offset of the frame type column of a binary trace (0 if none)
+    uint32_t m_nFrames; //!< Number of frames
+    uint16_t m_nLevels; //!< Number of level columns
+    uint32_t m_frameRate; //!< Frame rate (0 if unknown)
+    uint32_t m_checkpointInterval; //!< Number of frames between two checkpoints of a binary trace
+    uint64_t m_contentHash; //!< Hash of the file content
+  };
+
+} // namespace ns3
+
+#endif /* VIDEO_STREAM_TRACE_H */
@@ -0,0 +1,1041 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+
+#include "ns3/test.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/video-stream-abr.h"
+#include "ns3/video-stream-control-header.h"
+#include "ns3/video-stream-estimator.h"
+#include "ns3/video-stream-frame-plan.h"
+#include "ns3/video-stream-playout.h"
+#include "ns3/video-stream-reassembler.h"
+#include "ns3/video-stream-server.h"
+#include "ns3/video-stream-trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace ns3 {
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check that the playout buffer depletes at the frame rate, and
+ * stops depleting while paused.
+ */
+class VideoStreamPlayoutTestCase : public TestCase
+{
+public:
+  VideoStreamPlayoutTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+VideoStreamPlayoutTestCase::VideoStreamPlayoutTestCase ()
+  : TestCase ("Deplete the playout buffer of a video stream client")
+{
+}
+
+void
+VideoStreamPlayoutTestCase::DoRun (void)
+{
+  VideoStreamPlayout playout (25);
+  for (uint32_t i = 0; i < 10; i++)
+  {
+    playout.AddFrame ();
+  }
+  NS_TEST_ASSERT_MSG_EQ (playout.IsPlaying (), false, "The playback starts paused");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferedFrames (Seconds (1.0)), 10, "No frame is played before the playback starts");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferLevel (Seconds (1.0)), MilliSeconds (400), "10 frames at 25 fps last 400 ms");
+
+  playout.Play (Seconds (1.0));
+  NS_TEST_ASSERT_MSG_EQ (playout.GetPlayedFrames (Seconds (1.0)), 0, "No frame is played when the playback starts");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetPlayedFrames (MilliSeconds (1039)), 0, "A frame is played once its whole period has elapsed");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetPlayedFrames (MilliSeconds (1040)), 1, "A frame is played once its whole period has elapsed");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferedFrames (MilliSeconds (1100)), 8, "2 frames are played in 100 ms");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferLevel (MilliSeconds (1100)), MilliSeconds (300), "The buffer level follows the playback");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetDepletionTime (), MilliSeconds (1400), "The buffer runs out 400 ms after the playback starts");
+
+  // the frames added during the playback push the depletion back
+  playout.AddFrame ();
+  NS_TEST_ASSERT_MSG_EQ (playout.GetDepletionTime (), MilliSeconds (1440), "A new frame adds one frame period");
+
+  playout.Pause (MilliSeconds (1200));
+  NS_TEST_ASSERT_MSG_EQ (playout.IsPlaying (), false, "The playback is paused");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetPlayedFrames (Seconds (5.0)), 5, "No frame is played while paused");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferLevel (Seconds (5.0)), MilliSeconds (240), "The buffer level holds while paused");
+
+  playout.Play (Seconds (5.0));
+  NS_TEST_ASSERT_MSG_EQ (playout.GetDepletionTime (), MilliSeconds (5240), "The playback resumes with the frames left");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferedFrames (Seconds (6.0)), 0, "The buffer runs dry");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetPlayedFrames (Seconds (6.0)), 11, "No more frames are played than received");
+  NS_TEST_ASSERT_MSG_EQ (playout.GetBufferLevel (Seconds (6.0)), Time (), "An empty buffer has no level");
+
+  // a frame period that is not a whole number of time steps rounds up
+  VideoStreamPlayout rounded (30);
+  rounded.AddFrame ();
+  NS_TEST_ASSERT_MSG_EQ (rounded.GetBufferLevel (Seconds (0.0)), TimeStep ((Seconds (1.0).GetTimeStep () + 29) / 30), "A frame period rounds up");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check the throughput samples taken from the fragment trains, and
+ * the round-trip time and jitter estimates.
+ */
+class VideoStreamEstimatorTestCase : public TestCase
+{
+public:
+  VideoStreamEstimatorTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+VideoStreamEstimatorTestCase::VideoStreamEstimatorTestCase ()
+  : TestCase ("Estimate the throughput and round-trip time of a video stream client")
+{
+}
+
+void
+VideoStreamEstimatorTestCase::DoRun (void)
+{
+  VideoStreamEstimator estimator (0.25, 4);
+
+  // a back-to-back train: the first fragment only marks its start
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (1, 1000, Seconds (1.0), false, MilliSeconds (1000)), false, "A partial frame gives no sample");
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (1, 1000, Seconds (1.0), false, MilliSeconds (1001)), false, "A partial frame gives no sample");
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (1, 1000, Seconds (1.0), true, MilliSeconds (1002)), true, "A complete train gives a sample");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetLastThroughput (), 8e6, 1, "2000 bytes in 2 ms are 8 Mbit/s");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetThroughput (), 8e6, 1, "The first sample starts the moving average");
+
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (2, 1000, Seconds (2.0), false, MilliSeconds (2000)), false, "A partial frame gives no sample");
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (2, 1000, Seconds (2.0), true, MilliSeconds (2004)), true, "A complete train gives a sample");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetLastThroughput (), 2e6, 1, "1000 bytes in 4 ms are 2 Mbit/s");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetThroughput (), 6.5e6, 1, "The moving average weighs a new sample by 0.25");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetHarmonicThroughput (), 3.2e6, 1, "The harmonic mean of 8 and 2 Mbit/s is 3.2 Mbit/s");
+
+  // the fragments of a paced frame leave the server at different times; a
+  // path keeping up with the pacer gives the pace of the server
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (3, 1000, Seconds (3.0), false, MilliSeconds (3010)), false, "A partial frame gives no sample");
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (3, 1000, MilliSeconds (3010), true, MilliSeconds (3015)), true, "A paced train gives a sample");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetLastThroughput (), 0.8e6, 1, "1000 bytes sent 10 ms apart are 0.8 Mbit/s");
+
+  // a path spreading the paced fragments further gives its own pace
+  estimator.AddFragment (4, 1000, MilliSeconds (4000), false, MilliSeconds (4010));
+  estimator.AddFragment (4, 1000, MilliSeconds (4001), false, MilliSeconds (4014));
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (4, 1000, MilliSeconds (4002), true, MilliSeconds (4018)), true, "A paced train gives a sample");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetLastThroughput (), 2e6, 1, "2000 bytes in 8 ms of arrivals are 2 Mbit/s");
+
+  // a frame of a single fragment has no duration
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (5, 1000, Seconds (5.0), true, Seconds (5.0)), false, "A single fragment gives no sample");
+
+  // a train cut by the next frame starts over
+  estimator.AddFragment (6, 1000, Seconds (6.0), false, MilliSeconds (6000));
+  estimator.AddFragment (7, 1000, Seconds (7.0), false, MilliSeconds (7000));
+  NS_TEST_ASSERT_MSG_EQ (estimator.AddFragment (7, 500, Seconds (7.0), true, MilliSeconds (7001)), true, "The new frame starts a new train");
+  NS_TEST_ASSERT_MSG_EQ_TOL (estimator.GetLastThroughput (), 4e6, 1, "Only the bytes of the new train count");
+
+  estimator.AddRttSample (MilliSeconds (100));
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetRtt (), MilliSeconds (100), "The first sample starts the round-trip time");
+  estimator.AddRttSample (MilliSeconds (180));
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetRtt (), MilliSeconds (110), "The round-trip time weighs a new sample by 1/8");
+  estimator.AddRttSample (MilliSeconds (60));
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetMinRtt (), MilliSeconds (60), "The minimum round-trip time follows the smallest sample");
+
+  estimator.AddTransitSample (MilliSeconds (10));
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetJitter (), Time (), "A single transit time has no jitter");
+  estimator.AddTransitSample (MilliSeconds (12));
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetJitter (), MicroSeconds (125), "The jitter weighs a new difference by 1/16");
+
+  estimator.Configure (0.5, 2);
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetThroughput (), 0, "Configuring drops the samples");
+  NS_TEST_ASSERT_MSG_EQ (estimator.GetRtt (), Time (), "Configuring drops the round-trip time");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check the fragment counts and the byte offsets precomputed by the
+ * frame plan.
+ */
+class VideoStreamFramePlanTestCase : public TestCase
+{
+public:
+  VideoStreamFramePlanTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+VideoStreamFramePlanTestCase::VideoStreamFramePlanTestCase ()
+  : TestCase ("Plan the fragments and byte offsets of a video")
+{
+}
+
+void
+VideoStreamFramePlanTestCase::DoRun (void)
+{
+  std::vector<uint32_t> levelSizes;
+  levelSizes.push_back (1000);
+  levelSizes.push_back (2500);
+  Ptr<const VideoStreamFramePlan> plan = VideoStreamFramePlan::Create (levelSizes, 5, 1000);
+  NS_TEST_ASSERT_MSG_EQ (plan->GetNFrames (), 5, "Wrong number of frames");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetNLevels (), 2, "Wrong number of levels");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentCount (0, 1), 1, "A frame of one payload is one fragment");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentCount (0, 2), 3, "2500 bytes need 3 fragments of 1000 bytes");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentSize (0, 2, 1), 1000, "A middle fragment is full");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentSize (0, 2, 2), 500, "The last fragment holds the rest of the frame");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetByteOffset (3, 2), 7500, "The offset of a frame sums the frames before it");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetByteOffset (5, 2), 12500, "The end offset is the size of the stream");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetRangeSize (1, 4, 1), 3000, "Wrong size of a range of frames");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFrameSize (0, 3), 2500, "A level above the plan is its highest level");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFrameType (0), VideoStreamTrace::I_FRAME, "The frames of a plan without types are key frames");
+
+  // a trace of varying sizes, with an empty frame
+  std::string fileName = CreateTempDirFilename ("video-stream-plan.txt");
+  std::ofstream fileStream (fileName.c_str ());
+  fileStream << "100\n0\n300\n200\n";
+  fileStream.close ();
+  Ptr<const VideoStreamTrace> trace = VideoStreamTrace::Load (fileName);
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNFrames (), 4, "Wrong number of frames in the trace");
+
+  plan = VideoStreamFramePlan::Get (trace, 2, 128);
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFrameSize (2, 2), 600, "The levels of a single-column trace are multiples of it");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentCount (1, 1), 1, "An empty frame is still sent as one fragment");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentCount (2, 2), 5, "600 bytes need 5 fragments of 128 bytes");
+  for (uint16_t level = 1; level <= 2; level++)
+  {
+    uint64_t offset = 0;
+    for (uint32_t frame = 0; frame < plan->GetNFrames (); frame++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (plan->GetByteOffset (frame, level), offset, "Wrong offset of frame " << frame << " at level " << level);
+      offset += plan->GetFrameSize (frame, level);
+    }
+    NS_TEST_ASSERT_MSG_EQ (plan->GetByteOffset (plan->GetNFrames (), level), offset, "Wrong end offset at level " << level);
+  }
+  NS_TEST_ASSERT_MSG_EQ (plan->GetRangeSize (1, 3, 1), 300, "Wrong size of a range of frames");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (0, 1), 0, "The first byte is in the first frame");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (99, 1), 0, "The last byte of a frame is in that frame");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (100, 1), 2, "The empty frame holds no byte");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (799, 2), 2, "Wrong frame of a byte at level 2");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (800, 2), 3, "The first byte of a frame at level 2 is in that frame");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFrameSize (2, 3), 600, "A level above a scaled plan is its highest level");
+  NS_TEST_ASSERT_MSG_EQ (plan->GetFragmentCount (2, 3), 5, "A level above a scaled plan has the fragments of its highest level");
+  NS_TEST_ASSERT_MSG_EQ (plan->FindFrame (600, 1), 4, "The end of the stream is past the last frame");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamFramePlan::Get (trace, 2, 128), plan, "The plans of a trace are shared");
+
+  VideoStreamFramePlan::ClearCache ();
+  VideoStreamTrace::ClearCache ();
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check that the segment requests, the receiver reports and the
+ * NACKs of the clients go through a packet unchanged.
+ */
+class VideoStreamControlHeaderTestCase : public TestCase
+{
+public:
+  VideoStreamControlHeaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+VideoStreamControlHeaderTestCase::VideoStreamControlHeaderTestCase ()
+  : TestCase ("Serialize and deserialize the control messages of a video stream client")
+{
+}
+
+void
+VideoStreamControlHeaderTestCase::DoRun (void)
+{
+  VideoStreamControlHeader segment;
+  segment.SetMessageType (VideoStreamHeader::CLIENT_SEGMENT);
+  segment.SetVideoLevel (4);
+  segment.SetTimestamp (Seconds (1.5));
+  segment.SetFirstFrame (250);
+  segment.SetFrameCount (50);
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (segment);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), segment.GetSerializedSize (), "Wrong size of a segment request");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamControlHeader::PeekMessageSize (packet), packet->GetSize (), "Wrong size of a segment request peeked from a packet");
+
+  VideoStreamControlHeader received;
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0, "The whole segment request was read");
+  NS_TEST_ASSERT_MSG_EQ (received.GetMessageType (), VideoStreamHeader::CLIENT_SEGMENT, "Wrong message type");
+  NS_TEST_ASSERT_MSG_EQ ((uint16_t) received.GetVideoLevel (), 4, "Wrong video level");
+  NS_TEST_ASSERT_MSG_EQ (received.GetTimestamp (), Seconds (1.5), "Wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (received.GetFirstFrame (), 250, "Wrong first frame");
+  NS_TEST_ASSERT_MSG_EQ (received.GetFrameCount (), 50, "Wrong frame count");
+
+  VideoStreamControlHeader report;
+  report.SetMessageType (VideoStreamHeader::CLIENT_REPORT);
+  report.SetTimestamp (Seconds (2.0));
+  report.SetFractionLost (0.1);
+  report.SetReceivedBytes (123456);
+  report.SetJitter (MicroSeconds (2500));
+  report.SetBufferLevel (MilliSeconds (3200));
+  packet = Create<Packet> ();
+  packet->AddHeader (report);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), report.GetSerializedSize (), "Wrong size of a receiver report");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamControlHeader::PeekMessageSize (packet), packet->GetSize (), "Wrong size of a receiver report peeked from a packet");
+
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0, "The whole receiver report was read");
+  NS_TEST_ASSERT_MSG_EQ (received.GetMessageType (), VideoStreamHeader::CLIENT_REPORT, "Wrong message type");
+  NS_TEST_ASSERT_MSG_EQ (received.GetTimestamp (), Seconds (2.0), "Wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (received.GetFractionLost (), 25 / 256.0, "The fraction lost is rounded down to 1/256");
+  NS_TEST_ASSERT_MSG_EQ (received.GetReceivedBytes (), 123456, "Wrong number of received bytes");
+  NS_TEST_ASSERT_MSG_EQ (received.GetJitter (), MicroSeconds (2500), "Wrong jitter");
+  NS_TEST_ASSERT_MSG_EQ (received.GetBufferLevel (), MilliSeconds (3200), "Wrong buffer level");
+
+  VideoStreamControlHeader nack;
+  nack.SetMessageType (VideoStreamHeader::CLIENT_NACK);
+  nack.SetTimestamp (Seconds (3.0));
+  nack.SetFirstFrame (42);
+  nack.SetBufferLevel (MilliSeconds (750));
+  nack.AddNackRange (2, 2);
+  nack.AddNackRange (6, 3);
+  packet = Create<Packet> ();
+  packet->AddHeader (nack);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), nack.GetSerializedSize (), "Wrong size of a NACK");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamControlHeader::PeekMessageSize (packet), packet->GetSize (), "The peeked size of a NACK counts its ranges");
+
+  // a truncated NACK is longer than its datagram
+  std::vector<uint8_t> bytes (packet->GetSize ());
+  packet->CopyData (&bytes[0], bytes.size ());
+  Ptr<Packet> truncated = Create<Packet> (&bytes[0], bytes.size () - 1);
+  NS_TEST_ASSERT_MSG_GT (VideoStreamControlHeader::PeekMessageSize (truncated), truncated->GetSize (), "A truncated NACK does not fit in its datagram");
+
+  packet->RemoveHeader (received);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 0, "The whole NACK was read");
+  NS_TEST_ASSERT_MSG_EQ (received.GetMessageType (), VideoStreamHeader::CLIENT_NACK, "Wrong message type");
+  NS_TEST_ASSERT_MSG_EQ (received.GetTimestamp (), Seconds (3.0), "Wrong timestamp");
+  NS_TEST_ASSERT_MSG_EQ (received.GetFirstFrame (), 42, "Wrong frame");
+  NS_TEST_ASSERT_MSG_EQ (received.GetBufferLevel (), MilliSeconds (750), "Wrong buffer level");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNackRanges ().size (), 2, "Wrong number of ranges");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNackRanges ()[1].first, 6, "Wrong first fragment of a range");
+  NS_TEST_ASSERT_MSG_EQ (received.GetNackRanges ()[1].second, 3, "Wrong fragment count of a range");
+
+  // the fraction lost saturates at 255/256
+  report.SetFractionLost (1.0);
+  NS_TEST_ASSERT_MSG_EQ (report.GetFractionLost (), 255 / 256.0, "The fraction lost saturates");
+  report.SetFractionLost (-0.5);
+  NS_TEST_ASSERT_MSG_EQ (report.GetFractionLost (), 0, "A negative fraction lost is 0");
+
+  // a datagram of another type is not a client message
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamControlHeader::PeekMessageSize (Create<Packet> ()), 0, "An empty packet is no message");
+  uint8_t pong = VideoStreamHeader::SERVER_PONG;
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamControlHeader::PeekMessageSize (Create<Packet> (&pong, 1)), 0, "A server message is no client message");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check the reassembly of frames from their fragments, in any order,
+ * the fragments rebuilt from parity and the missing ranges of a frame.
+ */
+class VideoStreamReassemblerTestCase : public TestCase
+{
+public:
+  VideoStreamReassemblerTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * @brief Build the header of a fragment.
+   *
+   * @param frameNumber the frame number
+   * @param index the index of the fragment
+   * @param count the number of fragments of the frame
+   * @return the header
+   */
+  static VideoStreamHeader MakeFragment (uint32_t frameNumber, uint16_t index, uint16_t count);
+
+  /**
+   * @brief Build the header of a parity packet.
+   *
+   * @param frameNumber the frame number
+   * @param first the first fragment of the group
+   * @param groupSize the number of fragments of the group
+   * @param count the number of fragments of the frame
+   * @param lengthRecovery the XOR of the payload sizes of the group
+   * @return the header
+   */
+  static VideoStreamHeader MakeParity (uint32_t frameNumber, uint16_t first, uint16_t groupSize, uint16_t count, uint16_t lengthRecovery);
+};
+
+VideoStreamReassemblerTestCase::VideoStreamReassemblerTestCase ()
+  : TestCase ("Reassemble video frames from their fragments and parity packets")
+{
+}
+
+VideoStreamHeader
+VideoStreamReassemblerTestCase::MakeFragment (uint32_t frameNumber, uint16_t index, uint16_t count)
+{
+  VideoStreamHeader header;
+  header.SetMessageType (VideoStreamHeader::VIDEO_FRAME);
+  header.SetFrameNumber (frameNumber);
+  header.SetFragmentIndex (index);
+  header.SetFragmentCount (count);
+  return header;
+}
+
+VideoStreamHeader
+VideoStreamReassemblerTestCase::MakeParity (uint32_t frameNumber, uint16_t first, uint16_t groupSize, uint16_t count, uint16_t lengthRecovery)
+{
+  VideoStreamHeader header = MakeFragment (frameNumber, first, count);
+  header.SetMessageType (VideoStreamHeader::VIDEO_PARITY);
+  header.SetGroupSize (groupSize);
+  header.SetLengthRecovery (lengthRecovery);
+  return header;
+}
+
+void
+VideoStreamReassemblerTestCase::DoRun (void)
+{
+  VideoStreamReassembler reassembler (8);
+
+  // fragments in any order, with a duplicate
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 2, 3), 500), VideoStreamReassembler::FRAGMENT_PARTIAL, "The frame misses two fragments");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 0, 3), 1000), VideoStreamReassembler::FRAGMENT_PARTIAL, "The frame misses a fragment");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 0, 3), 1000), VideoStreamReassembler::FRAGMENT_DUPLICATE, "The fragment was received");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 3, 3), 1000), VideoStreamReassembler::FRAGMENT_DUPLICATE, "A fragment out of its frame is dropped");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetPartialFrames (), 1, "The frame is partial");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 1, 3), 1000), VideoStreamReassembler::FRAGMENT_COMPLETE, "The last fragment completes the frame");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (0, 1, 3), 1000), VideoStreamReassembler::FRAGMENT_DUPLICATE, "A complete frame takes no more fragments");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFrameBytes (0), 2500, "Wrong number of bytes of the frame");
+
+  // a frame whose bitmap spans two words
+  for (uint16_t index = 0; index < 70; index++)
+  {
+    if (index != 64)
+    {
+      NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (1, index, 70), 100), VideoStreamReassembler::FRAGMENT_PARTIAL, "Fragment 64 is missing");
+    }
+  }
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (1, 65, 70), 100), VideoStreamReassembler::FRAGMENT_DUPLICATE, "Fragment 65 was received");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (1, 64, 70), 100), VideoStreamReassembler::FRAGMENT_COMPLETE, "Fragment 64 completes the frame");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetCompleteFrames (), 2, "Two frames are complete");
+
+  // a parity packet rebuilds the single missing fragment of its group
+  uint16_t lengthRecovery = 1000 ^ 1000 ^ 1000 ^ 700;
+  reassembler.AddFragment (MakeFragment (2, 0, 4), 1000);
+  reassembler.AddFragment (MakeFragment (2, 1, 4), 1000);
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (2, 3, 4), 700), VideoStreamReassembler::FRAGMENT_PARTIAL, "Fragment 2 is missing");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeParity (2, 0, 4, 4, lengthRecovery), 1000), VideoStreamReassembler::FRAGMENT_COMPLETE, "The parity rebuilds fragment 2");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFrameBytes (2), 3700, "The rebuilt fragment has the size left by the parity");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetRecoveredFragments (), 1, "One fragment was rebuilt");
+
+  // two missing fragments wait for one of them
+  reassembler.AddFragment (MakeFragment (3, 0, 4), 1000);
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeParity (3, 0, 4, 4, lengthRecovery), 1000), VideoStreamReassembler::FRAGMENT_PARTIAL, "A parity can not rebuild two fragments");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (3, 1, 4), 1000), VideoStreamReassembler::FRAGMENT_PARTIAL, "Two fragments are still missing");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (3, 3, 4), 700), VideoStreamReassembler::FRAGMENT_COMPLETE, "The stored parity rebuilds the last missing fragment");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFrameBytes (3), 3700, "The rebuilt fragment has the size left by the parity");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetRecoveredFragments (), 2, "Two fragments were rebuilt");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeParity (4, 1, 2, 2, 0), 0), VideoStreamReassembler::FRAGMENT_DUPLICATE, "A parity past the end of its frame is dropped");
+
+  // frames leaving the window incomplete are lost, with the ones never seen
+  reassembler.AddFragment (MakeFragment (4, 0, 2), 1000);
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (13, 0, 2), 1000), VideoStreamReassembler::FRAGMENT_PARTIAL, "A new frame moves the window");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetLostFrames (), 2, "Frame 4 left the window partial and frame 5 never arrived");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetExpectedFragments (), 3 + 70 + 4 + 4 + 2 + 2, "Frame 5 counts the fragments of the last new frame");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetReceivedFragments (), 3 + 70 + 3 + 3 + 1, "The rebuilt fragments are not received ones");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.AddFragment (MakeFragment (3, 2, 4), 1000), VideoStreamReassembler::FRAGMENT_LATE, "Frame 3 left the window");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFrameBytes (3), 0, "A frame out of the window has no bytes");
+
+  // the missing fragments of a frame, merged in ranges for a NACK
+  std::vector<std::pair<uint16_t, uint16_t> > ranges;
+  reassembler.SetWindowSize (4);
+  uint16_t received[] = {0, 1, 4, 5, 9};
+  for (uint32_t i = 0; i < sizeof (received) / sizeof (received[0]); i++)
+  {
+    reassembler.AddFragment (MakeFragment (20, received[i], 10), 100);
+  }
+  reassembler.AddFragment (MakeFragment (22, 0, 1), 100);
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetMissingRanges (20, ranges), true, "Frame 20 misses fragments");
+  NS_TEST_ASSERT_MSG_EQ (ranges.size (), 2, "Fragments 2, 3 and 6 to 8 are missing");
+  NS_TEST_ASSERT_MSG_EQ (ranges[0].first, 2, "Wrong first fragment of the first range");
+  NS_TEST_ASSERT_MSG_EQ (ranges[0].second, 2, "Wrong fragment count of the first range");
+  NS_TEST_ASSERT_MSG_EQ (ranges[1].first, 6, "Wrong first fragment of the second range");
+  NS_TEST_ASSERT_MSG_EQ (ranges[1].second, 3, "Wrong fragment count of the second range");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetMissingRanges (21, ranges), true, "Frame 21 never arrived");
+  NS_TEST_ASSERT_MSG_EQ (ranges.size (), 1, "A frame never seen is missing whole");
+  NS_TEST_ASSERT_MSG_EQ (ranges[0].first, 0, "A frame never seen is missing from its first fragment");
+  NS_TEST_ASSERT_MSG_EQ (ranges[0].second, UINT16_MAX, "A frame never seen has an unknown fragment count");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetMissingRanges (22, ranges), false, "Frame 22 is complete");
+  NS_TEST_ASSERT_MSG_EQ (ranges.size (), 0, "A complete frame misses nothing");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetMissingRanges (19, ranges), false, "Frame 19 is before the window");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetMissingRanges (24, ranges), false, "Frame 24 is beyond the window");
+
+  // the first frame of a segment still to come
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFirstIncompleteFrame (20, 23), 20, "Frame 20 misses fragments");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFirstIncompleteFrame (22, 23), 23, "A complete range has no incomplete frame");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFirstIncompleteFrame (22, 30), 23, "Frame 23 never arrived");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFirstIncompleteFrame (10, 20), 20, "The frames before the window are skipped");
+  NS_TEST_ASSERT_MSG_EQ (reassembler.GetFirstIncompleteFrame (26, 30), 26, "A frame beyond the window is incomplete");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check that the server sends the NACKed fragments of a frame of
+ * its window through the pacer, only if they can arrive before the frame
+ * is played.
+ */
+class VideoStreamServerNackTestCase : public TestCase
+{
+public:
+  VideoStreamServerNackTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * @brief Hand a NACK of a single range to the server.
+   *
+   * @param frameNumber the NACKed frame
+   * @param sendTime the time the client sent the NACK
+   * @param bufferLevel the buffer level of the client when it sent the NACK
+   * @param first the first missing fragment
+   * @param count the number of missing fragments
+   */
+  void ReceiveNack (uint32_t frameNumber, Time sendTime, Time bufferLevel, uint16_t first, uint16_t count);
+
+  /**
+   * @brief Stand in for the pacer of the session.
+   */
+  static void Pace (void);
+
+  Ptr<VideoStreamServer> m_server; //!< Server under test
+  uint64_t m_sessionId; //!< Session of the client
+};
+
+VideoStreamServerNackTestCase::VideoStreamServerNackTestCase ()
+  : TestCase ("Send NACKed fragments again before their playout deadline")
+{
+}
+
+void
+VideoStreamServerNackTestCase::ReceiveNack (uint32_t frameNumber, Time sendTime, Time bufferLevel, uint16_t first, uint16_t count)
+{
+  VideoStreamControlHeader header;
+  header.SetMessageType (VideoStreamHeader::CLIENT_NACK);
+  header.SetTimestamp (sendTime);
+  header.SetFirstFrame (frameNumber);
+  header.SetBufferLevel (bufferLevel);
+  header.AddNackRange (first, count);
+  m_server->HandleNack (m_sessionId, header);
+}
+
+void
+VideoStreamServerNackTestCase::Pace (void)
+{
+}
+
+void
+VideoStreamServerNackTestCase::DoRun (void)
+{
+  m_server = CreateObject<VideoStreamServer> ();
+  m_server->SetAttribute ("PacingMode", EnumValue (VideoStreamServer::FRAME_INTERVAL_PACING));
+  m_sessionId = m_server->OpenSession (InetSocketAddress (Ipv4Address ("10.0.0.2"), 5000));
+  VideoStreamServer::ClientInfo *clientInfo = m_server->GetSession (m_sessionId);
+
+  // frame 7 was sent, frame 8 is being sent by the pacer
+  VideoStreamServer::QueuedFrame frame;
+  frame.m_frameNumber = 7;
+  frame.m_frameSize = 10000;
+  frame.m_videoLevel = 1;
+  frame.m_frameType = VideoStreamTrace::I_FRAME;
+  frame.m_fragmentCount = 10;
+  frame.m_packetCount = 10;
+  frame.m_nextPacket = 10;
+  frame.m_retransmission = false;
+  clientInfo->m_sentFrames.push_back (frame);
+  frame.m_frameNumber = 8;
+  frame.m_nextPacket = 4;
+  clientInfo->m_pacingQueue.push_back (frame);
+  clientInfo->m_queuedFragments = 6;
+  clientInfo->m_pacingEvent = Simulator::Schedule (Seconds (10.0), &VideoStreamServerNackTestCase::Pace);
+
+  // each NACK took 100 ms to come, and its fragments take as long to go back
+  Simulator::Schedule (Seconds (1.0), &VideoStreamServerNackTestCase::ReceiveNack, this, 7, MilliSeconds (900), MilliSeconds (200), 0, 2);
+  Simulator::Schedule (Seconds (1.0), &VideoStreamServerNackTestCase::ReceiveNack, this, 9, MilliSeconds (900), MilliSeconds (300), 0, 2);
+  Simulator::Schedule (Seconds (1.0), &VideoStreamServerNackTestCase::ReceiveNack, this, 7, MilliSeconds (900), MilliSeconds (300), 8, 5);
+  Simulator::Stop (Seconds (2.0));
+  Simulator::Run ();
+
+  clientInfo = m_server->GetSession (m_sessionId);
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_pacingQueue.size (), 2, "Only the NACK in time and in the window is served");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_pacingQueue[0].m_frameNumber, 8, "The frame being sent stays at the front");
+  const VideoStreamServer::QueuedFrame &resent = clientInfo->m_pacingQueue[1];
+  NS_TEST_ASSERT_MSG_EQ (resent.m_frameNumber, 7, "The NACKed frame is queued right behind the frame being sent");
+  NS_TEST_ASSERT_MSG_EQ (resent.m_retransmission, true, "The queued fragments are a retransmission");
+  NS_TEST_ASSERT_MSG_EQ (resent.m_nextPacket, 8, "The retransmission starts at the first missing fragment");
+  NS_TEST_ASSERT_MSG_EQ (resent.m_packetCount, 10, "The range is cut at the end of the frame");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_queuedFragments, 8, "The resent fragments are queued");
+
+  Simulator::Destroy ();
+  m_server = 0;
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check the frame sizes and types read from text and binary traces.
+ */
+class VideoStreamTraceTestCase : public TestCase
+{
+public:
+  VideoStreamTraceTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * @brief Write a file.
+   *
+   * @param fileName the file name
+   * @param content the content of the file
+   */
+  static void WriteFile (std::string fileName, const std::string &content);
+};
+
+VideoStreamTraceTestCase::VideoStreamTraceTestCase ()
+  : TestCase ("Read the frame sizes and types of video traces")
+{
+}
+
+void
+VideoStreamTraceTestCase::WriteFile (std::string fileName, const std::string &content)
+{
+  std::ofstream fileStream (fileName.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  fileStream.write (content.data (), content.size ());
+}
+
+void
+VideoStreamTraceTestCase::DoRun (void)
+{
+  // a text trace with frame types, where an untyped line is a P frame
+  std::string fileName = CreateTempDirFilename ("video-stream-typed.txt");
+  WriteFile (fileName, "22500 I\n1027 P\n\n1027 b\n900\n");
+  Ptr<const VideoStreamTrace> trace = VideoStreamTrace::Load (fileName);
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNFrames (), 4, "Blank lines are skipped");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNLevels (), 1, "A text trace has a single level");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (0), 22500, "Wrong size of frame 0");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (2, 2), 2054, "The levels of a text trace are multiples of its sizes");
+  NS_TEST_ASSERT_MSG_EQ (trace->HasFrameTypes (), true, "The trace has frame types");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (0), VideoStreamTrace::I_FRAME, "Wrong type of frame 0");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (1), VideoStreamTrace::P_FRAME, "Wrong type of frame 1");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (2), VideoStreamTrace::B_FRAME, "The frame types are not case sensitive");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (3), VideoStreamTrace::P_FRAME, "An untyped frame of a typed trace is a P frame");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamTrace::Load (fileName), trace, "A trace is loaded once");
+
+  // a word after the size is not a frame type
+  fileName = CreateTempDirFilename ("video-stream-untyped.txt");
+  WriteFile (fileName, "100\n200 Px\n");
+  trace = VideoStreamTrace::Load (fileName);
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (1), 200, "Wrong size of frame 1");
+  NS_TEST_ASSERT_MSG_EQ (trace->HasFrameTypes (), false, "The trace has no frame types");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (1), VideoStreamTrace::I_FRAME, "Every frame of an untyped trace is a key frame");
+
+  // a binary trace, over several checkpoints
+  std::vector<std::vector<uint32_t> > levels (2);
+  std::vector<uint8_t> frameTypes;
+  for (uint32_t frame = 0; frame < 200; frame++)
+  {
+    levels[0].push_back (frame % 9 == 0 ? 20000 : 1000 + 37 * frame);
+    levels[1].push_back (3 * levels[0].back ());
+    frameTypes.push_back (frame % 9 == 0 ? VideoStreamTrace::I_FRAME : (frame % 3 == 0 ? VideoStreamTrace::P_FRAME : VideoStreamTrace::B_FRAME));
+  }
+  fileName = CreateTempDirFilename ("video-stream-typed.vstr");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamTrace::WriteBinary (fileName, levels, frameTypes, 30), true, "Failed to write a binary trace");
+  trace = VideoStreamTrace::Load (fileName);
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNFrames (), 200, "Wrong number of frames");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetNLevels (), 2, "Wrong number of levels");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameRate (), 30, "Wrong frame rate");
+  NS_TEST_ASSERT_MSG_EQ (trace->HasFrameTypes (), true, "The trace has frame types");
+  for (uint32_t frame = 0; frame < 200; frame++)
+  {
+    NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (frame, 1), levels[0][frame], "Wrong size of frame " << frame << " at level 1");
+    NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (frame, 2), levels[1][frame], "Wrong size of frame " << frame << " at level 2");
+    NS_TEST_ASSERT_MSG_EQ (trace->GetFrameType (frame), frameTypes[frame], "Wrong type of frame " << frame);
+  }
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (5, 3), levels[1][5], "A level above the trace is its highest level");
+
+  // the same frames at another frame rate are another trace
+  uint64_t contentHash = trace->GetContentHash ();
+  fileName = CreateTempDirFilename ("video-stream-untyped.vstr");
+  NS_TEST_ASSERT_MSG_EQ (VideoStreamTrace::WriteBinary (fileName, levels, std::vector<uint8_t> (), 25), true, "Failed to write a binary trace");
+  trace = VideoStreamTrace::Load (fileName);
+  NS_TEST_ASSERT_MSG_NE (trace->GetContentHash (), contentHash, "The hash covers the header");
+  NS_TEST_ASSERT_MSG_EQ (trace->HasFrameTypes (), false, "The trace has no frame types");
+  NS_TEST_ASSERT_MSG_EQ (trace->GetFrameSize (199, 1), levels[0][199], "Wrong size of the last frame");
+
+  VideoStreamTrace::ClearCache ();
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check which frame the server drops from a full pacing queue.
+ */
+class VideoStreamServerDropTestCase : public TestCase
+{
+public:
+  VideoStreamServerDropTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * @brief Build a frame of two fragments.
+   *
+   * @param frameNumber the frame number
+   * @param frameType the type of the frame
+   * @return the frame
+   */
+  static VideoStreamServer::QueuedFrame MakeFrame (uint32_t frameNumber, VideoStreamTrace::FrameType frameType);
+
+  /**
+   * @brief Queue a frame for the client, as sent.
+   *
+   * @param clientInfo the session of the client
+   * @param frame the frame
+   */
+  static void QueueFrame (VideoStreamServer::ClientInfo *clientInfo, const VideoStreamServer::QueuedFrame &frame);
+
+  /**
+   * @brief Get the numbers of the frames of a pacing queue.
+   *
+   * @param clientInfo the session of the client
+   * @return the frame numbers, oldest first, separated by spaces
+   */
+  static std::string GetQueue (VideoStreamServer::ClientInfo *clientInfo);
+};
+
+VideoStreamServerDropTestCase::VideoStreamServerDropTestCase ()
+  : TestCase ("Drop frames from a full pacing queue by frame type")
+{
+}
+
+VideoStreamServer::QueuedFrame
+VideoStreamServerDropTestCase::MakeFrame (uint32_t frameNumber, VideoStreamTrace::FrameType frameType)
+{
+  VideoStreamServer::QueuedFrame frame;
+  frame.m_frameNumber = frameNumber;
+  frame.m_frameSize = 2000;
+  frame.m_videoLevel = 1;
+  frame.m_frameType = frameType;
+  frame.m_fragmentCount = 2;
+  frame.m_packetCount = 2;
+  frame.m_nextPacket = 0;
+  frame.m_retransmission = false;
+  return frame;
+}
+
+void
+VideoStreamServerDropTestCase::QueueFrame (VideoStreamServer::ClientInfo *clientInfo, const VideoStreamServer::QueuedFrame &frame)
+{
+  clientInfo->m_pacingQueue.push_back (frame);
+  clientInfo->m_queuedFragments += frame.m_packetCount - frame.m_nextPacket;
+  if (!frame.m_retransmission)
+  {
+    clientInfo->m_sentFrames.push_back (frame);
+  }
+}
+
+std::string
+VideoStreamServerDropTestCase::GetQueue (VideoStreamServer::ClientInfo *clientInfo)
+{
+  std::ostringstream oss;
+  for (auto iter = clientInfo->m_pacingQueue.begin (); iter != clientInfo->m_pacingQueue.end (); iter++)
+  {
+    oss << (iter == clientInfo->m_pacingQueue.begin () ? "" : " ") << iter->m_frameNumber;
+  }
+  return oss.str ();
+}
+
+void
+VideoStreamServerDropTestCase::DoRun (void)
+{
+  Ptr<VideoStreamServer> server = CreateObject<VideoStreamServer> ();
+  server->SetAttribute ("DropPolicy", EnumValue (VideoStreamServer::DROP_BY_FRAME_TYPE));
+  uint64_t sessionId = server->OpenSession (InetSocketAddress (Ipv4Address ("10.0.0.2"), 5000));
+  VideoStreamServer::ClientInfo *clientInfo = server->GetSession (sessionId);
+  QueueFrame (clientInfo, MakeFrame (0, VideoStreamTrace::I_FRAME));
+  QueueFrame (clientInfo, MakeFrame (1, VideoStreamTrace::B_FRAME));
+  QueueFrame (clientInfo, MakeFrame (2, VideoStreamTrace::B_FRAME));
+  QueueFrame (clientInfo, MakeFrame (3, VideoStreamTrace::P_FRAME));
+  QueueFrame (clientInfo, MakeFrame (4, VideoStreamTrace::B_FRAME));
+
+  // the B frames go first, oldest first
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (5, VideoStreamTrace::I_FRAME)), true, "A queued B frame makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "0 2 3 4", "The oldest B frame is dropped");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_queuedFragments, 8, "The fragments of the dropped frame leave the queue");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_sentFrames.size (), 4, "A dropped frame is not sent again on a NACK");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_sentFrames.front ().m_frameNumber, 0, "Only the dropped frame leaves the retransmission window");
+  server->MakeRoom (clientInfo, MakeFrame (5, VideoStreamTrace::B_FRAME));
+  server->MakeRoom (clientInfo, MakeFrame (5, VideoStreamTrace::B_FRAME));
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "0 3", "The B frames are dropped first");
+
+  // a new B frame is the least useful frame
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (5, VideoStreamTrace::B_FRAME)), false, "A new B frame is dropped itself");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "0 3", "The queue is left alone");
+
+  // a new P frame is dropped with the rest of its group of pictures
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (6, VideoStreamTrace::P_FRAME)), false, "A new P frame is dropped itself");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_awaitKeyFrame, true, "The frames wait for the next key frame");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "0 3", "The queue is left alone");
+
+  // a new key frame drops the newest P frame, then the oldest key frame
+  QueueFrame (clientInfo, MakeFrame (7, VideoStreamTrace::P_FRAME));
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (9, VideoStreamTrace::I_FRAME)), true, "A queued P frame makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "0 3", "The newest P frame is dropped");
+  server->MakeRoom (clientInfo, MakeFrame (9, VideoStreamTrace::I_FRAME));
+  QueueFrame (clientInfo, MakeFrame (9, VideoStreamTrace::I_FRAME));
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (10, VideoStreamTrace::I_FRAME)), true, "A queued key frame makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "9", "The oldest key frame is dropped");
+
+  // the oldest frame goes whatever its type, but a dropped retransmission
+  // leaves its frame in the window
+  server->SetAttribute ("DropPolicy", EnumValue (VideoStreamServer::DROP_OLDEST));
+  VideoStreamServer::QueuedFrame resent = MakeFrame (9, VideoStreamTrace::I_FRAME);
+  resent.m_retransmission = true;
+  clientInfo->m_pacingQueue.insert (clientInfo->m_pacingQueue.begin (), resent);
+  clientInfo->m_queuedFragments += resent.m_packetCount;
+  QueueFrame (clientInfo, MakeFrame (11, VideoStreamTrace::B_FRAME));
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (12, VideoStreamTrace::B_FRAME)), true, "The oldest frame makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "9 11", "The oldest frame is dropped");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_sentFrames.size (), 2, "A dropped retransmission keeps its frame in the window");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_queuedFragments, 4, "The fragments of the dropped frame leave the queue");
+
+  // the frame being sent is kept, under both policies
+  clientInfo->m_pacingQueue.front ().m_nextPacket = 1;
+  clientInfo->m_queuedFragments--;
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (12, VideoStreamTrace::B_FRAME)), true, "The oldest frame not started makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "9", "The frame being sent stays");
+  NS_TEST_ASSERT_MSG_EQ (clientInfo->m_queuedFragments, 1, "The fragment left of the frame being sent stays queued");
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (12, VideoStreamTrace::B_FRAME)), false, "The new frame is dropped when only the frame being sent is queued");
+  server->SetAttribute ("DropPolicy", EnumValue (VideoStreamServer::DROP_BY_FRAME_TYPE));
+  QueueFrame (clientInfo, MakeFrame (13, VideoStreamTrace::I_FRAME));
+  NS_TEST_ASSERT_MSG_EQ (server->MakeRoom (clientInfo, MakeFrame (14, VideoStreamTrace::I_FRAME)), true, "A queued key frame makes room");
+  NS_TEST_ASSERT_MSG_EQ (GetQueue (clientInfo), "9", "The oldest key frame not started is dropped");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief Check the video levels chosen by the adaptive bitrate algorithms.
+ */
+class VideoStreamAbrTestCase : public TestCase
+{
+public:
+  VideoStreamAbrTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * @brief Make the state of a client with a ladder of 1, 2, 4 and 8 Mbit/s.
+   *
+   * @param videoLevel the current video level
+   * @param bufferSeconds the buffer level in seconds
+   * @param throughput the estimated throughput in bit/s
+   * @return the state of the client
+   */
+  static AbrContext MakeContext (uint16_t videoLevel, double bufferSeconds, double throughput);
+
+  /**
+   * @brief Get the best quality of experience of the remaining seconds by
+   * trying every sequence of levels.
+   *
+   * @param abr the algorithm
+   * @param context the state of the client
+   * @param step the number of seconds already planned
+   * @param buffer the buffer level in seconds
+   * @param lastLevel the level of the previous second
+   * @return the quality of experience of the remaining seconds
+   */
+  static double Search (Ptr<MpcAbr> abr, const AbrContext &context, uint32_t step, double buffer, uint16_t lastLevel);
+};
+
+VideoStreamAbrTestCase::VideoStreamAbrTestCase ()
+  : TestCase ("Choose the video level with the adaptive bitrate algorithms")
+{
+}
+
+AbrContext
+VideoStreamAbrTestCase::MakeContext (uint16_t videoLevel, double bufferSeconds, double throughput)
+{
+  AbrContext context;
+  context.m_videoLevel = videoLevel;
+  context.m_maxLevel = 4;
+  context.m_frameRate = 100;
+  context.m_bufferFrames = std::llround (bufferSeconds * context.m_frameRate);
+  context.m_rebufferCount = 0;
+  context.m_throughput = throughput;
+  context.m_harmonicThroughput = throughput;
+  context.m_rtt = Time ();
+  context.m_levelBitrate = 0;
+  context.m_ladderBitrates.push_back (1e6);
+  context.m_ladderBitrates.push_back (2e6);
+  context.m_ladderBitrates.push_back (4e6);
+  context.m_ladderBitrates.push_back (8e6);
+  return context;
+}
+
+double
+VideoStreamAbrTestCase::Search (Ptr<MpcAbr> abr, const AbrContext &context, uint32_t step, double buffer, uint16_t lastLevel)
+{
+  if (step == abr->m_horizon)
+  {
+    return 0;
+  }
+  double best = -std::numeric_limits<double>::infinity ();
+  for (uint16_t level = 1; level <= context.m_maxLevel; level++)
+  {
+    double nextBuffer = buffer;
+    double qoe = abr->GetStepQoe (context, level, lastLevel, nextBuffer);
+    best = std::max (best, qoe + Search (abr, context, step + 1, nextBuffer, level));
+  }
+  return best;
+}
+
+void
+VideoStreamAbrTestCase::DoRun (void)
+{
+  // the original rule: down after 3 rebufferings, up once the buffer grew
+  // by 4 seconds since the last raise
+  Ptr<LegacyAbr> legacy = CreateObject<LegacyAbr> ();
+  AbrContext context = MakeContext (2, 0, 0);
+  context.m_maxLevel = 6;
+  context.m_rebufferCount = 3;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 1, "3 rebufferings in a row lower the level");
+  context.m_rebufferCount = 0;
+  context.m_bufferFrames = 600;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 3, "6 seconds of buffer raise the level");
+  context.m_videoLevel = 3;
+  context.m_bufferFrames = 800;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 3, "The buffer did not grow by 4 seconds since the raise");
+  context.m_bufferFrames = 550;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 3, "A lower buffer keeps the level");
+  context.m_bufferFrames = 950;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 4, "The buffer grew by 4 seconds from its lowest point");
+  context.m_videoLevel = 6;
+  context.m_bufferFrames = 2000;
+  NS_TEST_ASSERT_MSG_EQ (legacy->SelectLevel (context), 6, "The highest level is not raised");
+
+  // the buffer maps to 1 Mbit/s up to the reservoir, to 8 Mbit/s past the
+  // cushion, and to 0.7 Mbit/s more per second of buffer in between
+  Ptr<BbaAbr> bba = CreateObject<BbaAbr> ();
+  bba->SetAttribute ("Reservoir", TimeValue (Seconds (5.0)));
+  bba->SetAttribute ("Cushion", TimeValue (Seconds (10.0)));
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (3, 4, 0)), 1, "The reservoir maps to the lowest level");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (2, 16, 0)), 4, "Past the cushion maps to the highest level");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (1, 7, 0)), 2, "2.4 Mbit/s reach the bitrate of level 2");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (1, 12, 0)), 3, "5.9 Mbit/s go up to the highest level below them");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (2, 9, 0)), 2, "3.8 Mbit/s do not reach the bitrate of level 3");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (3, 9, 0)), 3, "3.8 Mbit/s do not reach down to the bitrate of level 2");
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (MakeContext (4, 6, 0)), 2, "1.7 Mbit/s go down to the lowest level above them");
+  context = MakeContext (1, 10, 0);
+  context.m_maxLevel = 6;
+  context.m_ladderBitrates.clear ();
+  NS_TEST_ASSERT_MSG_EQ (bba->SelectLevel (context), 3, "Unknown bitrates grow linearly with the level");
+
+  // the highest level within 80% of the throughput
+  Ptr<ThroughputAbr> rate = CreateObject<ThroughputAbr> ();
+  rate->SetAttribute ("SafetyFactor", DoubleValue (0.8));
+  NS_TEST_ASSERT_MSG_EQ (rate->SelectLevel (MakeContext (2, 10, 0)), 2, "An unknown throughput keeps the level");
+  NS_TEST_ASSERT_MSG_EQ (rate->SelectLevel (MakeContext (1, 10, 5e6)), 3, "4 Mbit/s fit in 80% of 5 Mbit/s");
+  NS_TEST_ASSERT_MSG_EQ (rate->SelectLevel (MakeContext (1, 10, 4.9e6)), 2, "4 Mbit/s do not fit in 80% of 4.9 Mbit/s");
+  NS_TEST_ASSERT_MSG_EQ (rate->SelectLevel (MakeContext (4, 10, 1e6)), 1, "The lowest level is the floor");
+  context = MakeContext (1, 10, 4e6);
+  context.m_maxLevel = 6;
+  context.m_ladderBitrates.clear ();
+  context.m_levelBitrate = 1e6;
+  NS_TEST_ASSERT_MSG_EQ (rate->SelectLevel (context), 3, "Without a ladder, level l takes l times the bitrate of level 1");
+
+  Ptr<MpcAbr> mpc = CreateObject<MpcAbr> ();
+  mpc->SetAttribute ("Horizon", UintegerValue (4));
+  mpc->SetAttribute ("RebufferPenalty", DoubleValue (20.0));
+  mpc->SetAttribute ("SwitchPenalty", DoubleValue (1.0));
+  NS_TEST_ASSERT_MSG_EQ (mpc->SelectLevel (MakeContext (2, 10, 0)), 2, "An unknown throughput keeps the level");
+  NS_TEST_ASSERT_MSG_EQ (mpc->SelectLevel (MakeContext (4, 10, 100e6)), 4, "A fast path keeps the highest level");
+  NS_TEST_ASSERT_MSG_EQ (mpc->SelectLevel (MakeContext (1, 0, 1.5e6)), 1, "An empty buffer on a slow path keeps the lowest level");
+  context = MakeContext (1, 0, 100e6);
+  context.m_harmonicThroughput = 1.5e6;
+  NS_TEST_ASSERT_MSG_EQ (mpc->SelectLevel (context), 1, "The harmonic mean predicts the throughput");
+
+  // downloads of 10, 20, 40 and 80 ms keep the buffer on the 10 ms grid, so
+  // the dynamic program finds the best of all the sequences
+  context = MakeContext (1, 0.5, 100e6);
+  mpc->m_plans.clear ();
+  NS_TEST_ASSERT_MSG_EQ_TOL (mpc->Plan (context, 0, 0.5, 1), Search (mpc, context, 0, 0.5, 1), 1e-9, "The dynamic program finds the best sequence");
+  NS_TEST_ASSERT_MSG_LT (mpc->m_plans.size (), 1 + 4 + 16 + 64, "Sequences reaching the same state share their plan");
+
+  // the states are solved on the buffer rounded to 10 ms
+  mpc->m_plans.clear ();
+  double rounded = mpc->Plan (context, 1, 2.004, 2);
+  uint32_t nPlans = mpc->m_plans.size ();
+  NS_TEST_ASSERT_MSG_EQ (mpc->Plan (context, 1, 2.001, 2), rounded, "2.001 s and 2.004 s share a state");
+  NS_TEST_ASSERT_MSG_EQ (mpc->m_plans.size (), nPlans, "A state is solved once");
+  mpc->Plan (context, 1, 2.006, 2);
+  NS_TEST_ASSERT_MSG_GT (mpc->m_plans.size (), nPlans, "2.006 s rounds to another state");
+}
+
+/**
+ * @ingroup applications-test
+ * @ingroup tests
+ *
+ * @brief The test suite of the video stream client and server.
+ */
+class VideoStreamTestSuite : public TestSuite
+{
+public:
+  VideoStreamTestSuite ();
+};
+
+VideoStreamTestSuite::VideoStreamTestSuite ()
+  : TestSuite ("video-stream", UNIT)
+{
+  AddTestCase (new VideoStreamPlayoutTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamEstimatorTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamFramePlanTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamControlHeaderTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamReassemblerTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamServerNackTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamTraceTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamServerDropTestCase, TestCase::QUICK);
+  AddTestCase (new VideoStreamAbrTestCase, TestCase::QUICK);
+}
+
+static VideoStreamTestSuite g_videoStreamTestSuite; //!< Static variable for test initialization
+
+} // namespace ns3